@@ -11,6 +11,8 @@
  *     Switches: _ONE_NAMESPACE_PER_DRIVER_
  *               MASK_IRQ_ILLEGAL   Calles OSS_SigCreate() with mask IRQ.
  *                                  Only allowed for special test!
+ *               M99_NO_CYCLE_COUNTER  don't use the cpu cycle counter for
+ *                                  the isr time measurement
  *
  *---------------------------------------------------------------------------
  * Copyright 1997-2019, MEN Mikro Elektronik GmbH
@@ -66,6 +68,9 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 #define M99_DEFAULT_BUF_TIMEOUT  1000  /* ms */
 
 #define M99_SRAM_RW_BUF_SIZE 64  /* byte */
+/* pattern banks are the SRAM read (0) and write (1) area */
+#define M99_PAT_BANK(h,b) ((b) * (h)->RWbufSize)    /* SRAM offset of bank */
+#define M99_PAT_NONE    0xffffffff                 /* no bank */
 #define M99_CLOCK_FREQ  250000
 #define M99_JITTER_OFF  0
 #define M99_JITTER_ON   1
@@ -92,9 +97,41 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 /* debug handle */
 #define DBH		m99Hdl->dbgHdl
 
+/* counted M-Module register access, g: register group M99_BUS_xxx */
+#define M99_RD( h, g, ma, reg ) \
+    ( (h)->bus.grp[g].reads++, MREAD_D16( ma, reg ) )
+#define M99_WR( h, g, ma, reg, val ) \
+    do { (h)->bus.grp[g].writes++; MWRITE_D16( ma, reg, val ); } while(0)
+
+/* free running cpu cycle counter (low 32 bit) for isr time measurement */
+#if !defined(M99_NO_CYCLE_COUNTER) && defined(__GNUC__) && \
+    (defined(__i386__) || defined(__x86_64__))
+#   define M99_CYCLES(c)  __asm__ __volatile__ ("rdtsc" : "=a"(c) : : "edx")
+#elif !defined(M99_NO_CYCLE_COUNTER) && defined(__GNUC__) && \
+    (defined(__powerpc__) || defined(__PPC__))
+#   define M99_CYCLES(c)  __asm__ __volatile__ ("mftb %0" : "=r"(c))
+#else
+#   define M99_CYCLES(c)  ((c) = 0)
+#   define M99_HAS_CYCLES 0
+#endif
+#ifndef M99_HAS_CYCLES
+#   define M99_HAS_CYCLES 1
+#endif
+
+/* isr time stamps: entry, end of each phase */
+#define M99_ISRT_NSTAMPS  (M99_ISRT_NPHASES+1)
+
 /*-----------------------------------------+
 |  TYPEDEFS                                |
 +------------------------------------------*/
+/* one virtual timer */
+typedef struct
+{
+    u_int64         deadline;             /* wheel time of next expiry */
+    OSS_SIG_HANDLE  *sig;                 /* signal on expiry */
+    M99_VT_STAT     st;                   /* state (armed, period), stats */
+} M99_VT;
+
 typedef struct
 {
     int32           OwnMemSize;
@@ -106,9 +143,15 @@ typedef struct
     MACCESS         maSRAM;               /* access pointer to SRAM    */
     MBUF_HANDLE     *inbuf;
     MBUF_HANDLE     *outbuf;
+    OSS_SEM_HANDLE  *cfgSem;              /* serializes setstats */
+    OSS_SEM_HANDLE  *rdSem;               /* read path: rd_offs, inbuf */
+    OSS_SEM_HANDLE  *wrSem;               /* write path: wr_offs, outbuf */
     u_int32         useModulId;
     int32           nbrOfChannels;
     OSS_SIG_HANDLE  *cond[M99_MAX_SIGNALS];
+    u_int32         sigSent[M99_MAX_SIGNALS];  /* signals sent per cond */
+    u_int32         sigLastSeq[M99_MAX_SIGNALS]; /* seq of last send per cond */
+    u_int32         sigSeq;               /* irq seq of last signal sent */
     u_int32         medPreLoad;           /* medium irq rate */
     u_int32         timerval;             /* current timervalue */
     u_int32         jittermode;           /* jitter mode flag */
@@ -117,9 +160,65 @@ typedef struct
     u_int32         wr_offs;              /* address in SRAM for next write */
     u_int32         RWbufSize;            /* read and write buffer size */
     int32           laststep;             /* last step of irq rate */
+    u_int32         jitMin;               /* jitter profile, 0=medPreLoad/2 */
+    u_int32         jitMax;               /* jitter profile, 0=medPreLoad*2 */
+    u_int32         irqEnabled;           /* timer irq enabled */
 	u_int32			irqLatency; 		  /* current interrupt latency  */
 	u_int32			maxIrqLatency; 		  /* max. interrupt latency  */
+    u_int32         latHist[M99_HIST_SIZE]; /* irq latency histogram */
+    M99_IVSTAT      ivStat;               /* interval stats (read+reset) */
+    u_int32         ovrLimit;             /* overrun latency, 0=off */
 	MDIS_IDENT_FUNCT_TBL idFuncTbl;		  /* id function table */
+    /* flight recorder */
+    u_int32         frecState;            /* M99_FREC_xxx */
+    u_int32         frecThresh;           /* trigger latency, 0=off */
+    u_int32         frecPost;             /* records after trigger */
+    u_int32         frecPostLeft;         /* post records still missing */
+    u_int32         frecIdx;              /* next ring index */
+    u_int32         frecFill;             /* valid records in ring */
+    u_int32         frecTrigIdx;          /* ring index of trigger record */
+    OSS_SIG_HANDLE  *frecSig;             /* signal on frozen window */
+    M99_FREC_ENTRY  frecRing[M99_FREC_SIZE];
+    /* isr execution time */
+    u_int32         isrtOn;               /* measurement enabled */
+    M99_ISRTIME     isrt;                 /* accumulated results */
+    /* register shadow, no read back, no redundant bus writes */
+    u_int8          shTc;                 /* TC_REG */
+    u_int8          shCp[3];              /* CPL_REG, CPM_REG, CPH_REG */
+    u_int32         shCpValid;            /* shCp[] loaded into hardware */
+    M99_BUSSTAT     bus;                  /* bus access counters */
+    /* virtual timers (timer wheel) */
+    u_int32         vtActive;             /* preload driven by the wheel */
+    u_int64         vtT;                  /* wheel time of last expiry [ticks] */
+    u_int32         vtRun;                /* length of running hw period */
+    u_int64         vtBaseNext;           /* next base period deadline */
+    u_int32         vtHwIrqs;             /* timer irqs while active */
+    u_int32         vtBaseIrqs;           /* of them base period irqs */
+    M99_VT          vt[M99_VT_NUM];
+    /* irq storm protection */
+    M99_STORM_STAT  storm;                /* limits, mode, results */
+    u_int32         stormPause;           /* timer halt [ms] */
+    u_int32         stormTicks;           /* window: expired periods [ticks] */
+    u_int32         stormIrqs;            /* window: irqs */
+    u_int64         stormBusy;            /* window: isr cycles */
+    u_int64         stormAll;             /* window: cycles entry to entry */
+    u_int32         stormLast;            /* cycle stamp of last isr entry */
+    u_int32         stormLastValid;
+    OSS_SIG_HANDLE  *stormSig;            /* signal on throttle event */
+    OSS_ALARM_HANDLE *stormAlm;           /* restarts a halted timer */
+    /* port B capture */
+    u_int32         rdBufSize;            /* read buffer size [byte] */
+    u_int32         rdHighWater;          /* RD_BUF/HIGHWATER */
+    u_int32         rdTimeout;            /* RD_BUF/TIMEOUT */
+    u_int32         rdDbgLevel;           /* MBUF debug level */
+    u_int32         rdWait;               /* reads sleeping in MBUF_Read */
+    u_int32         capMode;              /* M99_CAP_xxx */
+    u_int32         capLost;              /* records lost, buffer full */
+    u_int32         capLostRec;           /* lost since the last record */
+    u_int32         capPrev;              /* previous sample, -1: none */
+    /* port A pattern playback */
+    M99_PATSTAT     pat;                  /* mode, banks, counters */
+    u_int16         patWord;              /* SRAM word of current step pair */
 } M99_HANDLE;
 
 
@@ -132,6 +231,7 @@ typedef struct
 +------------------------------------------*/
 static char* M99_Ident( void );
 
+static int32 setStat( M99_HANDLE *m99Hdl, int32 code, INT32_OR_64 value32_or_64 );
 static int32 setStatBlock(
     M99_HANDLE         *m99Hdl,
     int32              code,
@@ -143,8 +243,33 @@ static int32 getStatBlock(
     M_SETGETSTAT_BLOCK *blockStruct);
 
 static void  setTime( M99_HANDLE* m99Hdl, int32 timerval);
+static void  tcWrite( M99_HANDLE *m99Hdl, u_int8 tc );
+static void  busSum( M99_HANDLE *m99Hdl, M99_BUSCNT *sum );
+static u_int64 vtNow( M99_HANDLE *m99Hdl );
+static u_int32 vtExpire( M99_HANDLE *m99Hdl, u_int32 tval );
+static void  vtUpdate( M99_HANDLE *m99Hdl );
+static void  vtStop( M99_HANDLE *m99Hdl );
+static int32 vtArm( M99_HANDLE *m99Hdl, const M99_VTIMER *vt );
 static u_int32 getTime( M99_HANDLE *m99Hdl );
+static int32 sigInfo( M99_HANDLE *m99Hdl, OSS_SIG_HANDLE **sigP,
+                      int32 *valueP );
 static void  dostep( M99_HANDLE* m99Hdl );
+static int32 applyConfig( M99_HANDLE *m99Hdl, const M99_CONFIG *cfg );
+static void  frecArm( M99_HANDLE *m99Hdl );
+static void  frecRecord( M99_HANDLE *m99Hdl, u_int32 tval, u_int32 flags );
+static void  isrtReset( M99_HANDLE *m99Hdl );
+static void  isrtClr( M99_ISRT_STAT *st );
+static void  isrtAdd( M99_ISRT_STAT *st, u_int32 val );
+static void  isrtUpdate( M99_HANDLE *m99Hdl, const u_int32 *stamp,
+                         u_int32 ticks );
+static void  stormWinReset( M99_HANDLE *m99Hdl );
+static void  stormCheck( M99_HANDLE *m99Hdl, u_int32 entry, u_int32 period );
+static void  stormThrottle( M99_HANDLE *m99Hdl, u_int32 avgPeriod );
+static void  stormResume( void *arg );
+static void  capRecord( M99_HANDLE *m99Hdl, u_int32 tval );
+static int32 capBufReset( M99_HANDLE *m99Hdl );
+static void  patStep( M99_HANDLE *m99Hdl );
+static int32 patLoad( M99_HANDLE *m99Hdl, const M99_PATTERN *pat );
 
 static int32 M99_HwBlockRead(
                   M99_HANDLE  *m99Hdl,
@@ -251,13 +376,19 @@ static char* M99_Ident( void )
  *                ID_CHECK              0                0..1
  *                M99_COUNTER_PRELOAD   250000           10..500000
  *                M99_IRQ_JITTER        0                0..1
+ *                M99_FREC_THRESHOLD    0 (off)          0..0xffffff ticks
+ *                M99_FREC_POST         M99_FREC_SIZE/2  0..M99_FREC_SIZE-1
+ *                M99_STORM_RATE        0 (off)          0..250000 irq/s
+ *                M99_STORM_BUDGET      0 (off)          0..1000 (1/1000)
+ *                M99_STORM_MODE        M99_STORM_RAISE  0..1
+ *                M99_STORM_PAUSE       100              1..60000 ms
  *
  *
  *---------------------------------------------------------------------------
  *  Input......:  descSpec   pointer to descriptor specifier
  *                osHdl      pointer to the os specific structure
  *                maHdl      pointer to access handle
- *                devSemHdl  device semaphore for unblocking in wait
+ *                devSemHdl  device semaphore (not used, LL_LOCK_NONE)
  *                irqHdl     irq handle for mask and unmask interrupts
  *
  *  Output.....:  llHdlP  pointer to low level driver handle
@@ -374,6 +505,14 @@ static int32 M99_Init
 
     DBGWRT_1((DBH, "LL - M99_Init\n" )  );
 
+    /*-------------------------------------+
+    |  locking (see M99_Info)              |
+    +-------------------------------------*/
+    if( (retCode = OSS_SemCreate( osHdl, OSS_SEM_BIN, 1, &m99Hdl->cfgSem )) ||
+        (retCode = OSS_SemCreate( osHdl, OSS_SEM_BIN, 1, &m99Hdl->rdSem ))  ||
+        (retCode = OSS_SemCreate( osHdl, OSS_SEM_BIN, 1, &m99Hdl->wrSem )) )
+        goto CLEANUP;
+
     /*-------------------------------------+
     |  get RD_BUF params                   |
     +-------------------------------------*/
@@ -407,12 +546,17 @@ static int32 M99_Init
                               "RD_BUF/HIGHWATER",
                               0 );
 
-    retCode = MBUF_Create( osHdl, DevSem, m99Hdl, inBufferSize,
+    /* MBUF releases the path semaphore while waiting for data */
+    retCode = MBUF_Create( osHdl, m99Hdl->rdSem, m99Hdl, inBufferSize,
                            M99_CH_WIDTH, mode,
                            MBUF_RD, highWater, inBufferTimeout,
                            m99Hdl->irqHdl,
                            &m99Hdl->inbuf );
     if( retCode ) goto CLEANUP;
+    m99Hdl->rdBufSize   = inBufferSize;
+    m99Hdl->rdHighWater = highWater;
+    m99Hdl->rdTimeout   = inBufferTimeout;
+    m99Hdl->rdDbgLevel  = dbgLevelMbuf;
 
 	/* set MBUF debug level */
 	MBUF_SetStat(m99Hdl->inbuf, NULL, M_BUF_RD_DEBUG_LEVEL, dbgLevelMbuf);
@@ -450,7 +594,7 @@ static int32 M99_Init
                               "WR_BUF/LOWWATER",
                               0 );
 
-    retCode = MBUF_Create( osHdl, DevSem, m99Hdl, outBufferSize,
+    retCode = MBUF_Create( osHdl, m99Hdl->wrSem, m99Hdl, outBufferSize,
                            M99_CH_WIDTH, mode,
                            MBUF_WR , lowWater, outBufferTimeout,
                            m99Hdl->irqHdl,
@@ -475,6 +619,9 @@ static int32 M99_Init
     m99Hdl->rd_offs   = 0;
     m99Hdl->wr_offs   = m99Hdl->RWbufSize;
 
+    m99Hdl->pat.active  = M99_PAT_NONE;
+    m99Hdl->pat.pending = M99_PAT_NONE;
+
 
 
     /*-------------------------------------+
@@ -518,13 +665,14 @@ static int32 M99_Init
     +-------------------------------------*/
     /* fill sram read buffer with dummy values */
     for( i=0; i < (m99Hdl->RWbufSize/2); i++ )
-        MWRITE_D16( m99Hdl->maSRAM, (m99Hdl->rd_offs+(2*i)), i );  /* read buf: 0..RW_BUF_SIZE */
+        M99_WR( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM, (m99Hdl->rd_offs+(2*i)), i );  /* read buf: 0..RW_BUF_SIZE */
 
 
     /* fill sram write buffer with dummy values */
     MBLOCK_SET_D16( (m99Hdl->maSRAM),
                     (m99Hdl->wr_offs),
                     ((int)m99Hdl->RWbufSize), 0xa55a);
+    m99Hdl->bus.grp[M99_BUS_SRAM].writes += m99Hdl->RWbufSize/2;
 
 
 
@@ -532,13 +680,13 @@ static int32 M99_Init
     |                                      |
     +-------------------------------------*/
     /* setup MC68230 ========== */
-    MWRITE_D16( m99Hdl->maM68230, PGC_REG,  zero );
-    MWRITE_D16( m99Hdl->maM68230, PAD_REG,  0xaa );
-    MWRITE_D16( m99Hdl->maM68230, PADD_REG, 0xff );
-    MWRITE_D16( m99Hdl->maM68230, PBDD_REG, 0x00 );
-    MWRITE_D16( m99Hdl->maM68230, PAC_REG,  zero );
-    MWRITE_D16( m99Hdl->maM68230, PBC_REG,  zero );
-    MWRITE_D16( m99Hdl->maM68230, TIV_REG,  0x0f ); /* like default after reset */
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PGC_REG,  zero );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAD_REG,  0xaa );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PADD_REG, 0xff );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PBDD_REG, 0x00 );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAC_REG,  zero );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PBC_REG,  zero );
+    M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TIV_REG,  0x0f ); /* like default after reset */
 
     /* medium irq frequenz */
     retCode = DESC_GetUInt32( descHdl,
@@ -560,12 +708,87 @@ static int32 M99_Init
 
 	m99Hdl->irqLatency = 0xffffffff;
 	m99Hdl->maxIrqLatency = 0xffffffff;
+	m99Hdl->ivStat.min = 0xffffffff;
+
+    /* flight recorder */
+    retCode = DESC_GetUInt32( descHdl,
+                              0,                  /* off */
+                              &m99Hdl->frecThresh,
+                              "M99_FREC_THRESHOLD",
+                              NULL );
+    if( retCode != 0 && retCode != ERR_DESC_KEY_NOTFOUND ) goto CLEANUP;
+    retCode = 0;
+
+    retCode = DESC_GetUInt32( descHdl,
+                              M99_FREC_SIZE/2,
+                              &m99Hdl->frecPost,
+                              "M99_FREC_POST",
+                              NULL );
+    if( retCode != 0 && retCode != ERR_DESC_KEY_NOTFOUND ) goto CLEANUP;
+    retCode = 0;
+
+    if( m99Hdl->frecPost >= M99_FREC_SIZE )
+        m99Hdl->frecPost = M99_FREC_SIZE-1;
+    frecArm( m99Hdl );
+    isrtReset( m99Hdl );
+
+    /* irq storm protection, budget needs the cycle counter */
+    retCode = DESC_GetUInt32( descHdl,
+                              0,                  /* off */
+                              &m99Hdl->storm.maxRate,
+                              "M99_STORM_RATE",
+                              NULL );
+    if( retCode != 0 && retCode != ERR_DESC_KEY_NOTFOUND ) goto CLEANUP;
+    retCode = 0;
+
+    retCode = DESC_GetUInt32( descHdl,
+                              0,                  /* off */
+                              &m99Hdl->storm.budget,
+                              "M99_STORM_BUDGET",
+                              NULL );
+    if( retCode != 0 && retCode != ERR_DESC_KEY_NOTFOUND ) goto CLEANUP;
+    retCode = 0;
+
+    retCode = DESC_GetUInt32( descHdl,
+                              M99_STORM_RAISE,
+                              &m99Hdl->storm.mode,
+                              "M99_STORM_MODE",
+                              NULL );
+    if( retCode != 0 && retCode != ERR_DESC_KEY_NOTFOUND ) goto CLEANUP;
+    retCode = 0;
+
+    retCode = DESC_GetUInt32( descHdl,
+                              100,
+                              &m99Hdl->stormPause,
+                              "M99_STORM_PAUSE",
+                              NULL );
+    if( retCode != 0 && retCode != ERR_DESC_KEY_NOTFOUND ) goto CLEANUP;
+    retCode = 0;
+
+    if( m99Hdl->storm.maxRate > M99_CLOCK_FREQ )
+        m99Hdl->storm.maxRate = M99_CLOCK_FREQ;
+    if( m99Hdl->storm.budget > 1000 || !M99_HAS_CYCLES )
+        m99Hdl->storm.budget = M99_HAS_CYCLES ? 1000 : 0;
+    if( m99Hdl->stormPause < 1 || 60000 < m99Hdl->stormPause )
+        m99Hdl->stormPause = 100;
+    m99Hdl->storm.hasCycles = M99_HAS_CYCLES;
+
+    if( m99Hdl->storm.mode == M99_STORM_STOP )
+    {
+        retCode = OSS_AlarmCreate( osHdl, stormResume, m99Hdl,
+                                   &m99Hdl->stormAlm );
+        if( retCode ) goto CLEANUP;
+    }
+    else
+        m99Hdl->storm.mode = M99_STORM_RAISE;
 
     /* preload timer register */
     m99Hdl->laststep   = -1;
     setTime( m99Hdl, m99Hdl->medPreLoad );
+    m99Hdl->vtRun      = m99Hdl->medPreLoad;
 
-    MWRITE_D16( m99Hdl->maM68230, TC_REG, 0x81); /* timer irq (disabled) */
+    M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TC_REG, 0x81 ); /* timer irq (disabled) */
+    m99Hdl->shTc = 0x81;
 
     DESC_Exit( &descHdl );
     return( retCode );
@@ -580,6 +803,17 @@ static int32 M99_Init
     }
     else
     {
+        /* no hw access, just free what is already set up */
+        if( m99Hdl->inbuf )
+           MBUF_Remove( &m99Hdl->inbuf );
+        if( m99Hdl->outbuf )
+           MBUF_Remove( &m99Hdl->outbuf );
+        if( m99Hdl->cfgSem )
+           OSS_SemRemove( osHdl, &m99Hdl->cfgSem );
+        if( m99Hdl->rdSem )
+           OSS_SemRemove( osHdl, &m99Hdl->rdSem );
+        if( m99Hdl->wrSem )
+           OSS_SemRemove( osHdl, &m99Hdl->wrSem );
 		OSS_MemFree(osHdl, m99Hdl, m99Hdl->OwnMemSize);
     }/*if*/
 
@@ -607,6 +841,7 @@ static int32 M99_Exit
 )
 {
     M99_HANDLE*       m99Hdl;
+    OSS_IRQ_STATE     irqState;
     int i;
 
 
@@ -614,12 +849,18 @@ static int32 M99_Exit
 
     DBGWRT_1((DBH, "LL - M99_Exit\n" )  );
 
+    /* no timer restart from now on */
+    if( m99Hdl->stormAlm )
+       OSS_AlarmRemove( m99Hdl->osHdl, &m99Hdl->stormAlm );
+
     /* disable IRQ's */
-    MWRITE_D16( m99Hdl->maM68230, TC_REG, 0x81 );    /* timer irq (disabled) */
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    tcWrite( m99Hdl, 0x81 );    /* timer irq (disabled) */
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
 
 
     /* clear LED's */
-    MWRITE_D16( m99Hdl->maM68230, PAD_REG, 0xff );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAD_REG, 0xff );
 
     if( m99Hdl->inbuf )
        MBUF_Remove( &m99Hdl->inbuf );
@@ -627,12 +868,29 @@ static int32 M99_Exit
     if( m99Hdl->outbuf )
        MBUF_Remove( &m99Hdl->outbuf );
 
+    if( m99Hdl->cfgSem )
+       OSS_SemRemove( m99Hdl->osHdl, &m99Hdl->cfgSem );
+    if( m99Hdl->rdSem )
+       OSS_SemRemove( m99Hdl->osHdl, &m99Hdl->rdSem );
+    if( m99Hdl->wrSem )
+       OSS_SemRemove( m99Hdl->osHdl, &m99Hdl->wrSem );
+
     /* deinit lldrv memory */
     for( i = 0; i < M99_MAX_SIGNALS; i++ )
     {
         if( m99Hdl->cond[i] != NULL )
            OSS_SigRemove( m99Hdl->osHdl, &m99Hdl->cond[i] );
     }/*for*/
+    for( i = 0; i < M99_VT_NUM; i++ )
+    {
+        if( m99Hdl->vt[i].sig != NULL )
+           OSS_SigRemove( m99Hdl->osHdl, &m99Hdl->vt[i].sig );
+    }/*for*/
+
+    if( m99Hdl->frecSig != NULL )
+       OSS_SigRemove( m99Hdl->osHdl, &m99Hdl->frecSig );
+    if( m99Hdl->stormSig != NULL )
+       OSS_SigRemove( m99Hdl->osHdl, &m99Hdl->stormSig );
 
 	/* cleanup debug */
 	DBGEXIT((&DBH));
@@ -672,17 +930,30 @@ static int32 M99_Read
 )
 {
     M99_HANDLE*       m99Hdl = (M99_HANDLE*) llHdl;
+    int32             error;
 
     DBGWRT_1((DBH, "LL - M99_Read\n" )  );
     DBGWRT_2((DBH, "     M99_Read: from ch=%d\n",ch )  );
 
-    *(u_int16*)value = MREAD_D16(m99Hdl->maSRAM, m99Hdl->rd_offs );
+    if( (error = OSS_SemWait( m99Hdl->osHdl, m99Hdl->rdSem,
+                              OSS_SEM_WAITFOREVER )) )
+        return( error );
+
+    /* the SRAM read area is pattern bank 0 during playback */
+    if( m99Hdl->pat.mode != M99_PAT_OFF )
+    {
+        OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
+        return( ERR_LL_DEV_BUSY );
+    }/*if*/
+
+    *(u_int16*)value = M99_RD( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM, m99Hdl->rd_offs );
 
     m99Hdl->rd_offs +=2;
 
     if( m99Hdl->rd_offs >= m99Hdl->RWbufSize )
         m99Hdl->rd_offs = 0;
 
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
     return(0);
 }/*M99_Read*/
 
@@ -710,18 +981,32 @@ static int32 M99_Write
 )
 {
     M99_HANDLE*       m99Hdl = (M99_HANDLE*) llHdl;
+    int32             error;
 
     DBGWRT_1((DBH, "LL - M99_Write\n" )  );
     DBGWRT_2((DBH, "     M99_Write: value=0x%08x to ch=%d\n", value, ch )  );
 
-    MWRITE_D16(m99Hdl->maSRAM, m99Hdl->wr_offs, value);
+    if( (error = OSS_SemWait( m99Hdl->osHdl, m99Hdl->wrSem,
+                              OSS_SEM_WAITFOREVER )) )
+        return( error );
+
+    /* SRAM and port A belong to the playback */
+    if( m99Hdl->pat.mode != M99_PAT_OFF )
+    {
+        OSS_SemSignal( m99Hdl->osHdl, m99Hdl->wrSem );
+        return( ERR_LL_DEV_BUSY );
+    }/*if*/
+
+    M99_WR( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM, m99Hdl->wr_offs, value );
 
     m99Hdl->wr_offs +=2;
 
     if( m99Hdl->wr_offs >= (m99Hdl->RWbufSize*2) )
         m99Hdl->wr_offs = m99Hdl->RWbufSize;
 
-    MWRITE_D16( m99Hdl->maM68230, PAD_REG, value );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAD_REG, value );
+
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->wrSem );
     return(0);
 }/*M99_Write*/
 
@@ -730,9 +1015,53 @@ static int32 M99_Write
  *  Description:  Changes the device state.
  *
  *               code                      values
- *                M_MK_IRQ_ENABLE           0..1
+ *                M_MK_IRQ_ENABLE           0..1 (a timer halted by
+ *                                          M99_STORM_STOP stays halted)
  *                M_LL_DEBUG_LEVEL          see oss.h
  *                M_LL_IRQ_COUNT            irq count
+ *                M99_FREC_THRESH           trigger latency [ticks], 0=off
+ *                                          (re-arms the recorder)
+ *                M99_FREC_POST             0..M99_FREC_SIZE-1
+ *                M99_FREC_STATE            any: re-arm the recorder
+ *                M99_SIG_set_frec          signal for frozen window
+ *                M99_SIG_clr_frec          remove it
+ *                M99_SIG_set_condN         also clears send counter N
+ *                M99_ISRT                  0..1 isr time measurement
+ *                                          (always resets the results)
+ *                M99_OVR_LIMIT             overrun latency [ticks],
+ *                                          0=off (no overruns counted)
+ *                M99_STORM_RATE            max. irq rate 0..250000 irq/s,
+ *                                          0=off
+ *                M99_STORM_BUDGET          max. isr cpu load 0..1000
+ *                                          [1/1000], 0=off (needs a host
+ *                                          cycle counter)
+ *                M99_STORM_MODE            M99_STORM_RAISE | _STOP
+ *                M99_STORM_PAUSE           1..60000 ms timer halt
+ *                M99_STORM_EVENTS          any: clear events and peaks,
+ *                                          drop the preload floor and
+ *                                          restart a halted timer
+ *                                          (while raised, M99_TIMERVAL
+ *                                          and M99_BLK_CONFIG preloads
+ *                                          below the floor are set to
+ *                                          the floor, M99_TIMERVAL
+ *                                          getstat returns the value
+ *                                          in use)
+ *                M99_SIG_set_storm         signal for throttle events
+ *                M99_SIG_clr_storm         remove it
+ *                M99_CAP_MODE              M99_CAP_xxx, needs a buffered
+ *                                          read mode and a read buffer
+ *                                          size multiple of M99_CAP_REC
+ *                                          (switching on or off clears
+ *                                          the read buffer, busy while
+ *                                          a read waits for data)
+ *                M99_CAP_LOST              any: clear lost records
+ *                M99_PAT_MODE              M99_PAT_xxx, M99_PAT_OFF stops
+ *                                          (a loaded next bank is kept,
+ *                                          SRAM reads and writes are
+ *                                          busy while playing)
+ *                M99_PAT_UNDERRUNS         any: clear playback counters
+ *
+ *                Setstats are serialized by cfgSem (see M99_Info).
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl         pointer to ll-drv data structure
@@ -752,10 +1081,43 @@ static int32 M99_SetStat
     int32  ch,
     INT32_OR_64  value32_or_64
 )
+{
+    M99_HANDLE*	m99Hdl = (M99_HANDLE*) llHdl;
+    int32       retCode;
+
+    if( (retCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->cfgSem,
+                                OSS_SEM_WAITFOREVER )) )
+        return( retCode );
+
+    retCode = setStat( m99Hdl, code, value32_or_64 );
+
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->cfgSem );
+    return( retCode );
+}/*M99_SetStat*/
+
+/********************************* setStat ***********************************
+ *
+ *  Description:  Executes a setstat (see M99_SetStat), cfgSem is held
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl        ll drv handle
+ *                code          setstat code
+ *                value32_or_64 setstat value or pointer to blocksetstat data
+ *
+ *  Output.....:  return 0 | error code
+ *
+ *  Globals....:  ---
+ *
+ ****************************************************************************/
+static int32 setStat
+(
+    M99_HANDLE   *m99Hdl,
+    int32        code,
+    INT32_OR_64  value32_or_64
+)
 {
     register    u_int8 tc_reg;
     int32       cond;
-    M99_HANDLE*	m99Hdl = (M99_HANDLE*) llHdl;
     int32       retCode;
     int32	value = (int32)value32_or_64;	/* 32bit value		       */
     INT32_OR_64	valueP	= value32_or_64;	/* stores 32/64bit pointer     */
@@ -766,8 +1128,221 @@ static int32 M99_SetStat
     switch(code)
     {
 	    case M99_MAX_IRQ_LAT:
-	    m99Hdl->maxIrqLatency = value;
-	    break;
+	    {
+	        /* isr does read-modify-write */
+	        OSS_IRQ_STATE irqState;
+
+	        irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+	        m99Hdl->maxIrqLatency = value;
+	        OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+	        break;
+	    }
+        /*--------------------------+
+        |  flight recorder          |
+        +--------------------------*/
+        case M99_FREC_THRESH:
+        case M99_FREC_STATE:
+        {
+            OSS_IRQ_STATE irqState;
+
+            if( code == M99_FREC_THRESH )
+            {
+                if( value<0 || 0xffffff<value )
+                    return(ERR_LL_ILL_PARAM);
+            }
+
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            if( code == M99_FREC_THRESH )
+                m99Hdl->frecThresh = value;
+            frecArm( m99Hdl );
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+            break;
+        }
+        /*--------------------------+
+        |  isr execution time       |
+        +--------------------------*/
+        case M99_ISRT:
+        {
+            OSS_IRQ_STATE irqState;
+
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            m99Hdl->isrtOn = value ? 1 : 0;
+            isrtReset( m99Hdl );
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+            break;
+        }
+        case M99_OVR_LIMIT:
+            if( value<0 || 0xffffff<value )
+                return(ERR_LL_ILL_PARAM);
+            m99Hdl->ovrLimit = value;
+            break;
+        case M99_FREC_POST:
+            if( value<0 || M99_FREC_SIZE<=value )
+                return(ERR_LL_ILL_PARAM);
+            m99Hdl->frecPost = value;
+            break;
+        case M99_SIG_set_frec:
+            if( m99Hdl->frecSig != NULL )
+                return( ERR_OSS_SIG_SET );
+            return( OSS_SigCreate( m99Hdl->osHdl, value, &m99Hdl->frecSig ) );
+        case M99_SIG_clr_frec:
+            if( m99Hdl->frecSig == NULL )
+                return( ERR_OSS_SIG_SET );
+            return( OSS_SigRemove( m99Hdl->osHdl, &m99Hdl->frecSig ) );
+        /*--------------------------+
+        |  irq storm protection     |
+        +--------------------------*/
+        case M99_STORM_RATE:
+        case M99_STORM_BUDGET:
+        case M99_STORM_MODE:
+        case M99_STORM_EVENTS:
+        {
+            OSS_IRQ_STATE irqState;
+            int32         paused;
+
+            if( code == M99_STORM_RATE && (value<0 || M99_CLOCK_FREQ<value) )
+                return(ERR_LL_ILL_PARAM);
+            /* no cycle counter, no load measurement */
+            if( code == M99_STORM_BUDGET &&
+                (value<0 || 1000<value || (value && !M99_HAS_CYCLES)) )
+                return(ERR_LL_ILL_PARAM);
+            if( code == M99_STORM_MODE )
+            {
+                if( value != M99_STORM_RAISE && value != M99_STORM_STOP )
+                    return(ERR_LL_ILL_PARAM);
+                if( value == M99_STORM_STOP && m99Hdl->stormAlm == NULL &&
+                    (retCode = OSS_AlarmCreate( m99Hdl->osHdl, stormResume,
+                                                m99Hdl, &m99Hdl->stormAlm )) )
+                    return( retCode );
+            }/*if*/
+
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            paused = m99Hdl->storm.paused;
+            switch( code )
+            {
+                case M99_STORM_RATE:   m99Hdl->storm.maxRate = value; break;
+                case M99_STORM_BUDGET: m99Hdl->storm.budget  = value; break;
+                case M99_STORM_MODE:   m99Hdl->storm.mode    = value; break;
+                default:
+                    m99Hdl->storm.events   = 0;
+                    m99Hdl->storm.peakRate = 0;
+                    m99Hdl->storm.peakLoad = 0;
+                    m99Hdl->storm.floor    = 0;
+                    if( !m99Hdl->jittermode && !m99Hdl->vtActive )
+                        setTime( m99Hdl, m99Hdl->medPreLoad );
+                    break;
+            }/*switch*/
+            stormWinReset( m99Hdl );
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+            /* alarm handler restarts the timer itself */
+            if( code == M99_STORM_EVENTS && paused )
+            {
+                OSS_AlarmClear( m99Hdl->osHdl, m99Hdl->stormAlm );
+                stormResume( m99Hdl );
+            }/*if*/
+            break;
+        }
+        /*--------------------------+
+        |  port B capture           |
+        +--------------------------*/
+        case M99_CAP_MODE:
+        case M99_CAP_LOST:
+        {
+            OSS_IRQ_STATE irqState;
+            int32         bufMode;
+
+            if( code == M99_CAP_MODE && value != M99_CAP_OFF )
+            {
+                if( value != M99_CAP_ALL && value != M99_CAP_CHANGE )
+                    return(ERR_LL_ILL_PARAM);
+                /* records are never split at the buffer end */
+                if( MBUF_GetBufferMode( m99Hdl->inbuf, &bufMode ) ||
+                    bufMode == M_BUF_USRCTRL ||
+                    m99Hdl->rdBufSize % sizeof(M99_CAP_REC) )
+                    return(ERR_LL_ILL_PARAM);
+            }/*if*/
+
+            if( (retCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->rdSem,
+                                        OSS_SEM_WAITFOREVER )) )
+                return( retCode );
+
+            /*
+             * SRAM bytes and records must not share the buffer: a
+             * record behind single bytes is unaligned and never fits
+             * at the buffer end. Switching starts with an empty buffer.
+             */
+            if( code == M99_CAP_MODE &&
+                (m99Hdl->capMode == M99_CAP_OFF) != (value == M99_CAP_OFF) &&
+                (retCode = capBufReset( m99Hdl )) )
+            {
+                OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
+                return( retCode );
+            }/*if*/
+
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            if( code == M99_CAP_MODE )
+                m99Hdl->capMode = value;
+            m99Hdl->capLost    = 0;
+            m99Hdl->capLostRec = 0;
+            m99Hdl->capPrev    = 0xffffffff;
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+            OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
+            break;
+        }
+        /*--------------------------+
+        |  port A playback          |
+        +--------------------------*/
+        case M99_PAT_MODE:
+        case M99_PAT_UNDERRUNS:
+        {
+            OSS_IRQ_STATE irqState;
+
+            if( code == M99_PAT_MODE && value != M99_PAT_OFF &&
+                value != M99_PAT_LOOP && value != M99_PAT_ONESHOT )
+                return(ERR_LL_ILL_PARAM);
+
+            /* no write call may run when the playback takes SRAM */
+            if( (retCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->wrSem,
+                                        OSS_SEM_WAITFOREVER )) )
+                return( retCode );
+
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            if( code == M99_PAT_MODE )
+            {
+                if( value == M99_PAT_OFF )
+                {
+                    m99Hdl->pat.active = M99_PAT_NONE;
+                    m99Hdl->pat.idx    = 0;
+                }/*if*/
+                m99Hdl->pat.mode = value;
+            }
+            else
+            {
+                m99Hdl->pat.steps     = 0;
+                m99Hdl->pat.loops     = 0;
+                m99Hdl->pat.swaps     = 0;
+                m99Hdl->pat.underruns = 0;
+            }/*if*/
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+            OSS_SemSignal( m99Hdl->osHdl, m99Hdl->wrSem );
+            break;
+        }
+        case M99_STORM_PAUSE:
+            if( value<1 || 60000<value )
+                return(ERR_LL_ILL_PARAM);
+            m99Hdl->stormPause = value;
+            break;
+        case M99_SIG_set_storm:
+            if( m99Hdl->stormSig != NULL )
+                return( ERR_OSS_SIG_SET );
+            return( OSS_SigCreate( m99Hdl->osHdl, value, &m99Hdl->stormSig ) );
+        case M99_SIG_clr_storm:
+            if( m99Hdl->stormSig == NULL )
+                return( ERR_OSS_SIG_SET );
+            return( OSS_SigRemove( m99Hdl->osHdl, &m99Hdl->stormSig ) );
         /*--------------------------+
         |  debug level              |
         +--------------------------*/
@@ -778,37 +1353,65 @@ static int32 M99_SetStat
         |  enable jitter mode       |
         +--------------------------*/
         case M99_JITTER:
+        {
+            OSS_IRQ_STATE irqState;
+
+            /* isr reloads the preload in jitter mode */
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
             m99Hdl->jittermode = value;
             setTime(m99Hdl, m99Hdl->timerval);
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
             break;
+        }
         /*--------------------------+
         |  define irq rate          |
         +--------------------------*/
         case M99_TIMERVAL:
+        {
+            OSS_IRQ_STATE irqState;
+
             if( value<1 || 0xffffff<value )           /* illgal timer value ? */
                 return(ERR_LL_ILL_PARAM);
 
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            vtStop( m99Hdl );         /* restart breaks the wheel time */
             m99Hdl->medPreLoad = value;
             m99Hdl->laststep = -1;
-
-            tc_reg = (u_int8)MREAD_D16( m99Hdl->maM68230, TC_REG );      /* get timer control */
-            MWRITE_D16( m99Hdl->maM68230, TC_REG, tc_reg & 0xfe);/* timer halt */
-            setTime( m99Hdl, value );                              /* load timer */
-            MWRITE_D16( m99Hdl->maM68230, TS_REG, 0x01 );        /* timer reset */
-            MWRITE_D16( m99Hdl->maM68230, TC_REG, tc_reg );       /* timer control restore */
+            m99Hdl->jitMin   = 0;     /* profile belongs to old preload */
+            m99Hdl->jitMax   = 0;
+
+            tc_reg = m99Hdl->shTc;                       /* get timer control */
+            tcWrite( m99Hdl, tc_reg & 0xfe );            /* timer halt */
+            setTime( m99Hdl, value );                    /* load timer */
+            M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG, 0x01 ); /* timer reset */
+            m99Hdl->vtRun = m99Hdl->timerval;            /* storm floor */
+            tcWrite( m99Hdl, tc_reg );                   /* timer control restore */
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
             break;
+        }
         /*--------------------------+
         |  enable interrupts        |
         +--------------------------*/
         case M_MK_IRQ_ENABLE:
+        {
+            OSS_IRQ_STATE irqState;
+
+            /* isr and storm alarm change TC_REG too */
+            irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+            m99Hdl->irqEnabled = value ? 1 : 0;
+            /* a timer halted by the storm protection stays halted */
+            tc_reg = m99Hdl->storm.paused ? 0xfe : 0xff;
             if( value ) {
-                MWRITE_D16( m99Hdl->maM68230, TC_REG, 0xa1 );    /* timer irq (enabled) */
+                tcWrite( m99Hdl, 0xa1 & tc_reg );    /* timer irq (enabled) */
             }
             else {
-                MWRITE_D16( m99Hdl->maM68230, TC_REG, 0x81 );    /* timer irq (disabled) */
-				MWRITE_D16(m99Hdl->maM68230, TS_REG, 0xff);  /* clear interrupt */
+                vtStop( m99Hdl );           /* wheel time needs every timer irq */
+                tcWrite( m99Hdl, 0x81 & tc_reg );    /* timer irq (disabled) */
+				M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG, 0xff );  /* clear interrupt */
 			}
+            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
             break;
+        }
         /*--------------------------+
         |  set/clr signal cond 1..4 |
         +--------------------------*/
@@ -829,6 +1432,7 @@ static int32 M99_SetStat
            else
            {
                retCode = OSS_SigCreate( m99Hdl->osHdl, value, &m99Hdl->cond[cond]);
+               m99Hdl->sigSent[cond] = 0;
            }/*if*/
 #ifdef MASK_IRQ_ILLEGAL
            OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );  /* ENABLE irqs */
@@ -860,10 +1464,27 @@ static int32 M99_SetStat
             if(    ( M_RDBUF_OF <= code && code <= (M_WRBUF_OF+0x0f) )
                 || ( M_RDBUF_BLK_OF <= code && code <= (M_RDBUF_BLK_OF+0x0f) )
               )
-                return( MBUF_SetStat( m99Hdl->inbuf,
-                                      m99Hdl->outbuf,
-                                      code,
-                                      value ) );
+            {
+                /* buffer setup must not change under a running read/write */
+                if( (retCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->rdSem,
+                                            OSS_SEM_WAITFOREVER )) )
+                    return( retCode );
+                if( (retCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->wrSem,
+                                            OSS_SEM_WAITFOREVER )) )
+                {
+                    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
+                    return( retCode );
+                }
+
+                retCode = MBUF_SetStat( m99Hdl->inbuf,
+                                        m99Hdl->outbuf,
+                                        code,
+                                        value );
+
+                OSS_SemSignal( m99Hdl->osHdl, m99Hdl->wrSem );
+                OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
+                return( retCode );
+            }/*if*/
 
             if( M_LL_BLK_OF <= code && code <= (M_DEV_BLK_OF + 0xff)  )
                 return( setStatBlock( m99Hdl, code, (M_SETGETSTAT_BLOCK*) valueP ) );
@@ -873,7 +1494,7 @@ static int32 M99_SetStat
     }/*switch*/
 
     return(0);
-}/*M99_SetStat*/
+}/*setStat*/
 
 /****************************** M99_GetStat **********************************
  *
@@ -888,6 +1509,38 @@ static int32 M99_SetStat
  *                M_LL_ID_CHECK         eeprom id is checked in M99_Init
  *                M_LL_DEBUG_LEVEL      see oss.h
  *                M_MK_BLK_REV_ID       pointer to the ident function table
+ *                M99_FREC_THRESH       trigger latency [ticks], 0=off
+ *                M99_FREC_POST         records after trigger
+ *                M99_FREC_STATE        M99_FREC_xxx
+ *                M99_SIG_set_frec      signal for frozen window, 0=none
+ *                M99_BLK_FREC          M99_FREC_WINDOW
+ *                M99_SIG_SEQ           irq seq number of the last irq that
+ *                                      sent a signal (read in the signal
+ *                                      handler to detect merged signals)
+ *                M99_BLK_SIGSTAT       M99_SIGSTAT
+ *                M99_ISRT              isr time measurement enabled
+ *                M99_BLK_ISRTIME       M99_ISRTIME
+ *                M99_BLK_STATS         M99_STATS (histogram counts since
+ *                                      init, readers use differences)
+ *                M99_OVR_LIMIT         overrun latency [ticks], 0=off
+ *                M99_BLK_IVSTAT        M99_IVSTAT since last call, the
+ *                                      stats are cleared with the same
+ *                                      irq mask (no irq lost or counted
+ *                                      twice between intervals)
+ *                M99_BLK_BUSSTAT       M99_BUSSTAT (isr accesses only
+ *                                      counted while M99_ISRT is on)
+ *                M99_STORM_RATE        max. irq rate [irq/s], 0=off
+ *                M99_STORM_BUDGET      max. isr cpu load [1/1000], 0=off
+ *                M99_STORM_MODE        M99_STORM_xxx
+ *                M99_STORM_PAUSE       timer halt [ms]
+ *                M99_STORM_EVENTS      throttle events
+ *                M99_SIG_set_storm     signal for throttle events, 0=none
+ *                M99_BLK_STORM         M99_STORM_STAT
+ *                M99_CAP_MODE          M99_CAP_xxx
+ *                M99_CAP_LOST          capture records lost (buffer full)
+ *                M99_PAT_MODE          M99_PAT_xxx
+ *                M99_PAT_UNDERRUNS     playback underruns
+ *                M99_BLK_PATSTAT       M99_PATSTAT
  *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl  pointer to ll-drv data structure
@@ -910,7 +1563,6 @@ static int32 M99_GetStat
 )
 {
     int32       cond;
-    int32       processId;
     int32	*valueP = (int32*)value32_or_64P;	/* pointer to 32bit value      */
     INT32_OR_64	*value64P = value32_or_64P;		/* stores 32/64bit pointer     */
     //M_SG_BLOCK	*blk      = (M_SG_BLOCK*)value32_or_64P;/* stores block struct pointer */
@@ -928,15 +1580,68 @@ static int32 M99_GetStat
 		/* get timer ticks elapsed since last irq */
 	    case M99_GET_TIME:
 		{
+			/*
+			 * The counter runs down from vtRun, timerval may already be
+			 * the next period (jitter step, vtimers, storm floor).
+			 */
 			OSS_IRQ_STATE irqState;
 			irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );  /* DISABLE irqs */
-			*valueP = m99Hdl->timerval - getTime( m99Hdl );
+			*valueP = m99Hdl->vtRun - getTime( m99Hdl );
 			OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
 			break;
 		}
 	    case M99_MAX_IRQ_LAT:
 			*valueP = m99Hdl->maxIrqLatency;
 			break;
+	    case M99_SIG_SEQ:
+			*valueP = m99Hdl->sigSeq;
+			break;
+	    case M99_ISRT:
+			*valueP = m99Hdl->isrtOn;
+			break;
+	    case M99_OVR_LIMIT:
+			*valueP = m99Hdl->ovrLimit;
+			break;
+	    case M99_FREC_THRESH:
+			*valueP = m99Hdl->frecThresh;
+			break;
+	    case M99_FREC_POST:
+			*valueP = m99Hdl->frecPost;
+			break;
+	    case M99_FREC_STATE:
+			*valueP = m99Hdl->frecState;
+			break;
+	    case M99_SIG_set_frec:
+			return( sigInfo( m99Hdl, &m99Hdl->frecSig, valueP ));
+	    case M99_STORM_RATE:
+			*valueP = m99Hdl->storm.maxRate;
+			break;
+	    case M99_STORM_BUDGET:
+			*valueP = m99Hdl->storm.budget;
+			break;
+	    case M99_STORM_MODE:
+			*valueP = m99Hdl->storm.mode;
+			break;
+	    case M99_STORM_PAUSE:
+			*valueP = m99Hdl->stormPause;
+			break;
+	    case M99_STORM_EVENTS:
+			*valueP = m99Hdl->storm.events;
+			break;
+	    case M99_CAP_MODE:
+			*valueP = m99Hdl->capMode;
+			break;
+	    case M99_CAP_LOST:
+			*valueP = m99Hdl->capLost;
+			break;
+	    case M99_PAT_MODE:
+			*valueP = m99Hdl->pat.mode;
+			break;
+	    case M99_PAT_UNDERRUNS:
+			*valueP = m99Hdl->pat.underruns;
+			break;
+	    case M99_SIG_set_storm:
+			return( sigInfo( m99Hdl, &m99Hdl->stormSig, valueP ));
         /*------------------+
         |  get ch count     |
         +------------------*/
@@ -999,15 +1704,7 @@ static int32 M99_GetStat
         case M99_SIG_set_cond3:
         case M99_SIG_set_cond4:
            cond = code - (M99_SIG_set_cond1);      /* condition nr */
-           if( m99Hdl->cond[cond] == NULL )   /* not defined ? */
-           {
-			   *valueP = 0;
-           }
-           else
-           {
-			   OSS_SigInfo( m99Hdl->osHdl, m99Hdl->cond[cond], valueP, &processId);           }/*if*/
-
-           break;
+           return( sigInfo( m99Hdl, &m99Hdl->cond[cond], valueP ));
 
         /*--------------------------+
         |  (unknown)                |
@@ -1075,10 +1772,19 @@ static int32 M99_BlockRead
        return( fktRetCode );
     }/*if*/
 
+    if( (fktRetCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->rdSem,
+                                   OSS_SEM_WAITFOREVER )) )
+        return( fktRetCode );
+
     switch( bufMode )
     {
 
         case M_BUF_USRCTRL:
+           if( m99Hdl->pat.mode != M99_PAT_OFF )
+           {
+               fktRetCode = ERR_LL_DEV_BUSY;   /* SRAM holds the pattern */
+               break;
+           }/*if*/
            size = M99_HwBlockRead( m99Hdl, buf, size );
            *nbrRdBytesP = size;
            fktRetCode   = 0; /* ovrwr ERR_MBUF_NO_BUFFER */
@@ -1088,11 +1794,16 @@ static int32 M99_BlockRead
         case M_BUF_RINGBUF_OVERWR:
         case M_BUF_CURRBUF:
         default:
+           /* rdSem is released while waiting, see capBufReset() */
+           m99Hdl->rdWait++;
            fktRetCode = MBUF_Read( m99Hdl->inbuf, (u_int8*) buf, size,
                                    nbrRdBytesP );
+           m99Hdl->rdWait--;
 
     }/*switch*/
 
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->rdSem );
+
     return( fktRetCode );
 
 }/*M99_BlockRead*/
@@ -1124,7 +1835,7 @@ static int32 M99_HwBlockRead
 
     for(i=0; i< (size/2); i++)
     {
-        *hlpP = MREAD_D16(m99Hdl->maSRAM, m99Hdl->rd_offs);
+        *hlpP = M99_RD( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM, m99Hdl->rd_offs );
         m99Hdl->rd_offs +=2;
         hlpP++;
 
@@ -1179,8 +1890,19 @@ static int32 M99_BlockWrite
        return( fktRetCode );
     }/*if*/
 
+    if( (fktRetCode = OSS_SemWait( m99Hdl->osHdl, m99Hdl->wrSem,
+                                   OSS_SEM_WAITFOREVER )) )
+        return( fktRetCode );
+
+    /* the isr doesn't drain the write buffer during playback */
+    if( m99Hdl->pat.mode != M99_PAT_OFF )
+        bufMode = -1;
+
     switch( bufMode )
     {
+        case -1:
+           fktRetCode = ERR_LL_DEV_BUSY;
+           break;
 
         case M_BUF_USRCTRL:
            size = M99_HwBlockWrite( m99Hdl, buf, size );
@@ -1196,6 +1918,8 @@ static int32 M99_BlockWrite
                                     nbrWrBytesP );
     }/*switch*/
 
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->wrSem );
+
     DBGWRT_2((DBH, "    return %08x  nbrWrBytes %d\n", fktRetCode, *nbrWrBytesP)  );
     return( fktRetCode );
 }/*M99_BlockWrite*/
@@ -1222,14 +1946,14 @@ static int32 M99_HwBlockWrite
 {
     u_int16  *bufptr = (u_int16*) buf;                /* ptr to buffer */
 
-    MWRITE_D16(m99Hdl->maSRAM, m99Hdl->wr_offs, *bufptr);
+    M99_WR( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM, m99Hdl->wr_offs, *bufptr );
 
     m99Hdl->wr_offs += 2;
 
     if( m99Hdl->wr_offs == (m99Hdl->RWbufSize*2) )
         m99Hdl->wr_offs = m99Hdl->RWbufSize;
 
-    MWRITE_D16( m99Hdl->maM68230, PAD_REG, *bufptr );
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAD_REG, *bufptr );
 
     return(2);
 }/*M99_HwBlockWrite*/
@@ -1242,6 +1966,22 @@ static int32 M99_HwBlockWrite
  *                this is sended.
  *                It clears the module irq.
  *
+ *                With M99_ISRT enabled, the cpu cycle counter is sampled
+ *                at entry and after each phase, and the 68230 counter
+ *                again at exit (see isrtUpdate).
+ *
+ *                While virtual timers run, irqs that only serve virtual
+ *                timers skip the base period part (signals, SRAM, LED,
+ *                irq counter), see vtExpire.
+ *
+ *                Every timer irq is checked by the storm protection
+ *                (see stormCheck).
+ *
+ *                In capture mode, port B instead of the SRAM goes to the
+ *                read buffer (see capRecord). In playback mode port A
+ *                outputs the next pattern step instead of the write
+ *                buffer or the LED toggle (see patStep).
+ *
  *---------------------------------------------------------------------------
  *  Input......:  llHdl  pointer to ll-drv data structure
  *
@@ -1261,18 +2001,37 @@ static int32 M99_Irq
     int32          gotsize;
     u_int8         isrFired;
 	u_int32 	   tval;
+    u_int32        frecFlags = 0;
+    u_int32        cnt, preload, ticks, period;
+    u_int32        stamp[M99_ISRT_NSTAMPS];
+    u_int32        isrt = m99Hdl->isrtOn;   /* constant during this call */
     OSS_IRQ_STATE  irqState1, irqState2;
+    M99_BUSCNT     bus0 = {0,0,0}, bus1 = {0,0,0};
+
+    M99_CYCLES( stamp[0] );
 
     IDBGWRT_1((DBH, ">> m99_irq_c:\n" )  );
 
-    isrFired = (u_int8)MREAD_D16(m99Hdl->maM68230, TS_REG);  /* interrupt from M68230 */
+    /* per isr access counts only with isr time measurement */
+    if( isrt )
+        busSum( m99Hdl, &bus0 );
+    m99Hdl->bus.isrCalls++;
+
+    isrFired = (u_int8)M99_RD( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG );  /* interrupt from M68230 */
 
     if( !isrFired )
     {
         /* interrupt not from module */
+        if( isrt )
+            m99Hdl->bus.isr.reads++;
         return( LL_IRQ_DEV_NOT);
     }/*if*/
 
+    /* wheel time of this expiry, the counter reloaded the last preload */
+    period        = m99Hdl->vtRun;
+    m99Hdl->vtT  += m99Hdl->vtRun;
+    m99Hdl->vtRun = m99Hdl->timerval;
+
     /* check the IRQ Mask and Spinlock implementation */
     /* call the methods twice to check if double calls cause problems */
     irqState1 = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
@@ -1280,28 +2039,91 @@ static int32 M99_Irq
     OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState2 );
     OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState1 );
 
-	/* get elapsed time since timer expired */
-	tval = m99Hdl->timerval - getTime( m99Hdl );
+    if( isrt ) {
+        M99_CYCLES( stamp[1] );
+    }
+
+	/* get elapsed time since timer expired, counter runs down from vtRun */
+	preload = m99Hdl->vtRun;
+	cnt  = getTime( m99Hdl );
+	tval = preload - cnt;
 	IDBGWRT_3((DBH, " tval=0x%06x\n", tval )  );
 
 	if( tval > m99Hdl->maxIrqLatency )
 		m99Hdl->maxIrqLatency = tval;
 	m99Hdl->irqLatency = tval;
+	m99Hdl->latHist[tval < M99_HIST_SIZE ? tval : M99_HIST_SIZE-1]++;
+
+	/* interval stats */
+	m99Hdl->ivStat.count++;
+	m99Hdl->ivStat.sum += tval;
+	if( tval < m99Hdl->ivStat.min )
+		m99Hdl->ivStat.min = tval;
+	if( tval > m99Hdl->ivStat.max )
+		m99Hdl->ivStat.max = tval;
+	/*
+	 * The counter only shows the time into the running period, a whole
+	 * missed period looks like a short latency. So an overrun is a
+	 * latency above a limit the user chose below the period.
+	 */
+	if( m99Hdl->ovrLimit && tval >= m99Hdl->ovrLimit )
+		m99Hdl->ivStat.overruns++;
+
+    M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG, 0xff );  /* clear interrupt */
+
+    if( isrt )
+        M99_CYCLES( stamp[2] );
+
+    /*------------------+
+    | virtual timers    |
+    +------------------*/
+    if( m99Hdl->vtActive && !vtExpire( m99Hdl, tval ) )
+    {
+        /* only virtual timers due, base period not over */
+        if( isrt ) {
+            M99_CYCLES( stamp[3] );
+            stamp[4] = stamp[3];
+        }
+        goto ISR_DONE;
+    }/*if*/
 
-    MWRITE_D16(m99Hdl->maM68230, TS_REG, 0xff);  /* clear interrupt */
+    /*------------------+
+    | pattern playback  |
+    | (first, least     |
+    |  jitter)          |
+    +------------------*/
+    if( m99Hdl->pat.mode != M99_PAT_OFF )
+        patStep( m99Hdl );
 
     /*------------------+
     | send signal       |
     +------------------*/
     count  = m99Hdl->irqCount & 0x03;        /* 0..3 counter */
 
-    if( m99Hdl->cond[count] != NULL )   	/* signal installed ? */
+    if( m99Hdl->cond[count] != NULL ) {   	/* signal installed ? */
+		/* stamp before sending, the handler may run immediately */
+		m99Hdl->sigSeq = m99Hdl->irqCount;
+		m99Hdl->sigLastSeq[count] = m99Hdl->irqCount;
+		m99Hdl->sigSent[count]++;
 		OSS_SigSend( m99Hdl->osHdl, m99Hdl->cond[count] );
+		frecFlags = M99_FREC_F_SIGSENT;
+	}
+
+    if( m99Hdl->frecState == M99_FREC_ARMED ||
+        m99Hdl->frecState == M99_FREC_TRIGGERED )
+        frecRecord( m99Hdl, tval, frecFlags );
+
+    if( isrt )
+        M99_CYCLES( stamp[3] );
 
     /*------------------+
     | read from SRAM    |
+    | or capture port B |
     +------------------*/
-    if( (buf = MBUF_GetNextBuf( m99Hdl->inbuf, 1, &gotsize)) != 0 )
+    if( m99Hdl->capMode )
+        capRecord( m99Hdl, tval );
+    else if( m99Hdl->pat.mode == M99_PAT_OFF &&     /* SRAM holds pattern */
+             (buf = MBUF_GetNextBuf( m99Hdl->inbuf, 1, &gotsize)) != 0 )
     {
         M99_HwBlockRead( m99Hdl, buf, 1 );         /* read block into buf */
         MBUF_ReadyBuf( m99Hdl->inbuf );                 /* blockread ready */
@@ -1310,7 +2132,8 @@ static int32 M99_Irq
     /*------------------+
     | write to SRAM     |
     +------------------*/
-    if( (buf = MBUF_GetNextBuf( m99Hdl->outbuf, 1, &gotsize)) != 0 )
+    if( m99Hdl->pat.mode == M99_PAT_OFF &&
+        (buf = MBUF_GetNextBuf( m99Hdl->outbuf, 1, &gotsize)) != 0 )
     {
         M99_HwBlockWrite( m99Hdl, buf, 1 );        /* write block from buf */
         MBUF_ReadyBuf( m99Hdl->outbuf );
@@ -1320,19 +2143,48 @@ static int32 M99_Irq
     | toggle LED 0      |
     | (if no block-i/o) |
     +------------------*/
-    if (!buf)
-        MWRITE_D16( m99Hdl->maM68230, PAD_REG, ~(m99Hdl->irqCount ));
+    if (!buf && m99Hdl->pat.mode == M99_PAT_OFF)
+        M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAD_REG, ~(m99Hdl->irqCount) );
+
+    if( isrt )
+        M99_CYCLES( stamp[4] );
 
     /*------------------+
     | calc new irq rate |
     +------------------*/
-    if( m99Hdl->jittermode )
+    if( m99Hdl->jittermode && !m99Hdl->vtActive )
     {
         dostep(m99Hdl);
     }
 
     m99Hdl->irqCount++;
 
+ ISR_DONE:
+    if( isrt )
+    {
+        M99_CYCLES( stamp[5] );
+
+        /*
+         * down counter; if it expired meanwhile it was reloaded with the
+         * preload programmed now (dostep/vtExpire may have changed it)
+         */
+        ticks = getTime( m99Hdl );
+        ticks = ticks <= cnt ? cnt - ticks : cnt + m99Hdl->timerval - ticks;
+        isrtUpdate( m99Hdl, stamp, ticks );
+    }
+
+    if( m99Hdl->storm.maxRate || m99Hdl->storm.budget )
+        stormCheck( m99Hdl, stamp[0], period );
+
+    /* isr share of the bus accesses, not on every irq by default */
+    if( isrt )
+    {
+        busSum( m99Hdl, &bus1 );
+        m99Hdl->bus.isr.reads   += bus1.reads   - bus0.reads;
+        m99Hdl->bus.isr.writes  += bus1.writes  - bus0.writes;
+        m99Hdl->bus.isr.skipped += bus1.skipped - bus0.skipped;
+    }/*if*/
+
     return( LL_IRQ_DEVICE );
 }/*M99_Irq*/
 
@@ -1342,6 +2194,19 @@ static int32 M99_Irq
  *
  *                NOTE: is callable before MXX_Init().
  *
+ *                Lock mode is LL_LOCK_NONE, the driver locks itself:
+ *                - getstats of latency/counter fields don't lock at all
+ *                  or mask the irq for consistent multi-field reads
+ *                - setstats are serialized by cfgSem, timer and latency
+ *                  fields shared with the isr are changed irq masked
+ *                - getstats of signal numbers hold cfgSem, the setstats
+ *                  may remove the signal handle meanwhile
+ *                - read path (M99_Read, M99_BlockRead) holds rdSem,
+ *                  write path (M99_Write, M99_BlockWrite) wrSem. MBUF
+ *                  releases them while waiting. In buffered modes the
+ *                  isr owns rd_offs/wr_offs, in M_BUF_USRCTRL mode the
+ *                  path holding the semaphore does.
+ *
  *---------------------------------------------------------------------------
  *  Input......:  infoType
  *                ...
@@ -1412,7 +2277,7 @@ static int32 M99_Info
 		{
 			u_int32 *lockModeP = va_arg(argptr, u_int32*);
 
-			*lockModeP = LL_LOCK_CALL;
+			*lockModeP = LL_LOCK_NONE;
 		}
 		break;
 
@@ -1428,6 +2293,11 @@ static int32 M99_Info
  *
  *  Description:  Load timer value
  *
+ *                Only preload bytes that differ from the shadow are
+ *                written, a jitter step usually changes CPL/CPM only.
+ *                While the storm protection raised the preload, values
+ *                below the floor are replaced by the floor.
+ *
  *---------------------------------------------------------------------------
  *  Input......:  m99Hdl ll drv handle
  *                timerval  timer value
@@ -1440,91 +2310,1216 @@ static void setTime
     int32      timerval
 )
 {
+    static const u_int16 cpReg[3] = { CPL_REG, CPM_REG, CPH_REG };
+    u_int8 val;
+    int    i;
+
+    /* throttled: jitter steps, vtimers, setstats never go below */
+    if( timerval < (int32)m99Hdl->storm.floor )
+        timerval = m99Hdl->storm.floor;
+
     m99Hdl->timerval = timerval;
+    m99Hdl->bus.preloads++;
 
-    MWRITE_D16( m99Hdl->maM68230, CPL_REG, timerval       & 0xff);
-    MWRITE_D16( m99Hdl->maM68230, CPM_REG, timerval >> 8  & 0xff);
-    MWRITE_D16( m99Hdl->maM68230, CPH_REG, timerval >> 16 & 0xff);
-}/*setTime*/
+    for( i=0; i<3; i++ )
+    {
+        val = (u_int8)(timerval >> (8*i) & 0xff);
 
-static u_int32 getTime( M99_HANDLE *m99Hdl )
-{
-	u_int32 low1, low2, mid, high;
-	MACCESS ma = m99Hdl->maM68230;
+        if( m99Hdl->shCpValid && m99Hdl->shCp[i] == val )
+        {
+            m99Hdl->bus.grp[M99_BUS_PRELOAD].skipped++;
+            continue;
+        }/*if*/
 
-	do {
-		low1 = MREAD_D16( ma, CNTL_REG ) & 0xff;
-		mid  = MREAD_D16( ma, CNTM_REG ) & 0xff;
-		high = MREAD_D16( ma, CNTH_REG ) & 0xff;
-		low2 = MREAD_D16( ma, CNTL_REG ) & 0xff;
-		/*DBGWRT_3((DBH,"h=%02x m=%02x l1=%02x l2=%02x\n",
-		  high, mid, low1, low2 ));*/
-	} while( low2 > low1 );
+        M99_WR( m99Hdl, M99_BUS_PRELOAD, m99Hdl->maM68230, cpReg[i], val );
+        m99Hdl->shCp[i] = val;
+    }/*for*/
 
-	return ((u_int32)(high<<16)) + ((u_int32)(mid<<8)) + low1;
-}
+    m99Hdl->shCpValid = 1;
+}/*setTime*/
 
-/******************************* dostep *************************************
+/******************************* tcWrite *************************************
  *
- *  Description:  Jitter (step) + load new timer value
+ *  Description:  Write timer control register (if changed)
+ *
+ *                TC_REG is never read back, the shadow holds the value
+ *                last written. Caller serializes against the isr.
  *
  *---------------------------------------------------------------------------
  *  Input......:  m99Hdl ll drv handle
+ *                tc     timer control value
  *  Output.....:  -
  *  Globals....:  -
  ****************************************************************************/
-static void dostep
+static void tcWrite
 (
-    M99_HANDLE*       m99Hdl
+    M99_HANDLE *m99Hdl,
+    u_int8     tc
 )
 {
-    int32 end;
-
-    if( m99Hdl->timerval >= (m99Hdl->medPreLoad<<1)-1 )
-        end = m99Hdl->medPreLoad>>1;
-    else if( m99Hdl->timerval <= (m99Hdl->medPreLoad>>1)+1 )
-        end = m99Hdl->medPreLoad<<1;
-    else
-        end = m99Hdl->laststep > 0 ? m99Hdl->medPreLoad<<1 : m99Hdl->medPreLoad>>1;
-
-    m99Hdl->laststep = (end - (int32)m99Hdl->timerval)/2;
-
-    IDBGWRT_2((DBH,"step=%08x time=%08x\n", m99Hdl->laststep, m99Hdl->timerval+m99Hdl->laststep) );
+    if( m99Hdl->shTc == tc )
+    {
+        m99Hdl->bus.grp[M99_BUS_TCTL].skipped++;
+        return;
+    }/*if*/
 
-    setTime( m99Hdl, m99Hdl->timerval+m99Hdl->laststep );
-}/*dostep*/
+    M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TC_REG, tc );
+    m99Hdl->shTc = tc;
+}/*tcWrite*/
 
-/**************************** setStatBlock ***********************************
- *
- *  Description:  decodes the M_SETGETSTAT_BLOCK struct code and executes them.
- *                The known codes are:
+/******************************* busSum **************************************
  *
- *                   M99_SETGETSRAM   size bytes of the data buffer will copied
- *                                    to the sram. It starts from begin of
- *                                    sram. ( size max 128 )
+ *  Description:  Sum of bus access counters of all register groups
  *
  *---------------------------------------------------------------------------
- *  Input......:  blockStruct    the struct with code size and data buffer
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  sum    accesses so far
+ *  Globals....:  -
+ ****************************************************************************/
+static void busSum
+(
+    M99_HANDLE *m99Hdl,
+    M99_BUSCNT *sum
+)
+{
+    int i;
+
+    sum->reads = sum->writes = sum->skipped = 0;
+    for( i=0; i<M99_BUS_NGROUPS; i++ )
+    {
+        sum->reads   += m99Hdl->bus.grp[i].reads;
+        sum->writes  += m99Hdl->bus.grp[i].writes;
+        sum->skipped += m99Hdl->bus.grp[i].skipped;
+    }/*for*/
+}/*busSum*/
+
+/******************************* vtNow ***************************************
  *
- *  Output.....:  0 | error code
+ *  Description:  Current wheel time (must be called with irqs masked)
  *
- *  Globals....:  ---
+ *                The counter runs down from vtRun since the last expiry.
+ *                If it expired again and the isr is still pending, it
+ *                was reloaded with the current preload.
  *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  return  wheel time [ticks]
+ *  Globals....:  -
  ****************************************************************************/
-static int32 setStatBlock
+static u_int64 vtNow
 (
-    M99_HANDLE         *m99Hdl,
-    int32              code,
-    M_SETGETSTAT_BLOCK *blockStruct
+    M99_HANDLE *m99Hdl
 )
 {
-   int32 error;
+    u_int32 ts, cnt;
 
-   switch( code )
+    do {
+        ts  = M99_RD( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG ) & 0x01;
+        cnt = getTime( m99Hdl );
+    } while( ts != (M99_RD( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230,
+                            TS_REG ) & 0x01) );
+
+    if( ts )
+        return( m99Hdl->vtT + m99Hdl->vtRun + m99Hdl->timerval - cnt );
+    return( m99Hdl->vtT + m99Hdl->vtRun - cnt );
+}/*vtNow*/
+
+/******************************* vtExpire ************************************
+ *
+ *  Description:  Serve virtual timers due at this expiry (called from
+ *                M99_Irq while the wheel is active)
+ *
+ *                Each due timer gets its latency (deadline to isr) and
+ *                its signal. Periodic timers advance by whole periods,
+ *                periods already over count as missed. The base period
+ *                (medPreLoad) is an implicit periodic timer.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *                tval   irq latency of this expiry [ticks]
+ *  Output.....:  return  1 if the base period is due
+ *  Globals....:  -
+ ****************************************************************************/
+static u_int32 vtExpire
+(
+    M99_HANDLE *m99Hdl,
+    u_int32    tval
+)
+{
+    M99_VT  *v;
+    u_int32 lat, n, base = 0;
+    int     i;
+
+    m99Hdl->vtHwIrqs++;
+
+    for( i=0; i<M99_VT_NUM; i++ )
+    {
+        v = &m99Hdl->vt[i];
+        if( !v->st.armed || v->deadline > m99Hdl->vtT )
+            continue;
+
+        lat = (u_int32)(m99Hdl->vtT - v->deadline) + tval;
+        if( lat < v->st.latMin )
+            v->st.latMin = lat;
+        if( lat > v->st.latMax )
+            v->st.latMax = lat;
+        v->st.latSum += lat;
+        v->st.expiries++;
+
+        if( v->sig != NULL )
+            OSS_SigSend( m99Hdl->osHdl, v->sig );
+
+        if( v->st.period )
+        {
+            n = (u_int32)(m99Hdl->vtT - v->deadline) / v->st.period;
+            v->deadline += (u_int64)(n + 1) * v->st.period;
+            v->st.missed += n;
+        }
+        else
+            v->st.armed = 0;
+    }/*for*/
+
+    if( m99Hdl->vtBaseNext <= m99Hdl->vtT )
+    {
+        n = (u_int32)(m99Hdl->vtT - m99Hdl->vtBaseNext) / m99Hdl->medPreLoad;
+        m99Hdl->vtBaseNext += (u_int64)(n + 1) * m99Hdl->medPreLoad;
+        m99Hdl->vtBaseIrqs++;
+        base = 1;
+    }/*if*/
+
+    vtUpdate( m99Hdl );
+    return( base );
+}/*vtExpire*/
+
+/******************************* vtUpdate ************************************
+ *
+ *  Description:  Program the preload for the next deadline (irqs masked)
+ *
+ *                The 68230 takes a new preload only at the next reload,
+ *                the period running now is fixed. So the preload written
+ *                here is the length of the period after the running one:
+ *                from the next expiry to the first deadline behind it.
+ *                Deadlines inside the running period are served at the
+ *                next expiry. Without armed timers the wheel stops and
+ *                the base preload is restored.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void vtUpdate
+(
+    M99_HANDLE *m99Hdl
+)
+{
+    u_int64 next, dl;
+    u_int32 len;
+    int     i, armed = 0;
+
+    for( i=0; i<M99_VT_NUM; i++ )
+        armed |= m99Hdl->vt[i].st.armed;
+
+    if( !armed )
+    {
+        if( m99Hdl->vtActive )
+        {
+            m99Hdl->vtActive = 0;
+            setTime( m99Hdl, m99Hdl->medPreLoad );
+        }/*if*/
+        return;
+    }/*if*/
+
+    /* expired with isr pending: the isr programs the preload */
+    if( M99_RD( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG ) & 0x01 )
+        return;
+
+    next = m99Hdl->vtT + m99Hdl->vtRun;
+    dl   = m99Hdl->vtBaseNext;
+    while( dl <= next )
+        dl += m99Hdl->medPreLoad;
+
+    for( i=0; i<M99_VT_NUM; i++ )
+    {
+        M99_VT *v = &m99Hdl->vt[i];
+
+        if( v->st.armed && v->deadline > next && v->deadline < dl )
+            dl = v->deadline;
+    }/*for*/
+
+    len = dl - next > 0xffffff ? 0xffffff : (u_int32)(dl - next);
+    if( len < M99_VT_MIN )
+        len = M99_VT_MIN;
+
+    setTime( m99Hdl, len );
+}/*vtUpdate*/
+
+/******************************* vtStop **************************************
+ *
+ *  Description:  Disarm all virtual timers (irqs masked)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void vtStop
+(
+    M99_HANDLE *m99Hdl
+)
+{
+    int i;
+
+    for( i=0; i<M99_VT_NUM; i++ )
+        m99Hdl->vt[i].st.armed = 0;
+    vtUpdate( m99Hdl );
+}/*vtStop*/
+
+/******************************* vtArm ***************************************
+ *
+ *  Description:  Arm or disarm one virtual timer (M99_BLK_VTIMER)
+ *
+ *                The first armed timer starts the wheel, the base period
+ *                keeps its phase. Timer irqs must be enabled, the wheel
+ *                time is advanced by the isr. M99_TIMERVAL, M99_BLK_CONFIG
+ *                and disabling the irq stop all virtual timers.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *                vt     timer id, first expiry, period, signal
+ *  Output.....:  return  0 | error code
+ *  Globals....:  -
+ ****************************************************************************/
+static int32 vtArm
+(
+    M99_HANDLE       *m99Hdl,
+    const M99_VTIMER *vt
+)
+{
+    OSS_IRQ_STATE  irqState;
+    OSS_SIG_HANDLE *oldSig, *newSig = NULL;
+    M99_VT         *v;
+    int32          error;
+
+    if( vt->id >= M99_VT_NUM ||
+        (vt->period && vt->period < M99_VT_MIN) )
+        return( ERR_LL_ILL_PARAM );
+
+    if( vt->first && !m99Hdl->irqEnabled )
+        return( ERR_LL_DEV_NOTRDY );
+
+    /* new signal first, on error the timer stays unchanged */
+    if( vt->first && vt->sig &&
+        (error = OSS_SigCreate( m99Hdl->osHdl, vt->sig, &newSig )) )
+        return( error );
+
+    v = &m99Hdl->vt[vt->id];
+
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    oldSig       = v->sig;
+    v->sig       = newSig;
+    v->st.armed  = 0;
+
+    if( vt->first )
+    {
+        if( !m99Hdl->vtActive )
+        {
+            /* base period ends with the running hw period */
+            m99Hdl->vtBaseNext = m99Hdl->vtT + m99Hdl->vtRun;
+            m99Hdl->vtActive   = 1;
+        }/*if*/
+
+        v->deadline      = vtNow( m99Hdl ) + vt->first;
+        v->st.period     = vt->period;
+        v->st.expiries   = 0;
+        v->st.missed     = 0;
+        v->st.latMin     = 0xffffffff;
+        v->st.latMax     = 0;
+        v->st.latSum     = 0;
+        v->st.armed      = 1;
+    }/*if*/
+
+    vtUpdate( m99Hdl );
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+    /* isr can't use the old signal any more */
+    if( oldSig != NULL )
+        OSS_SigRemove( m99Hdl->osHdl, &oldSig );
+
+    return( 0 );
+}/*vtArm*/
+
+/******************************* sigInfo *************************************
+ *
+ *  Description:  Get the signal number of a signal handle
+ *
+ *                The setstats remove signal handles under cfgSem, so the
+ *                handle is only read while holding it.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *                sigP   signal handle in m99Hdl
+ *  Output.....:  *valueP signal number, 0=none
+ *                return  0 | error code
+ *  Globals....:  -
+ ****************************************************************************/
+static int32 sigInfo
+(
+    M99_HANDLE     *m99Hdl,
+    OSS_SIG_HANDLE **sigP,
+    int32          *valueP
+)
+{
+    int32 processId, error;
+
+    if( (error = OSS_SemWait( m99Hdl->osHdl, m99Hdl->cfgSem,
+                              OSS_SEM_WAITFOREVER )) )
+        return( error );
+
+    *valueP = 0;
+    if( *sigP != NULL )
+        OSS_SigInfo( m99Hdl->osHdl, *sigP, valueP, &processId );
+
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->cfgSem );
+    return( 0 );
+}/*sigInfo*/
+
+/***************************** capBufReset *********************************
+ *
+ *  Description:  Replace the read buffer by an empty one and restart the
+ *                SRAM read address.
+ *
+ *                MBUF has no code to clear a buffer, so a new one is
+ *                created with the read mode in use and the RD_BUF
+ *                descriptor setup. Other read buffer setstats (e.g. a
+ *                high water signal) must be made again.
+ *                Caller holds rdSem. Fails with ERR_LL_DEV_BUSY while a
+ *                read sleeps in the old buffer.
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  return 0 | error code
+ *  Globals....:  -
+ ****************************************************************************/
+static int32 capBufReset( M99_HANDLE *m99Hdl )
+{
+    MBUF_HANDLE   *oldBuf = m99Hdl->inbuf;
+    MBUF_HANDLE   *newBuf;
+    OSS_IRQ_STATE irqState;
+    int32         bufMode, error;
+
+    if( m99Hdl->rdWait )
+        return( ERR_LL_DEV_BUSY );
+
+    if( (error = MBUF_GetBufferMode( oldBuf, &bufMode )) ||
+        (error = MBUF_Create( m99Hdl->osHdl, m99Hdl->rdSem, m99Hdl,
+                              m99Hdl->rdBufSize, M99_CH_WIDTH, bufMode,
+                              MBUF_RD, m99Hdl->rdHighWater,
+                              m99Hdl->rdTimeout, m99Hdl->irqHdl,
+                              &newBuf )) )
+        return( error );
+    MBUF_SetStat( newBuf, NULL, M_BUF_RD_DEBUG_LEVEL, m99Hdl->rdDbgLevel );
+
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    m99Hdl->inbuf   = newBuf;
+    m99Hdl->rd_offs = 0;
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+    MBUF_Remove( &oldBuf );
+    return( 0 );
+}/*capBufReset*/
+
+static u_int32 getTime( M99_HANDLE *m99Hdl )
+{
+	u_int32 low1, low2, mid, high;
+	MACCESS ma = m99Hdl->maM68230;
+
+	do {
+		low1 = M99_RD( m99Hdl, M99_BUS_COUNTER, ma, CNTL_REG ) & 0xff;
+		mid  = M99_RD( m99Hdl, M99_BUS_COUNTER, ma, CNTM_REG ) & 0xff;
+		high = M99_RD( m99Hdl, M99_BUS_COUNTER, ma, CNTH_REG ) & 0xff;
+		low2 = M99_RD( m99Hdl, M99_BUS_COUNTER, ma, CNTL_REG ) & 0xff;
+		/*DBGWRT_3((DBH,"h=%02x m=%02x l1=%02x l2=%02x\n",
+		  high, mid, low1, low2 ));*/
+	} while( low2 > low1 );
+
+	return ((u_int32)(high<<16)) + ((u_int32)(mid<<8)) + low1;
+}
+
+/******************************* dostep *************************************
+ *
+ *  Description:  Jitter (step) + load new timer value
+ *
+ *                The preload sweeps between the jitter profile bounds
+ *                (default: half and double the medium preload).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void dostep
+(
+    M99_HANDLE*       m99Hdl
+)
+{
+    int32 end;
+    int32 lo = m99Hdl->jitMin ? m99Hdl->jitMin : m99Hdl->medPreLoad>>1;
+    int32 hi = m99Hdl->jitMax ? m99Hdl->jitMax : m99Hdl->medPreLoad<<1;
+
+    if( (int32)m99Hdl->timerval >= hi-1 )
+        end = lo;
+    else if( (int32)m99Hdl->timerval <= lo+1 )
+        end = hi;
+    else
+        end = m99Hdl->laststep > 0 ? hi : lo;
+
+    m99Hdl->laststep = (end - (int32)m99Hdl->timerval)/2;
+
+    IDBGWRT_2((DBH,"step=%08x time=%08x\n", m99Hdl->laststep, m99Hdl->timerval+m99Hdl->laststep) );
+
+    setTime( m99Hdl, m99Hdl->timerval+m99Hdl->laststep );
+}/*dostep*/
+
+/******************************* frecArm ************************************
+ *
+ *  Description:  Clear flight recorder ring and arm it (if threshold set)
+ *                Must be called with irqs masked (or from M99_Init).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void frecArm
+(
+    M99_HANDLE *m99Hdl
+)
+{
+    m99Hdl->frecIdx     = 0;
+    m99Hdl->frecFill    = 0;
+    m99Hdl->frecTrigIdx = 0;
+    m99Hdl->frecState   = m99Hdl->frecThresh ? M99_FREC_ARMED : M99_FREC_OFF;
+}/*frecArm*/
+
+/******************************* frecRecord *********************************
+ *
+ *  Description:  Store one irq in the flight recorder ring (called from
+ *                M99_Irq while the recorder runs).
+ *                The first irq with a latency above the threshold triggers
+ *                the recorder. After frecPost further records the ring is
+ *                frozen and the frec signal is sent. The frozen window
+ *                is read with M99_BLK_FREC.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *                tval   irq latency [ticks]
+ *                flags  M99_FREC_F_xxx
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void frecRecord
+(
+    M99_HANDLE *m99Hdl,
+    u_int32    tval,
+    u_int32    flags
+)
+{
+    M99_FREC_ENTRY *ent = &m99Hdl->frecRing[m99Hdl->frecIdx];
+
+    ent->seq     = m99Hdl->irqCount;
+    ent->latency = tval;
+    ent->preload = m99Hdl->timerval;
+    ent->flags   = flags;
+
+    if( m99Hdl->frecState == M99_FREC_ARMED && tval > m99Hdl->frecThresh )
+    {
+        ent->flags |= M99_FREC_F_TRIGGER;
+        m99Hdl->frecTrigIdx  = m99Hdl->frecIdx;
+        m99Hdl->frecPostLeft = m99Hdl->frecPost;
+        m99Hdl->frecState    = M99_FREC_TRIGGERED;
+    }
+    else if( m99Hdl->frecState == M99_FREC_TRIGGERED )
+    {
+        m99Hdl->frecPostLeft--;
+    }
+
+    m99Hdl->frecIdx = (m99Hdl->frecIdx + 1) & (M99_FREC_SIZE-1);
+    if( m99Hdl->frecFill < M99_FREC_SIZE )
+        m99Hdl->frecFill++;
+
+    if( m99Hdl->frecState == M99_FREC_TRIGGERED && m99Hdl->frecPostLeft == 0 )
+    {
+        m99Hdl->frecState = M99_FREC_FROZEN;
+        IDBGWRT_2((DBH, " flight recorder frozen, trigger seq=%d\n",
+                   m99Hdl->frecRing[m99Hdl->frecTrigIdx].seq) );
+
+        if( m99Hdl->frecSig != NULL )
+            OSS_SigSend( m99Hdl->osHdl, m99Hdl->frecSig );
+    }
+}/*frecRecord*/
+
+/******************************* isrtReset **********************************
+ *
+ *  Description:  Clear isr execution time results
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void isrtReset
+(
+    M99_HANDLE *m99Hdl
+)
+{
+    int i;
+
+    m99Hdl->isrt.count     = 0;
+    m99Hdl->isrt.hasCycles = M99_HAS_CYCLES;
+
+    isrtClr( &m99Hdl->isrt.ticks );
+    isrtClr( &m99Hdl->isrt.cycles );
+    for( i=0; i<M99_ISRT_NPHASES; i++ )
+        isrtClr( &m99Hdl->isrt.phase[i] );
+}/*isrtReset*/
+
+/******************************* isrtUpdate *********************************
+ *
+ *  Description:  Account one isr run
+ *
+ *                The phase durations are the differences of consecutive
+ *                cycle stamps, the total is exit minus entry. The 68230
+ *                duration starts at the latency read of the counter, so
+ *                it misses the status check but is independent of the
+ *                host cpu.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *                stamp  cycle stamps, entry and end of each phase
+ *                ticks  68230 counter difference
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void isrtUpdate
+(
+    M99_HANDLE    *m99Hdl,
+    const u_int32 *stamp,
+    u_int32       ticks
+)
+{
+    int i;
+
+    isrtAdd( &m99Hdl->isrt.ticks, ticks );
+    isrtAdd( &m99Hdl->isrt.cycles, stamp[M99_ISRT_NPHASES] - stamp[0] );
+    for( i=0; i<M99_ISRT_NPHASES; i++ )
+        isrtAdd( &m99Hdl->isrt.phase[i], stamp[i+1] - stamp[i] );
+
+    m99Hdl->isrt.count++;
+}/*isrtUpdate*/
+
+static void isrtClr( M99_ISRT_STAT *st )
+{
+    st->min = 0xffffffff;
+    st->max = 0;
+    st->sum = 0;
+}
+
+static void isrtAdd( M99_ISRT_STAT *st, u_int32 val )
+{
+    if( val < st->min )
+        st->min = val;
+    if( val > st->max )
+        st->max = val;
+    st->sum += val;
+}
+
+/******************************* stormWinReset *******************************
+ *
+ *  Description:  Start a new storm measuring window (irqs masked)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void stormWinReset
+(
+    M99_HANDLE *m99Hdl
+)
+{
+    m99Hdl->stormTicks     = 0;
+    m99Hdl->stormIrqs      = 0;
+    m99Hdl->stormBusy      = 0;
+    m99Hdl->stormAll       = 0;
+    m99Hdl->stormLastValid = 0;
+}/*stormWinReset*/
+
+/******************************* stormCheck **********************************
+ *
+ *  Description:  Irq storm protection, called at the end of M99_Irq
+ *
+ *                A window lasts M99_STORM_WIN ticks of expired timer
+ *                periods or M99_STORM_WIN_IRQS irqs, whatever comes first.
+ *                Periods the isr was too late for are not seen, so in a
+ *                storm the rate is rather overestimated. The isr cpu load
+ *                is the share of host cycles from isr entry to here in
+ *                the cycles from isr entry to isr entry.
+ *
+ *                A window above M99_STORM_RATE or M99_STORM_BUDGET
+ *                throttles the timer (see stormThrottle).
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl  ll drv handle
+ *                entry   cycle stamp of isr entry
+ *                period  expired timer period [ticks]
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void stormCheck
+(
+    M99_HANDLE *m99Hdl,
+    u_int32    entry,
+    u_int32    period
+)
+{
+    M99_STORM_STAT *st = &m99Hdl->storm;
+    u_int64        busy, all;
+    u_int32        now, avg;
+
+    M99_CYCLES( now );
+    if( m99Hdl->stormLastValid )
+    {
+        m99Hdl->stormAll  += entry - m99Hdl->stormLast;
+        m99Hdl->stormBusy += now - entry;
+    }/*if*/
+    m99Hdl->stormLast      = entry;
+    m99Hdl->stormLastValid = 1;
+
+    m99Hdl->stormTicks += period;
+    m99Hdl->stormIrqs++;
+    if( m99Hdl->stormTicks < M99_STORM_WIN &&
+        m99Hdl->stormIrqs < M99_STORM_WIN_IRQS )
+        return;
+
+    /*------------------+
+    | window complete   |
+    +------------------*/
+    /* stormIrqs <= M99_STORM_WIN_IRQS, no overflow */
+    st->rate = m99Hdl->stormIrqs * M99_CLOCK_FREQ / m99Hdl->stormTicks;
+    avg      = m99Hdl->stormTicks / m99Hdl->stormIrqs;
+
+    /* 32 bit division only, not all kernels have a 64 bit divide */
+    busy = m99Hdl->stormBusy;
+    all  = m99Hdl->stormAll;
+    while( all >> 22 )
+    {
+        all  >>= 1;
+        busy >>= 1;
+    }/*while*/
+    st->load = all ? (u_int32)busy * 1000 / (u_int32)all : 0;
+    if( st->load > 1000 )
+        st->load = 1000;
+
+    if( st->rate > st->peakRate )
+        st->peakRate = st->rate;
+    if( st->load > st->peakLoad )
+        st->peakLoad = st->load;
+
+    stormWinReset( m99Hdl );
+
+    if( (st->maxRate && st->rate > st->maxRate) ||
+        (st->budget  && st->load > st->budget) )
+        stormThrottle( m99Hdl, avg );
+}/*stormCheck*/
+
+/******************************* stormThrottle *******************************
+ *
+ *  Description:  Throttle the timer after a storm window (from M99_Irq)
+ *
+ *                M99_STORM_RAISE  the preload floor is set to twice the
+ *                                 average period of the window, at least
+ *                                 the period of M99_STORM_RATE. setTime
+ *                                 applies it, the new preload is active
+ *                                 from the next reload. Windows still
+ *                                 too busy raise it further.
+ *                                 The floor stays until M99_STORM_EVENTS
+ *                                 is reset.
+ *                M99_STORM_STOP   the timer is halted, the alarm
+ *                                 restarts it after M99_STORM_PAUSE ms.
+ *                                 Virtual timers are disarmed.
+ *
+ *                The event is counted and the storm signal is sent.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl     ll drv handle
+ *                avgPeriod  average period of the window [ticks]
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void stormThrottle
+(
+    M99_HANDLE *m99Hdl,
+    u_int32    avgPeriod
+)
+{
+    M99_STORM_STAT *st = &m99Hdl->storm;
+    u_int32        floor, realMsec;
+
+    st->events++;
+
+    if( st->mode == M99_STORM_STOP && m99Hdl->stormAlm != NULL )
+    {
+        vtStop( m99Hdl );       /* halt breaks the wheel time */
+        tcWrite( m99Hdl, m99Hdl->shTc & 0xfe );
+        st->paused = 1;
+        OSS_AlarmSet( m99Hdl->osHdl, m99Hdl->stormAlm, m99Hdl->stormPause,
+                      0, &realMsec );
+    }
+    else
+    {
+        floor = avgPeriod < 0x800000 ? 2 * avgPeriod : 0xffffff;
+        if( st->maxRate && floor < M99_CLOCK_FREQ / st->maxRate + 1 )
+            floor = M99_CLOCK_FREQ / st->maxRate + 1;
+        if( floor < 2 * st->floor )
+            floor = 2 * st->floor < 0xffffff ? 2 * st->floor : 0xffffff;
+        st->floor = floor;
+        setTime( m99Hdl, m99Hdl->timerval );
+    }/*if*/
+
+    IDBGWRT_1((DBH, " irq storm: rate=%d load=%d floor=%d paused=%d\n",
+               st->rate, st->load, st->floor, st->paused) );
+
+    if( m99Hdl->stormSig != NULL )
+        OSS_SigSend( m99Hdl->osHdl, m99Hdl->stormSig );
+}/*stormThrottle*/
+
+/******************************* stormResume *********************************
+ *
+ *  Description:  Restart the timer halted by stormThrottle (alarm handler,
+ *                M99_STORM_EVENTS reset)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  arg    ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void stormResume
+(
+    void *arg
+)
+{
+    M99_HANDLE    *m99Hdl = (M99_HANDLE*)arg;
+    OSS_IRQ_STATE irqState;
+
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    if( m99Hdl->storm.paused )
+    {
+        m99Hdl->storm.paused = 0;
+        stormWinReset( m99Hdl );
+        tcWrite( m99Hdl, m99Hdl->shTc | 0x01 );
+    }/*if*/
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+}/*stormResume*/
+
+/******************************* capRecord **********************************
+ *
+ *  Description:  Sample port B into the read buffer (from M99_Irq)
+ *
+ *                One M99_CAP_REC per base period irq, in M99_CAP_CHANGE
+ *                mode only if port B differs from the previous sample.
+ *                The sample time is the wheel time of the expiry plus
+ *                the irq latency, so it counts timer ticks since init
+ *                (periods the isr missed completely are not counted).
+ *
+ *                The read buffer size is a multiple of the record size,
+ *                a record never wraps. If the buffer has no room for a
+ *                whole record it is lost (readers consuming partial
+ *                records), the next record carries the lost count.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *                tval   irq latency [ticks]
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void capRecord
+(
+    M99_HANDLE *m99Hdl,
+    u_int32    tval
+)
+{
+    M99_CAP_REC *rec;
+    int32       gotsize;
+    u_int8      val;
+
+    val = (u_int8)M99_RD( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PBD_REG );
+
+    if( m99Hdl->capMode == M99_CAP_CHANGE && m99Hdl->capPrev == val )
+        return;
+
+    rec = (M99_CAP_REC*)MBUF_GetNextBuf( m99Hdl->inbuf, sizeof(M99_CAP_REC),
+                                         &gotsize );
+    if( rec == NULL || gotsize < (int32)sizeof(M99_CAP_REC) )
+    {
+        /* keep capPrev, the change is reported with the next record */
+        m99Hdl->capLost++;
+        m99Hdl->capLostRec++;
+        return;
+    }/*if*/
+
+    rec->seq     = m99Hdl->irqCount;
+    rec->time    = (u_int32)(m99Hdl->vtT + tval);
+    rec->latency = tval;
+    rec->value   = val;
+    rec->changed = m99Hdl->capPrev > 0xff ? 0 : (u_int8)(val ^ m99Hdl->capPrev);
+    rec->lost    = m99Hdl->capLostRec < 0xffff ?
+                   (u_int16)m99Hdl->capLostRec : 0xffff;
+    MBUF_ReadyBuf( m99Hdl->inbuf );
+
+    m99Hdl->capPrev    = val;
+    m99Hdl->capLostRec = 0;
+}/*capRecord*/
+
+/******************************* patStep ************************************
+ *
+ *  Description:  Output the next pattern step to port A (from M99_Irq)
+ *
+ *                Steps are the bytes of the SRAM words of the active
+ *                bank, low byte first, one SRAM read per two steps.
+ *                At the end of the bank a loaded next bank is taken over
+ *                (glitchless, between two steps). Else M99_PAT_LOOP
+ *                restarts the bank and M99_PAT_ONESHOT stops with an
+ *                underrun, port A keeps the last step until a bank is
+ *                loaded.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl ll drv handle
+ *  Output.....:  -
+ *  Globals....:  -
+ ****************************************************************************/
+static void patStep
+(
+    M99_HANDLE *m99Hdl
+)
+{
+    M99_PATSTAT *pat = &m99Hdl->pat;
+    u_int32     idx  = pat->idx;
+
+    if( pat->active == M99_PAT_NONE || idx >= pat->len[pat->active] )
+    {
+        if( pat->pending != M99_PAT_NONE )
+        {
+            if( pat->active != M99_PAT_NONE )
+                pat->swaps++;
+            pat->active  = pat->pending;
+            pat->pending = M99_PAT_NONE;
+        }
+        else if( pat->mode == M99_PAT_LOOP && pat->active != M99_PAT_NONE )
+        {
+            pat->loops++;
+        }
+        else
+        {
+            /* count the end once, not every idle irq */
+            if( pat->active != M99_PAT_NONE )
+                pat->underruns++;
+            pat->active = M99_PAT_NONE;
+            pat->idx    = 0;
+            return;
+        }/*if*/
+        idx = 0;
+    }/*if*/
+
+    if( !(idx & 1) )
+        m99Hdl->patWord = (u_int16)M99_RD( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM,
+                                           M99_PAT_BANK(m99Hdl, pat->active) + idx );
+
+    M99_WR( m99Hdl, M99_BUS_PORT, m99Hdl->maM68230, PAD_REG,
+            (u_int8)(idx & 1 ? m99Hdl->patWord >> 8 : m99Hdl->patWord) );
+
+    pat->idx = idx + 1;
+    pat->steps++;
+}/*patStep*/
+
+/******************************* patLoad ************************************
+ *
+ *  Description:  Load the next playback bank (M99_BLK_PATTERN)
+ *
+ *                The bank not playing is written, a next bank not yet
+ *                taken over by the isr is replaced. It is released to
+ *                the isr only when complete, so the isr never plays a
+ *                half written bank.
+ *                With playback off, no buffered write may run meanwhile
+ *                (the SRAM write area is bank 1).
+ *                A bank has M99_SRAM_RW_BUF_SIZE bytes, so a pattern
+ *                can't be longer. Banks must start on a word, an odd
+ *                M99_SRAM_RW_BUF_SIZE allows no pattern.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl  ll drv handle
+ *                pat     steps
+ *  Output.....:  return  0 | error code
+ *  Globals....:  -
+ ****************************************************************************/
+static int32 patLoad
+(
+    M99_HANDLE        *m99Hdl,
+    const M99_PATTERN *pat
+)
+{
+    OSS_IRQ_STATE irqState;
+    u_int32       bank, i;
+    u_int16       word;
+    int32         error;
+
+    if( pat->len < 1 || M99_PAT_BANK_SIZE < pat->len ||
+        m99Hdl->RWbufSize < pat->len || (m99Hdl->RWbufSize & 1) )
+        return( ERR_LL_ILL_PARAM );
+
+    if( (error = OSS_SemWait( m99Hdl->osHdl, m99Hdl->wrSem,
+                              OSS_SEM_WAITFOREVER )) )
+        return( error );
+
+    /* withdraw the next bank, the active one can't change to it now */
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    bank = m99Hdl->pat.active == M99_PAT_NONE ? 0 : 1 - m99Hdl->pat.active;
+    m99Hdl->pat.pending = M99_PAT_NONE;
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+    for( i=0; i<pat->len; i+=2 )
+    {
+        word = pat->step[i];
+        if( i+1 < pat->len )
+            word |= (u_int16)pat->step[i+1] << 8;
+        M99_WR( m99Hdl, M99_BUS_SRAM, m99Hdl->maSRAM, M99_PAT_BANK(m99Hdl, bank) + i,
+                word );
+    }/*for*/
+
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    m99Hdl->pat.len[bank] = pat->len;
+    m99Hdl->pat.pending   = bank;
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+    OSS_SemSignal( m99Hdl->osHdl, m99Hdl->wrSem );
+    return( 0 );
+}/*patLoad*/
+
+/****************************** applyConfig *********************************
+ *
+ *  Description:  Apply a complete run configuration (M99_BLK_CONFIG)
+ *
+ *                All values are checked and the signals are created
+ *                first. Then the timer is halted, the selected parts of
+ *                cfg are applied and the timer is restarted once, so no
+ *                irq occurs in a half configured state:
+ *
+ *                M99_CFG_SIGNALS  create the signal of each condition
+ *                                 with sig[] != 0 for the caller. Such
+ *                                 a condition must be free (as with
+ *                                 M99_SIG_set_condN), else nothing is
+ *                                 applied. Conditions with sig[] == 0
+ *                                 are left alone.
+ *                M99_CFG_TIMER    medium preload, restarts the jitter
+ *                M99_CFG_JITTER   jitter mode and profile bounds
+ *                M99_CFG_RESET    irq counter, latencies, histogram,
+ *                                 interval stats, signal counters
+ *                M99_CFG_IRQ      timer irq enable of the module. The
+ *                                 MDIS kernel enables the irq line only
+ *                                 with M_MK_IRQ_ENABLE, so callers still
+ *                                 enable irqs with that setstat (it also
+ *                                 sets the module irq).
+ *
+ *                The MDIS kernel irq counter (M_MK_IRQ_COUNT) is not
+ *                accessible for the low level driver.
+ *                On an error nothing is applied, the timer and virtual
+ *                timers keep running.
+ *                A timer halted by the storm protection (M99_STORM_STOP)
+ *                stays halted until the storm alarm restarts it.
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  m99Hdl  ll drv handle
+ *                cfg     configuration
+ *  Output.....:  return  0 | error code
+ *  Globals....:  -
+ ****************************************************************************/
+static int32 applyConfig
+(
+    M99_HANDLE       *m99Hdl,
+    const M99_CONFIG *cfg
+)
+{
+    OSS_IRQ_STATE  irqState;
+    OSS_SIG_HANDLE *sig[M99_MAX_SIGNALS];
+    u_int8         tc_reg;
+    int32          error = 0;
+    int            i;
+
+    /*------------------+
+    | check             |
+    +------------------*/
+    if( (cfg->flags & M99_CFG_TIMER) &&
+        (cfg->timerval < 1 || 0xffffff < cfg->timerval) )
+        return( ERR_LL_ILL_PARAM );
+
+    if( cfg->flags & M99_CFG_JITTER )
+    {
+        if( cfg->jitter > 1 || 0xffffff < cfg->jitterMax )
+            return( ERR_LL_ILL_PARAM );
+        if( cfg->jitterMin && cfg->jitterMax &&
+            cfg->jitterMin >= cfg->jitterMax )
+            return( ERR_LL_ILL_PARAM );
+    }/*if*/
+
+    /*------------------+
+    | signals           |
+    +------------------*/
+    for( i=0; i<M99_MAX_SIGNALS; i++ )
+        sig[i] = NULL;
+
+    if( cfg->flags & M99_CFG_SIGNALS )
+    {
+        /* cond[] changes only by setstats, stable under cfgSem */
+        for( i=0; i<M99_MAX_SIGNALS; i++ )
+            if( cfg->sig[i] && m99Hdl->cond[i] != NULL )
+                return( ERR_OSS_SIG_SET );
+
+        for( i=0; i<M99_MAX_SIGNALS && !error; i++ )
+            if( cfg->sig[i] )
+                error = OSS_SigCreate( m99Hdl->osHdl, cfg->sig[i], &sig[i] );
+
+        if( error )
+        {
+            for( i=0; i<M99_MAX_SIGNALS; i++ )
+                if( sig[i] != NULL )
+                    OSS_SigRemove( m99Hdl->osHdl, &sig[i] );
+            return( error );
+        }/*if*/
+    }/*if*/
+
+    /*------------------+
+    | halt timer        |
+    +------------------*/
+    /* waits for an isr still running on another cpu, the isr and the
+       storm alarm change TC_REG too */
+    irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+    tc_reg = m99Hdl->shTc;
+    tcWrite( m99Hdl, tc_reg & 0xfe );
+    M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG, 0xff ); /* clear pending */
+    vtStop( m99Hdl );                   /* restart breaks the wheel time */
+
+    /*------------------+
+    | timer, counters   |
+    +------------------*/
+
+    for( i=0; i<M99_MAX_SIGNALS; i++ )
+    {
+        if( sig[i] != NULL )
+        {
+            m99Hdl->cond[i]    = sig[i];
+            m99Hdl->sigSent[i] = 0;
+        }/*if*/
+    }/*for*/
+
+    if( cfg->flags & M99_CFG_TIMER )
+    {
+        m99Hdl->medPreLoad = cfg->timerval;
+        m99Hdl->jitMin     = 0;
+        m99Hdl->jitMax     = 0;
+    }/*if*/
+
+    if( cfg->flags & M99_CFG_JITTER )
+    {
+        m99Hdl->jittermode = cfg->jitter;
+        m99Hdl->jitMin     = cfg->jitterMin;
+        m99Hdl->jitMax     = cfg->jitterMax;
+    }/*if*/
+
+    if( cfg->flags & (M99_CFG_TIMER | M99_CFG_JITTER) )
+    {
+        m99Hdl->laststep = -1;
+        setTime( m99Hdl, m99Hdl->medPreLoad );
+    }/*if*/
+
+    if( cfg->flags & M99_CFG_RESET )
+    {
+        m99Hdl->irqCount      = 0;
+        m99Hdl->irqLatency    = 0;
+        m99Hdl->maxIrqLatency = 0;
+        m99Hdl->sigSeq        = 0;
+        for( i=0; i<M99_MAX_SIGNALS; i++ )
+        {
+            m99Hdl->sigSent[i]    = 0;
+            m99Hdl->sigLastSeq[i] = 0;
+        }/*for*/
+        for( i=0; i<M99_HIST_SIZE; i++ )
+            m99Hdl->latHist[i] = 0;
+        m99Hdl->ivStat.count    = 0;
+        m99Hdl->ivStat.sum      = 0;
+        m99Hdl->ivStat.min      = 0xffffffff;
+        m99Hdl->ivStat.max      = 0;
+        m99Hdl->ivStat.overruns = 0;
+    }/*if*/
+
+    if( cfg->flags & M99_CFG_IRQ )
+    {
+        m99Hdl->irqEnabled = cfg->irqEnable ? 1 : 0;
+        tc_reg = cfg->irqEnable ? 0xa1 : 0x81;
+    }/*if*/
+    if( m99Hdl->storm.paused )
+        tc_reg &= 0xfe;                 /* stormResume restarts it */
+
+    /*------------------+
+    | restart timer     |
+    +------------------*/
+    M99_WR( m99Hdl, M99_BUS_TCTL, m99Hdl->maM68230, TS_REG, 0x01 ); /* timer reset */
+    m99Hdl->vtRun = m99Hdl->timerval;
+    tcWrite( m99Hdl, tc_reg );
+
+    OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+    return( 0 );
+}/*applyConfig*/
+
+/**************************** setStatBlock ***********************************
+ *
+ *  Description:  decodes the M_SETGETSTAT_BLOCK struct code and executes them.
+ *                The known codes are:
+ *
+ *                   M99_SETGETSRAM   size bytes of the data buffer will copied
+ *                                    to the sram. It starts from begin of
+ *                                    sram. ( size max 128 )
+ *
+ *                   M99_BLK_CONFIG   apply M99_CONFIG (see applyConfig)
+ *
+ *                   M99_BLK_VTIMER   arm/disarm a virtual timer (see vtArm)
+ *
+ *                   M99_BLK_PATTERN  load the next playback bank (see
+ *                                    patLoad)
+ *
+ *---------------------------------------------------------------------------
+ *  Input......:  blockStruct    the struct with code size and data buffer
+ *
+ *  Output.....:  0 | error code
+ *
+ *  Globals....:  ---
+ *
+ ****************************************************************************/
+static int32 setStatBlock
+(
+    M99_HANDLE         *m99Hdl,
+    int32              code,
+    M_SETGETSTAT_BLOCK *blockStruct
+)
+{
+   int32 error;
+
+   switch( code )
    {
        case M99_SETGET_BLOCK_SRAM:
           if( blockStruct->size > 128 )
               error = ERR_LL_ILL_PARAM;
+          else if( m99Hdl->pat.mode != M99_PAT_OFF )
+              error = ERR_LL_DEV_BUSY;     /* SRAM holds the pattern */
           else
           {
               /* copy data buffer to sram */
@@ -1537,6 +3532,29 @@ static int32 setStatBlock
           }/*if*/
           break;
 
+       case M99_BLK_CONFIG:
+          if( blockStruct->size < (int32)sizeof(M99_CONFIG) )
+              error = ERR_LL_ILL_PARAM;
+          else
+              error = applyConfig( m99Hdl, (M99_CONFIG*)blockStruct->data );
+          break;
+
+       case M99_BLK_VTIMER:
+          if( blockStruct->size < (int32)sizeof(M99_VTIMER) )
+              error = ERR_LL_ILL_PARAM;
+          else
+              error = vtArm( m99Hdl, (M99_VTIMER*)blockStruct->data );
+          break;
+
+       case M99_BLK_PATTERN:
+          if( blockStruct->size < (int32)sizeof(u_int32) ||
+              blockStruct->size < (int32)(sizeof(u_int32) +
+                                  ((M99_PATTERN*)blockStruct->data)->len) )
+              error = ERR_LL_ILL_PARAM;
+          else
+              error = patLoad( m99Hdl, (M99_PATTERN*)blockStruct->data );
+          break;
+
        default:
           error = ERR_LL_UNK_CODE;
    }/*switch*/
@@ -1553,6 +3571,33 @@ static int32 setStatBlock
  *                                    data buffer. It starts from begin of
  *                                    sram.
  *
+ *                   M99_BLK_SIGSTAT  signal send counters as M99_SIGSTAT
+ *
+ *                   M99_BLK_ISRTIME  isr execution time as M99_ISRTIME
+ *
+ *                   M99_BLK_STATS    live counters and irq latency
+ *                                    histogram as M99_STATS
+ *
+ *                   M99_BLK_IVSTAT   interval stats as M99_IVSTAT, read
+ *                                    and reset atomically
+ *
+ *                   M99_BLK_CONFIG   current configuration as M99_CONFIG
+ *
+ *                   M99_BLK_BUSSTAT  M-Module bus accesses as M99_BUSSTAT
+ *
+ *                   M99_BLK_VTSTAT   virtual timer state and latencies
+ *                                    as M99_VTSTAT
+ *
+ *                   M99_BLK_STORM    irq storm protection as
+ *                                    M99_STORM_STAT
+ *
+ *                   M99_BLK_PATSTAT  pattern playback as M99_PATSTAT
+ *
+ *                   M99_BLK_FREC     flight recorder ring as M99_FREC_WINDOW,
+ *                                    oldest record first. Complete window
+ *                                    when state is M99_FREC_FROZEN, else
+ *                                    a snapshot of the running ring.
+ *
  *---------------------------------------------------------------------------
  *  Input......:  blockStruct    the struct with code size and data buffer
  *
@@ -1590,6 +3635,246 @@ static int32 getStatBlock
           }/*if*/
           break;
 
+       case M99_BLK_SIGSTAT:
+       {
+          M99_SIGSTAT   *st = (M99_SIGSTAT*)blockStruct->data;
+          OSS_IRQ_STATE irqState;
+          int           i;
+
+          if( blockStruct->size < (int32)sizeof(M99_SIGSTAT) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          st->irqCount = m99Hdl->irqCount;
+          st->sigSeq   = m99Hdl->sigSeq;
+          for( i=0; i<M99_MAX_SIGNALS; i++ )
+          {
+              st->sent[i]    = m99Hdl->sigSent[i];
+              st->lastSeq[i] = m99Hdl->sigLastSeq[i];
+          }/*for*/
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_SIGSTAT);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_ISRTIME:
+       {
+          OSS_IRQ_STATE irqState;
+
+          if( blockStruct->size < (int32)sizeof(M99_ISRTIME) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          *(M99_ISRTIME*)blockStruct->data = m99Hdl->isrt;
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_ISRTIME);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_CONFIG:
+       {
+          M99_CONFIG *cfg = (M99_CONFIG*)blockStruct->data;
+          int        i;
+
+          if( blockStruct->size < (int32)sizeof(M99_CONFIG) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          cfg->flags     = M99_CFG_ALL;
+          cfg->timerval  = m99Hdl->medPreLoad;
+          cfg->jitter    = m99Hdl->jittermode;
+          cfg->jitterMin = m99Hdl->jitMin;
+          cfg->jitterMax = m99Hdl->jitMax;
+          cfg->irqEnable = m99Hdl->irqEnabled;
+          for( i=0; i<M99_MAX_SIGNALS; i++ )
+              if( (error = sigInfo( m99Hdl, &m99Hdl->cond[i],
+                                    (int32*)&cfg->sig[i] )) )
+                  break;
+          if( error )
+              break;
+
+          blockStruct->size = sizeof(M99_CONFIG);
+          break;
+       }
+
+       case M99_BLK_PATSTAT:
+       {
+          OSS_IRQ_STATE irqState;
+
+          if( blockStruct->size < (int32)sizeof(M99_PATSTAT) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          *(M99_PATSTAT*)blockStruct->data = m99Hdl->pat;
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_PATSTAT);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_STORM:
+       {
+          OSS_IRQ_STATE irqState;
+
+          if( blockStruct->size < (int32)sizeof(M99_STORM_STAT) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          *(M99_STORM_STAT*)blockStruct->data = m99Hdl->storm;
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_STORM_STAT);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_VTSTAT:
+       {
+          OSS_IRQ_STATE irqState;
+          M99_VTSTAT    *vs = (M99_VTSTAT*)blockStruct->data;
+          int           i;
+
+          if( blockStruct->size < (int32)sizeof(M99_VTSTAT) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          vs->active   = m99Hdl->vtActive;
+          vs->hwIrqs   = m99Hdl->vtHwIrqs;
+          vs->baseIrqs = m99Hdl->vtBaseIrqs;
+          for( i=0; i<M99_VT_NUM; i++ )
+              vs->vt[i] = m99Hdl->vt[i].st;
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_VTSTAT);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_BUSSTAT:
+       {
+          OSS_IRQ_STATE irqState;
+
+          if( blockStruct->size < (int32)sizeof(M99_BUSSTAT) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          *(M99_BUSSTAT*)blockStruct->data = m99Hdl->bus;
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_BUSSTAT);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_IVSTAT:
+       {
+          OSS_IRQ_STATE irqState;
+
+          if( blockStruct->size < (int32)sizeof(M99_IVSTAT) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          *(M99_IVSTAT*)blockStruct->data = m99Hdl->ivStat;
+          m99Hdl->ivStat.count    = 0;
+          m99Hdl->ivStat.sum      = 0;
+          m99Hdl->ivStat.min      = 0xffffffff;
+          m99Hdl->ivStat.max      = 0;
+          m99Hdl->ivStat.overruns = 0;
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_IVSTAT);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_STATS:
+       {
+          M99_STATS     *st = (M99_STATS*)blockStruct->data;
+          OSS_IRQ_STATE irqState;
+          int           i;
+
+          if( blockStruct->size < (int32)sizeof(M99_STATS) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          st->irqCount      = m99Hdl->irqCount;
+          st->irqLatency    = m99Hdl->irqLatency;
+          st->maxIrqLatency = m99Hdl->maxIrqLatency;
+          st->timerval      = m99Hdl->timerval;
+          for( i=0; i<M99_HIST_SIZE; i++ )
+              st->hist[i] = m99Hdl->latHist[i];
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_STATS);
+          error = 0;
+          break;
+       }
+
+       case M99_BLK_FREC:
+       {
+          M99_FREC_WINDOW *win = (M99_FREC_WINDOW*)blockStruct->data;
+          OSS_IRQ_STATE   irqState;
+          u_int32         i, idx, oldest;
+
+          if( blockStruct->size < (int32)sizeof(M99_FREC_WINDOW) )
+          {
+              error = ERR_LL_ILL_PARAM;
+              break;
+          }
+
+          irqState = OSS_IrqMaskR( m99Hdl->osHdl, m99Hdl->irqHdl );
+          win->state   = m99Hdl->frecState;
+          win->thresh  = m99Hdl->frecThresh;
+          win->count   = m99Hdl->frecFill;
+          win->trigIdx = 0xffffffff;
+
+          oldest = (m99Hdl->frecIdx - m99Hdl->frecFill) & (M99_FREC_SIZE-1);
+          for( i=0; i < m99Hdl->frecFill; i++ )
+          {
+              idx = (oldest + i) & (M99_FREC_SIZE-1);
+              win->ent[i] = m99Hdl->frecRing[idx];
+              if( m99Hdl->frecState >= M99_FREC_TRIGGERED &&
+                  idx == m99Hdl->frecTrigIdx )
+                  win->trigIdx = i;
+          }/*for*/
+          OSS_IrqRestore( m99Hdl->osHdl, m99Hdl->irqHdl, irqState );
+
+          blockStruct->size = sizeof(M99_FREC_WINDOW);
+          error = 0;
+          break;
+       }
+
        default:
           error = ERR_LL_UNK_CODE;
    }/*switch*/
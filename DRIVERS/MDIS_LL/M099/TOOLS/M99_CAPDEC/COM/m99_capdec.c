@@ -0,0 +1,211 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_capdec.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Decodes m99_latency capture files (-c option) to CSV
+ *               and summary statistics
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/usr_utl.h>
+#define M99CAP_READER
+#include <MEN/m99_cap.h>
+
+#define HIST_SIZE	16384	/* ticks, larger values go to last bucket */
+
+typedef struct {
+	u_int32 min;
+	u_int32 max;
+	u_int32 maxSeq;			/* sequence number of max */
+	u_int64 maxTs;			/* timestamp of max [us] */
+	double  sum;
+	u_int32 hist[HIST_SIZE];
+} SUMMARY;
+
+static SUMMARY G_irq, G_sig;
+static const char IdentString[]=MENT_XSTR(MAK_REVISION);
+
+/**********************************************************************/
+/** print usage
+ */
+static void usage(void)
+{
+	printf("Usage: m99_capdec [<opts>] <file> [<opts>]\n");
+	printf("Function: Decodes m99_latency capture file\n");
+	printf("Options:\n");
+	printf("    -c         print samples as CSV                 \n");
+	printf("    -s         print summary statistics        [default]\n");
+	printf("    file       capture file (m99_latency -c=<file>) [none]\n");
+	printf("\n");
+	printf("Copyright 2019, MEN Mikro Elektronik GmbH\n");
+	printf("%s\n", IdentString );
+}
+
+static void InitSummary( SUMMARY *su )
+{
+	memset( su, 0, sizeof(*su) );
+	su->min = 0xffffffff;
+}
+
+static void UpdateSummary( SUMMARY *su, u_int32 val, const M99CAP_SAMPLE *s )
+{
+	if( val < su->min )
+		su->min = val;
+	if( val >= su->max ){
+		su->max    = val;
+		su->maxSeq = s->seq;
+		su->maxTs  = s->tsUs;
+	}
+	su->sum += val;
+	su->hist[val < HIST_SIZE ? val : HIST_SIZE-1]++;
+}
+
+/* value [ticks] below which the fraction q of all samples lies */
+static u_int32 Percentile( const SUMMARY *su, u_int32 count, double q )
+{
+	double need = q * count;
+	double acc = 0;
+	u_int32 i;
+
+	for( i=0; i<HIST_SIZE-1; i++ ){
+		acc += su->hist[i];
+		if( acc >= need )
+			return i;
+	}
+	return su->max;
+}
+
+static void PrintSummary( const char *name, const SUMMARY *su, u_int32 count,
+						  u_int32 tickUs )
+{
+	if( !count )
+		return;
+
+	printf("%s latency [us]\n", name );
+	printf("  min/avg/max      %u / %.1f / %u\n",
+		   (unsigned)(su->min * tickUs), su->sum * tickUs / count,
+		   (unsigned)(su->max * tickUs) );
+	printf("  p50/p99/p99.9/p99.99  %u / %u / %u / %u\n",
+		   (unsigned)(Percentile( su, count, 0.50 ) * tickUs),
+		   (unsigned)(Percentile( su, count, 0.99 ) * tickUs),
+		   (unsigned)(Percentile( su, count, 0.999 ) * tickUs),
+		   (unsigned)(Percentile( su, count, 0.9999 ) * tickUs) );
+	printf("  max at seq %u, t=%.6f s\n",
+		   (unsigned)su->maxSeq, su->maxTs / 1e6 );
+}
+
+/**********************************************************************/
+/** where all begins...
+ */
+int main( int argc, char **argv )
+{
+	M99CAP_RD rd;
+	M99CAP_SAMPLE s;
+	char *file=NULL, *errstr, buf[40];
+	int n, csv, summary, rv;
+	u_int32 count=0, tickUs, prevSeq=0;
+	u_int64 missed=0, lastTs=0;
+
+	if ((errstr = UTL_ILLIOPT("cs?", buf))) {	/* check args */
+		printf("*** %s\n", errstr);
+		return(1);
+	}
+
+	if (UTL_TSTOPT("?")) {						/* help requested ? */
+		usage();
+		return(1);
+	}
+
+	for (n=1; n<argc; n++)   		/* search for file */
+		if (*argv[n] != '-') {
+			file = argv[n];
+			break;
+		}
+
+	if (!file) {
+		usage();
+		return(1);
+	}
+
+	csv		= !!UTL_TSTOPT("c");
+	summary = !!UTL_TSTOPT("s") || !csv;
+
+	if( M99CAP_Open( &rd, file ) ){
+		printf("*** can't open %s or not a capture file\n", file );
+		return(1);
+	}
+	tickUs = rd.hdr.tickNs / 1000;
+
+	InitSummary( &G_irq );
+	InitSummary( &G_sig );
+
+	if( csv )
+		printf("seq,irq_us,sig_us,time_us\n");
+
+	while( (rv = M99CAP_Next( &rd, &s )) == 1 ){
+		if( csv )
+			printf("%u,%u,%u,%llu\n", (unsigned)s.seq,
+				   (unsigned)(s.irqLat * tickUs),
+				   (unsigned)(s.sigLat * tickUs),
+				   (unsigned long long)s.tsUs );
+
+		/* the sequence counts irqs, every gap is an unseen irq */
+		if( count && s.seq - prevSeq > 1 )
+			missed += s.seq - prevSeq - 1;
+		prevSeq = s.seq;
+		lastTs  = s.tsUs;
+
+		UpdateSummary( &G_irq, s.irqLat, &s );
+		UpdateSummary( &G_sig, s.sigLat, &s );
+		count++;
+	}
+
+	if( rv < 0 )
+		printf("*** %s: corrupt data after %u samples\n", file,
+			   (unsigned)count );
+
+	if( summary ){
+		printf("file %s: timerval=%u interval=%us start=%u\n", file,
+			   (unsigned)rd.hdr.timerval, (unsigned)rd.hdr.interval,
+			   (unsigned)rd.hdr.startTime );
+		printf("samples %u, duration %.3f s, irqs without sample %llu",
+			   (unsigned)count, lastTs / 1e6, (unsigned long long)missed );
+		if( rd.ended )
+			printf(", dropped by writer %u", (unsigned)rd.dropped );
+		else
+			printf(", no end record (capture not stopped cleanly)");
+		printf("\n");
+
+		PrintSummary( "IRQ", &G_irq, count, tickUs );
+		PrintSummary( "SIG", &G_sig, count, tickUs );
+	}
+
+	M99CAP_Close( &rd );
+	return rv < 0 ? 1 : 0;
+}
@@ -0,0 +1,478 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_cexec.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Cyclic executive driven by the M99 timer interrupt
+ *
+ *               The executive waits for the next M99 tick, derives the
+ *               number of the minor frame from the driver counters and
+ *               runs the tasks of that frame. Ticks passed while a frame
+ *               was still running are frame overruns, handled by the
+ *               configured policy (see m99_cexec.h).
+ *
+ *               Times are taken with the host monotonic clock. A frame is
+ *               released when its tick was seen, so deadlines include the
+ *               wakeup latency of the tick source.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef LINUX
+# include <time.h>
+# include <signal.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_oss.h>
+#include <MEN/m99_drv.h>
+#include "m99_cexec.h"
+
+#define TIME_PER_TICK	4		/* 68230 timer runs at 250kHz */
+
+struct CEXEC {
+	MDIS_PATH   path;
+	CEXEC_CFG   cfg;
+	int         nTasks;
+	CEXEC_TASK  task[CEXEC_MAX_TASKS];
+	CEXEC_TSTAT tstat[CEXEC_MAX_TASKS];
+	u_int8      slot[CEXEC_MAX_MINOR][CEXEC_MAX_SLOTS];	/* task indices */
+	u_int8      nSlots[CEXEC_MAX_MINOR];
+	CEXEC_FSTAT fstat;
+	u_int32     tick;		/* last tick seen */
+	int         irqOn;		/* irq enabled by CEXEC_Create */
+	int         condSet;	/* signal conditions installed */
+};
+
+/* signals seen, one executive per process */
+static volatile u_int32 G_sigCount;
+
+static u_int64 HostTimeUs( void )
+{
+#ifdef LINUX
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	return (u_int64)UOS_MsecTimerGet() * 1000;
+#endif
+}
+
+static void __MAPILIB SigHandler( u_int32 sigCode )
+{
+	(void)sigCode;
+	G_sigCount++;
+}
+
+/**********************************************************************/
+/** create executive and start the tick source
+ *
+ *  The irq is enabled first for all sources (the wheel needs it).
+ *  SIGNAL and POLL then restart the M99 timer with the minor frame as
+ *  period (M99_BLK_CONFIG), SIGNAL installs its signal for the 4
+ *  conditions. VTIMER arms a periodic virtual timer and keeps the base
+ *  timer.
+ *
+ *  \param path		open M99 path
+ *  \param cfg		configuration (copied)
+ *
+ *  \return executive | NULL on error
+ */
+CEXEC *CEXEC_Create( MDIS_PATH path, const CEXEC_CFG *cfg )
+{
+	CEXEC *cx;
+	M_SG_BLOCK blk;
+	u_int32 ticks = cfg->minorUs / TIME_PER_TICK;
+	int i, rv;
+
+	if( cfg->minors < 1 || cfg->minors > CEXEC_MAX_MINOR || ticks < 1 ||
+		ticks > 0xffffff ){
+		printf("*** illegal frame configuration\n");
+		return NULL;
+	}
+
+	if( (cx = malloc( sizeof(*cx) )) == NULL )
+		return NULL;
+	memset( cx, 0, sizeof(*cx) );
+	cx->path = path;
+	cx->cfg  = *cfg;
+	cx->cfg.minorUs = ticks * TIME_PER_TICK;
+	cx->fstat.relMin = 0xffffffff;
+
+	if( cfg->source != CEXEC_SRC_POLL ){
+		if( UOS_SigInit( SigHandler ) || UOS_SigInstall( cfg->sig ) ){
+			printf("*** can't install signal\n");
+			free( cx );
+			return NULL;
+		}
+	}
+
+	if( (rv = M_setstat( path, M_MK_IRQ_ENABLE, 1 )) == 0 )
+		cx->irqOn = 1;
+
+	if( rv == 0 && cfg->source == CEXEC_SRC_VTIMER ){
+		M99_VTIMER vt;
+
+		vt.id     = cfg->vtId;
+		vt.first  = ticks;
+		vt.period = ticks;
+		vt.sig    = cfg->sig;
+		blk.size  = sizeof(vt);
+		blk.data  = (void*)&vt;
+		rv = M_setstat( path, M99_BLK_VTIMER, (INT32_OR_64)&blk );
+	}
+	else if( rv == 0 ){
+		M99_CONFIG dc;
+
+		/* POLL: no M99_CFG_SIGNALS, other conditions stay as they are */
+		memset( &dc, 0, sizeof(dc) );
+		dc.flags    = M99_CFG_TIMER | M99_CFG_RESET;
+		dc.timerval = ticks;
+		if( cfg->source == CEXEC_SRC_SIGNAL ){
+			dc.flags |= M99_CFG_SIGNALS;
+			for( i=0; i<M99_MAX_SIGNALS; i++ )
+				dc.sig[i] = cfg->sig;
+		}
+		blk.size = sizeof(dc);
+		blk.data = (void*)&dc;
+		rv = M_setstat( path, M99_BLK_CONFIG, (INT32_OR_64)&blk );
+		cx->condSet = rv == 0 && cfg->source == CEXEC_SRC_SIGNAL;
+	}
+
+	if( rv ){
+		printf("*** can't start tick source: %s\n",
+			   M_errstring(UOS_ErrnoGet()) );
+		CEXEC_Destroy( cx );
+		return NULL;
+	}
+	return cx;
+}
+
+/**********************************************************************/
+/** add task to the frame table
+ *
+ *  The task runs in minor frames \a first, \a first + \a every, ...
+ *  of each major frame, after the tasks added before.
+ *
+ *  \param cx		executive
+ *  \param task		task (copied)
+ *  \param first	first minor frame 0..minors-1
+ *  \param every	release distance in minor frames, 0: once per major
+ *
+ *  \return task index | -1 on error
+ */
+int CEXEC_AddTask( CEXEC *cx, const CEXEC_TASK *task,
+				   u_int32 first, u_int32 every )
+{
+	int t = cx->nTasks;
+	u_int32 f;
+
+	if( t >= CEXEC_MAX_TASKS || first >= cx->cfg.minors )
+		return -1;
+	if( every == 0 )
+		every = cx->cfg.minors;
+
+	for( f=first; f<cx->cfg.minors; f+=every )
+		if( cx->nSlots[f] >= CEXEC_MAX_SLOTS ){
+			printf("*** minor frame %u full\n", (unsigned)f );
+			return -1;
+		}
+
+	for( f=first; f<cx->cfg.minors; f+=every )
+		cx->slot[f][cx->nSlots[f]++] = (u_int8)t;
+
+	cx->task[t] = *task;
+	if( cx->task[t].deadlineUs == 0 ||
+		cx->task[t].deadlineUs > cx->cfg.minorUs )
+		cx->task[t].deadlineUs = cx->cfg.minorUs;
+	cx->tstat[t].execMin = 0xffffffff;
+	cx->nTasks++;
+	return t;
+}
+
+/* current tick count of the tick source */
+static int GetTick( CEXEC *cx, u_int32 *tick )
+{
+	int32 cnt;
+
+	if( cx->cfg.source == CEXEC_SRC_VTIMER ){
+		M99_VTSTAT vs;
+		M_SG_BLOCK blk;
+
+		blk.size = sizeof(vs);
+		blk.data = (void*)&vs;
+		if( M_getstat( cx->path, M99_BLK_VTSTAT, (int32*)&blk ) )
+			return -1;
+		/* periods served late count as elapsed */
+		*tick = vs.vt[cx->cfg.vtId].expiries + vs.vt[cx->cfg.vtId].missed;
+		return 0;
+	}
+
+	if( M_getstat( cx->path, M99_IRQCOUNT, &cnt ) )
+		return -1;
+	*tick = (u_int32)cnt;
+	return 0;
+}
+
+/* wait until the tick count moved beyond cx->tick */
+static int WaitTick( CEXEC *cx, u_int32 *tick )
+{
+	u_int32 seen;
+
+	for(;;){
+		seen = G_sigCount;
+		if( GetTick( cx, tick ) )
+			return -1;
+		if( *tick != cx->tick )
+			return 0;
+
+		if( cx->cfg.source == CEXEC_SRC_POLL )
+			continue;
+#ifdef LINUX
+		{
+			sigset_t none;
+
+			/* no signal may slip in between check and sleep */
+			UOS_SigMask();
+			sigemptyset( &none );
+			while( G_sigCount == seen )
+				sigsuspend( &none );
+			UOS_SigUnMask();
+		}
+#else
+		while( G_sigCount == seen )
+			UOS_Delay( 0 );
+#endif
+	}
+}
+
+/* run tasks of one minor frame released at relUs */
+static void RunFrame( CEXEC *cx, u_int32 minor, u_int64 relUs )
+{
+	u_int64 start, end;
+	u_int32 exec, resp;
+	int s, t;
+
+	for( s=0; s<cx->nSlots[minor]; s++ ){
+		CEXEC_TSTAT *ts;
+
+		t  = cx->slot[minor][s];
+		ts = &cx->tstat[t];
+
+		start = HostTimeUs();
+		cx->task[t].func( cx->task[t].arg );
+		end = HostTimeUs();
+
+		exec = (u_int32)(end - start);
+		resp = (u_int32)(end - relUs);
+		ts->runs++;
+		ts->execSum += exec;
+		if( exec < ts->execMin )
+			ts->execMin = exec;
+		if( exec > ts->execMax )
+			ts->execMax = exec;
+		if( resp > ts->respMax )
+			ts->respMax = resp;
+		if( resp > cx->task[t].deadlineUs ){
+			ts->misses++;
+			if( cx->task[t].miss )
+				cx->task[t].miss( cx->task[t].arg );
+		}
+	}
+
+	cx->fstat.frames++;
+	if( minor == cx->cfg.minors - 1 )
+		cx->fstat.majors++;
+	if( HostTimeUs() - relUs > cx->cfg.minorUs )
+		cx->fstat.overruns++;
+}
+
+/* count tasks of a dropped minor frame */
+static void SkipFrame( CEXEC *cx, u_int32 minor )
+{
+	int s;
+
+	for( s=0; s<cx->nSlots[minor]; s++ )
+		cx->tstat[cx->slot[minor][s]].skipped++;
+	cx->fstat.skipped++;
+	if( minor == cx->cfg.minors - 1 )
+		cx->fstat.majors++;
+}
+
+/**********************************************************************/
+/** run the executive
+ *
+ *  The first tick after the call releases minor frame 0.
+ *
+ *  \param cx		executive
+ *  \param majors	major frames to run, 0: endless
+ *  \param stop		polled once per major frame, stops if != 0 (or NULL)
+ *
+ *  \return CEXEC_DONE | CEXEC_OVERRUN | CEXEC_ERROR
+ */
+int CEXEC_Run( CEXEC *cx, u_int32 majors, int (*stop)( void ) )
+{
+	u_int32 tick, frame = 0, lost, minor, i;
+	u_int64 now, lastRel = 0;
+
+	if( GetTick( cx, &cx->tick ) )
+		return CEXEC_ERROR;
+
+	for(;;){
+		if( WaitTick( cx, &tick ) )
+			return CEXEC_ERROR;
+		now  = HostTimeUs();
+		lost = tick - cx->tick - 1;
+		cx->tick = tick;
+
+		if( lost == 0 && lastRel ){
+			u_int32 rel = (u_int32)(now - lastRel);
+
+			if( rel < cx->fstat.relMin )
+				cx->fstat.relMin = rel;
+			if( rel > cx->fstat.relMax )
+				cx->fstat.relMax = rel;
+		}
+		lastRel = now;
+
+		if( lost && frame ){
+			if( cx->cfg.overrun == CEXEC_OVR_STOP )
+				return CEXEC_OVERRUN;
+
+			/* missed frames were due lost ticks ago */
+			for( i=lost; i>0; i-- ){
+				minor = frame % cx->cfg.minors;
+				if( cx->cfg.overrun == CEXEC_OVR_SKIP )
+					SkipFrame( cx, minor );
+				else {
+					RunFrame( cx, minor,
+							  now - (u_int64)i * cx->cfg.minorUs );
+					cx->fstat.late++;
+				}
+				frame++;
+				if( minor == cx->cfg.minors - 1 &&
+					majors && cx->fstat.majors >= majors )
+					return CEXEC_DONE;
+			}
+		}
+
+		minor = frame % cx->cfg.minors;
+		RunFrame( cx, minor, now );
+		frame++;
+
+		if( minor == cx->cfg.minors - 1 ){
+			if( majors && cx->fstat.majors >= majors )
+				return CEXEC_DONE;
+			if( stop && stop() )
+				return CEXEC_DONE;
+		}
+	}
+}
+
+/**********************************************************************/
+/** get task statistics
+ */
+const CEXEC_TSTAT *CEXEC_TaskStat( const CEXEC *cx, int task )
+{
+	return (task >= 0 && task < cx->nTasks) ? &cx->tstat[task] : NULL;
+}
+
+/**********************************************************************/
+/** get frame statistics
+ */
+const CEXEC_FSTAT *CEXEC_FrameStat( const CEXEC *cx )
+{
+	return &cx->fstat;
+}
+
+/**********************************************************************/
+/** print frame and task statistics
+ */
+void CEXEC_Print( const CEXEC *cx )
+{
+	const CEXEC_FSTAT *fs = &cx->fstat;
+	int t;
+
+	printf("minor frame %u us, %u per major frame\n",
+		   (unsigned)cx->cfg.minorUs, (unsigned)cx->cfg.minors );
+	printf("frames %u  majors %u  overruns %u  late %u  skipped %u",
+		   (unsigned)fs->frames, (unsigned)fs->majors,
+		   (unsigned)fs->overruns, (unsigned)fs->late,
+		   (unsigned)fs->skipped );
+	if( fs->relMax )
+		printf("  release %u..%u us", (unsigned)fs->relMin,
+			   (unsigned)fs->relMax );
+	printf("\n\n");
+
+	printf("task         runs  misses skipped  dl[us] exec min/avg/max[us]"
+		   "  resp max[us]\n");
+	for( t=0; t<cx->nTasks; t++ ){
+		const CEXEC_TSTAT *ts = &cx->tstat[t];
+
+		printf("%-10s %6u %7u %7u %7u ", cx->task[t].name,
+			   (unsigned)ts->runs, (unsigned)ts->misses,
+			   (unsigned)ts->skipped, (unsigned)cx->task[t].deadlineUs );
+		if( ts->runs )
+			printf("%6u %6u %6u %13u\n", (unsigned)ts->execMin,
+				   (unsigned)(ts->execSum / ts->runs),
+				   (unsigned)ts->execMax, (unsigned)ts->respMax );
+		else
+			printf("%6s %6s %6s %13s\n", "-", "-", "-", "-" );
+	}
+}
+
+/**********************************************************************/
+/** stop tick source and free executive
+ */
+void CEXEC_Destroy( CEXEC *cx )
+{
+	M_SG_BLOCK blk;
+
+	if( cx->cfg.source == CEXEC_SRC_VTIMER ){
+		M99_VTIMER vt;
+
+		memset( &vt, 0, sizeof(vt) );
+		vt.id    = cx->cfg.vtId;
+		blk.size = sizeof(vt);
+		blk.data = (void*)&vt;
+		M_setstat( cx->path, M99_BLK_VTIMER, (INT32_OR_64)&blk );
+	}
+	if( cx->condSet ){
+		M_setstat( cx->path, M99_SIG_clr_cond1, cx->cfg.sig );
+		M_setstat( cx->path, M99_SIG_clr_cond2, cx->cfg.sig );
+		M_setstat( cx->path, M99_SIG_clr_cond3, cx->cfg.sig );
+		M_setstat( cx->path, M99_SIG_clr_cond4, cx->cfg.sig );
+	}
+	if( cx->irqOn )
+		M_setstat( cx->path, M_MK_IRQ_ENABLE, 0 );
+
+	if( cx->cfg.source != CEXEC_SRC_POLL ){
+		UOS_SigRemove( cx->cfg.sig );
+		UOS_SigExit();
+	}
+	free( cx );
+}
@@ -0,0 +1,117 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  m99_cexec.h
+ *
+ *      \author  uf
+ *
+ *       \brief  Cyclic executive driven by the M99 timer interrupt
+ *
+ *               A major frame consists of a fixed number of minor frames.
+ *               Each minor frame is released by one M99 tick and runs a
+ *               static list of tasks in table order. Every task has a
+ *               deadline relative to the release of its minor frame.
+ *
+ *               Tick sources:
+ *               - CEXEC_SRC_SIGNAL  driver signal on every timer irq,
+ *                                   the minor frame is the timer period
+ *               - CEXEC_SRC_VTIMER  periodic virtual timer (M99_BLK_VTIMER)
+ *                                   with its own signal, base timer unchanged
+ *               - CEXEC_SRC_POLL    busy polling of the irq counter
+ *
+ *    Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _M99_CEXEC_H
+#define _M99_CEXEC_H
+
+#define CEXEC_MAX_TASKS		16
+#define CEXEC_MAX_MINOR		64		/* minor frames per major frame */
+#define CEXEC_MAX_SLOTS		8		/* tasks per minor frame */
+
+/* tick sources */
+#define CEXEC_SRC_SIGNAL	0
+#define CEXEC_SRC_VTIMER	1
+#define CEXEC_SRC_POLL		2
+
+/* frame overrun handling (next tick arrived before frame done) */
+#define CEXEC_OVR_CATCHUP	0		/* run missed minor frames late */
+#define CEXEC_OVR_SKIP		1		/* drop missed minor frames */
+#define CEXEC_OVR_STOP		2		/* stop the executive */
+
+/* CEXEC_Run return values */
+#define CEXEC_DONE			0		/* major frames done or stop request */
+#define CEXEC_OVERRUN		1		/* stopped by CEXEC_OVR_STOP */
+#define CEXEC_ERROR			-1		/* driver access failed */
+
+typedef void (*CEXEC_FUNC)( void *arg );
+
+/* configuration */
+typedef struct {
+	int     source;			/* CEXEC_SRC_xxx */
+	u_int32 sig;			/* signal for SIGNAL/VTIMER source */
+	u_int32 vtId;			/* virtual timer for VTIMER source */
+	u_int32 minorUs;		/* minor frame length [us], multiple of 4 */
+	u_int32 minors;			/* minor frames per major frame */
+	int     overrun;		/* CEXEC_OVR_xxx */
+} CEXEC_CFG;
+
+/* task, released in minor frames first, first+every, ... */
+typedef struct {
+	const char *name;
+	CEXEC_FUNC  func;
+	void        *arg;
+	u_int32     deadlineUs;	/* from frame release, 0: end of minor frame */
+	CEXEC_FUNC  miss;		/* called after a deadline miss, or NULL */
+} CEXEC_TASK;
+
+/* task statistics */
+typedef struct {
+	u_int32 runs;
+	u_int32 misses;			/* finished after deadline */
+	u_int32 skipped;		/* dropped with its minor frame */
+	u_int32 execMin;		/* execution time [us] */
+	u_int32 execMax;
+	u_int64 execSum;
+	u_int32 respMax;		/* release to finish [us] */
+} CEXEC_TSTAT;
+
+/* frame statistics */
+typedef struct {
+	u_int32 frames;			/* minor frames run */
+	u_int32 majors;			/* major frames completed */
+	u_int32 overruns;		/* minor frames ending after next release */
+	u_int32 late;			/* minor frames run late (catch up) */
+	u_int32 skipped;		/* minor frames dropped */
+	u_int32 relMin;			/* release interval [us] */
+	u_int32 relMax;
+} CEXEC_FSTAT;
+
+typedef struct CEXEC CEXEC;
+
+extern CEXEC *CEXEC_Create( MDIS_PATH path, const CEXEC_CFG *cfg );
+extern int   CEXEC_AddTask( CEXEC *cx, const CEXEC_TASK *task,
+							u_int32 first, u_int32 every );
+extern int   CEXEC_Run( CEXEC *cx, u_int32 majors, int (*stop)( void ) );
+extern const CEXEC_TSTAT *CEXEC_TaskStat( const CEXEC *cx, int task );
+extern const CEXEC_FSTAT *CEXEC_FrameStat( const CEXEC *cx );
+extern void  CEXEC_Print( const CEXEC *cx );
+extern void  CEXEC_Destroy( CEXEC *cx );
+
+#endif /* _M99_CEXEC_H */
@@ -0,0 +1,249 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_cyclic.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Sample for the M99 cyclic executive (m99_cexec)
+ *
+ *               Runs three dummy control tasks from a frame table:
+ *
+ *               task  minor frames        deadline
+ *               ctrl  every frame         1/2 minor frame
+ *               io    every 2nd frame     end of minor frame
+ *               log   once (last frame)   end of minor frame
+ *
+ *               Each task busy waits its execution time, -l adds load to
+ *               ctrl to provoke deadline misses and frame overruns.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef LINUX
+# include <time.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_utl.h>
+#include <MEN/usr_oss.h>
+#include "m99_cexec.h"
+
+static const char IdentString[]=MENT_XSTR(MAK_REVISION);
+
+/* busy time of a dummy task [us] */
+typedef struct {
+	u_int32 busyUs;
+	u_int32 misses;
+} DUMMY;
+
+/**********************************************************************/
+/** print usage
+ */
+static void usage(void)
+{
+	printf("Usage: m99_cyclic [<opts>] <device> [<opts>]\n");
+	printf("Function: Cyclic executive sample driven by the M99 timer\n");
+	printf("Options:\n");
+	printf("    -m=<us>    minor frame length                [1000]\n");
+	printf("    -n=<num>   minor frames per major frame      [4]\n");
+	printf("    -s=<src>   tick source                       [sig]\n");
+	printf("               sig:  driver signal per timer irq\n");
+	printf("               vt:   virtual timer (base timer unchanged)\n");
+	printf("               poll: poll irq counter (busy)\n");
+	printf("    -v=<id>    virtual timer for -s=vt           [0]\n");
+	printf("    -o=<pol>   frame overrun: catchup|skip|stop  [catchup]\n");
+	printf("    -f=<num>   major frames, 0=until key         [0]\n");
+	printf("    -l=<us>    additional load of task ctrl      [0]\n");
+	printf("    device     devicename (M99)        [none]\n");
+	printf("\n");
+	printf("Copyright 2019, MEN Mikro Elektronik GmbH\n");
+	printf("%s\n", IdentString );
+}
+
+static u_int64 HostTimeUs( void )
+{
+#ifdef LINUX
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	return (u_int64)UOS_MsecTimerGet() * 1000;
+#endif
+}
+
+static void Busy( void *arg )
+{
+	DUMMY *d = (DUMMY*)arg;
+	u_int64 end = HostTimeUs() + d->busyUs;
+
+	while( HostTimeUs() < end )
+		;
+}
+
+static void Miss( void *arg )
+{
+	((DUMMY*)arg)->misses++;
+}
+
+static int KeyStop( void )
+{
+	return UOS_KeyPressed() != -1;
+}
+
+/**********************************************************************/
+/** where all begins...
+ */
+int main( int argc, char **argv )
+{
+	char *device=NULL,*str,*errstr,buf[40];
+	MDIS_PATH path;
+	CEXEC_CFG cfg;
+	CEXEC_TASK task;
+	CEXEC *cx;
+	DUMMY ctrl, io, log;
+	u_int32 majors;
+	int32 n;
+	int rv;
+
+	if ((errstr = UTL_ILLIOPT("m=n=s=v=o=f=l=?", buf))) {	/* check args */
+		printf("*** %s\n", errstr);
+		return(1);
+	}
+
+	if (UTL_TSTOPT("?")) {						/* help requested ? */
+		usage();
+		return(1);
+	}
+
+	for (n=1; n<argc; n++)   		/* search for device */
+		if (*argv[n] != '-') {
+			device = argv[n];
+			break;
+		}
+
+	if (!device) {
+		usage();
+		return(1);
+	}
+
+	memset( &cfg, 0, sizeof(cfg) );
+	cfg.minorUs	= ((str=UTL_TSTOPT("m=")) ? atoi(str) : 1000);
+	cfg.minors	= ((str=UTL_TSTOPT("n=")) ? atoi(str) : 4);
+	cfg.vtId	= ((str=UTL_TSTOPT("v=")) ? atoi(str) : 0);
+	cfg.sig		= UOS_SIG_USR2;
+	majors		= ((str=UTL_TSTOPT("f=")) ? atoi(str) : 0);
+
+	str = UTL_TSTOPT("s=");
+	if( str == NULL || !strcmp( str, "sig" ))
+		cfg.source = CEXEC_SRC_SIGNAL;
+	else if( !strcmp( str, "vt" ))
+		cfg.source = CEXEC_SRC_VTIMER;
+	else if( !strcmp( str, "poll" ))
+		cfg.source = CEXEC_SRC_POLL;
+	else {
+		printf("*** unknown tick source %s\n", str );
+		return(1);
+	}
+
+	str = UTL_TSTOPT("o=");
+	if( str == NULL || !strcmp( str, "catchup" ))
+		cfg.overrun = CEXEC_OVR_CATCHUP;
+	else if( !strcmp( str, "skip" ))
+		cfg.overrun = CEXEC_OVR_SKIP;
+	else if( !strcmp( str, "stop" ))
+		cfg.overrun = CEXEC_OVR_STOP;
+	else {
+		printf("*** unknown overrun policy %s\n", str );
+		return(1);
+	}
+
+	memset( &ctrl, 0, sizeof(ctrl) );
+	memset( &io, 0, sizeof(io) );
+	memset( &log, 0, sizeof(log) );
+	ctrl.busyUs = cfg.minorUs / 10 +
+				  ((str=UTL_TSTOPT("l=")) ? atoi(str) : 0);
+	io.busyUs   = cfg.minorUs / 5;
+	log.busyUs  = cfg.minorUs / 4;
+
+	if( (path = M_open( device )) < 0 ){
+		printf("*** can't open %s: %s\n", device,
+			   M_errstring(UOS_ErrnoGet()) );
+		return(1);
+	}
+
+	if( (cx = CEXEC_Create( path, &cfg )) == NULL ){
+		M_close( path );
+		return(1);
+	}
+
+	memset( &task, 0, sizeof(task) );
+	task.name       = "ctrl";
+	task.func       = Busy;
+	task.arg        = &ctrl;
+	task.deadlineUs = cfg.minorUs / 2;
+	task.miss       = Miss;
+	rv = CEXEC_AddTask( cx, &task, 0, 1 ) < 0;
+
+	task.name       = "io";
+	task.arg        = &io;
+	task.deadlineUs = 0;
+	rv |= CEXEC_AddTask( cx, &task, 0, 2 ) < 0;
+
+	task.name       = "log";
+	task.arg        = &log;
+	rv |= CEXEC_AddTask( cx, &task, cfg.minors - 1, 0 ) < 0;
+
+	if( rv ){
+		printf("*** can't build frame table\n");
+		CEXEC_Destroy( cx );
+		M_close( path );
+		return(1);
+	}
+
+	if( !majors )
+		printf("(press any key for exit)\n");
+
+	switch( CEXEC_Run( cx, majors, KeyStop ) ){
+	case CEXEC_OVERRUN:
+		printf("*** stopped by frame overrun\n");
+		rv = 1;
+		break;
+	case CEXEC_ERROR:
+		printf("*** driver access failed: %s\n",
+			   M_errstring(UOS_ErrnoGet()) );
+		rv = 1;
+		break;
+	}
+
+	CEXEC_Print( cx );
+	printf("\nmiss handler calls: ctrl %u  io %u  log %u\n",
+		   (unsigned)ctrl.misses, (unsigned)io.misses,
+		   (unsigned)log.misses );
+
+	CEXEC_Destroy( cx );
+	M_close( path );
+	return(rv);
+}
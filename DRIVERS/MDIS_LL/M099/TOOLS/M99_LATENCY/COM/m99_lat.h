@@ -0,0 +1,217 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  m99_lat.h
+ *
+ *      \author  uf
+ *
+ *       \brief  Internal interface between the m99_latency modules
+ *
+ *    Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _M99_LAT_H
+#define _M99_LAT_H
+
+#define TIME_PER_TICK	4		/* 68230 timer runs at 250kHz */
+#define TICKS2US(tks) ((tks)*TIME_PER_TICK)
+
+#define STATS_HIST_SIZE	4096	/* ticks, larger values in last bucket */
+
+typedef struct {
+	int32 min;
+	int32 max; 
+	int32 avgAcc;
+	int32 count;
+	int32 first;
+	int32 totalMin;
+	int32 totalMax;
+	u_int32 hist[STATS_HIST_SIZE];	/* interval histogram, 1 tick/bucket */
+} STATS;
+
+/* run configuration, reported with every machine readable record */
+typedef struct {
+	const char *device;
+	int32 timerval;
+	int   interval;
+	int   swt;				/* software timer thread running */
+	int   poll;				/* polling thread running */
+	int   sys;				/* system activity sampled */
+	int   pmu;				/* perf counters of the receiver */
+} RUN_CFG;
+
+/* cost of the getstat calls of the polling thread */
+typedef struct {
+	u_int32 polls;			/* getstat calls */
+	u_int32 detected;		/* expiries seen */
+	u_int32 missed;			/* expiries between two polls (irq count) */
+	u_int32 nsMin;			/* duration of one poll [ns] */
+	u_int32 nsMax;
+	u_int64 nsSum;
+} POLL_COST;
+
+/* system activity of one report interval (m99_lat_sys.c) */
+typedef struct {
+	int     valid;
+	u_int64 irqs;			/* all interrupts */
+	u_int64 softirqs;
+	u_int64 ctxt;			/* context switches */
+	u_int64 faults;			/* page faults */
+	u_int64 majFaults;
+	u_int64 rqWaitUs;		/* run queue wait, all cpus */
+	u_int32 running;		/* runnable tasks at interval end */
+} SYS_IV;
+
+/* perf counters of the receiver, per interval (m99_lat_pmu.c) */
+#define PMU_CYCLES		0
+#define PMU_CACHEMISS	1
+#define PMU_CTXSW		2
+#define PMU_MIGR		3
+#define PMU_FAULTS		4
+#define PMU_NUM			5
+
+typedef struct {
+	u_int32 valid;			/* bit mask of counters opened (1<<PMU_xxx) */
+	u_int32 samples;		/* signal samples with counter delta */
+	u_int32 outliers;		/* ..of them above the -m threshold */
+	u_int64 sum[PMU_NUM];	/* delta of all samples */
+	u_int64 outSum[PMU_NUM];/* delta of the outlier samples */
+} PMU_IV;
+
+/* results of one report interval */
+typedef struct {
+	u_int32     no;				/* interval number, 1.. */
+	const STATS *irq;			/* irq latency */
+	const STATS *sig;			/* signal latency */
+	const STATS *swt;			/* software timer latency, NULL=off */
+	const STATS *poll;			/* polling detection latency, NULL=off */
+	const POLL_COST *pollCost;
+	const SYS_IV *sys;			/* system activity, NULL=off */
+	const PMU_IV *pmu;			/* receiver perf counters, NULL=off */
+	int32       spikeUs;		/* max. latency if above -y threshold */
+	u_int32     irqs;			/* irqs counted by driver */
+	u_int32     overruns;		/* irqs without handled signal */
+	u_int32     sigHandled;		/* signal handler calls */
+	u_int32     sigLost;		/* signals sent but never handled */
+	int         drvValid;		/* driver interval stats (M99_BLK_IVSTAT) */
+	u_int32     drvCount;		/* irqs */
+	u_int32     drvMin;			/* irq latency [ticks] */
+	u_int32     drvMax;
+	u_int64     drvSum;
+	u_int32     drvOverruns;	/* irqs later than M99_OVR_LIMIT */
+} INTERVAL;
+
+/* m99_latency.c */
+extern u_int64 HostTimeUs( void );
+extern void  InitStats( STATS *st );
+extern void  UpdateStats( STATS *st, int32 tval );
+extern void  PrintStats( const STATS *st );
+extern int32 StatsPercentile( const STATS *st, double q );
+extern int   DrvStart( MDIS_PATH path, int32 timerval, u_int32 sig );
+
+/* signal loss from driver send counters, see SigLost() */
+typedef struct {
+	u_int32 ahead;			/* sent - handled at previous call */
+	u_int32 lost;			/* signals lost so far */
+} SIG_LOSS;
+
+extern u_int32 SigLost( MDIS_PATH path, u_int32 handled, int final,
+						SIG_LOSS *sl );
+
+/* m99_lat_multi.c: several devices in one run */
+#define MULTI_MAX_DEV	8
+
+extern int MULTI_Run( char **device, int nDev, int32 timerval,
+					  int interval );
+
+/* m99_lat_sys.c: /proc system activity sampler */
+extern int  SYS_Start( void );
+extern void SYS_Sample( SYS_IV *sys );
+extern void SYS_Judge( FILE *fp, u_int32 no, int32 spikeUs );
+
+/* m99_lat_pmu.c: perf counters around latency outliers */
+extern const char *PMU_Name[PMU_NUM];
+
+extern int  PMU_Start( void );
+extern void PMU_Sample( int outlier );
+extern void PMU_Take( PMU_IV *iv );
+extern void PMU_Print( FILE *fp, const char *what, const PMU_IV *iv );
+extern void PMU_Stop( void );
+
+/* m99_lat_sweep.c: irq / receiver cpu sweep */
+extern int SWEEP_Run( const char *device, int32 timerval, int hold, int irq );
+
+/* m99_lat_swt.c: clock_nanosleep reference thread */
+extern int  SWT_Start( int32 timerval, int prio );
+extern void SWT_Take( STATS *st );
+extern void SWT_Stop( void );
+
+/* m99_lat_poll.c: busy polling detection thread */
+#define POLL_SRC_IRQCOUNT	0
+#define POLL_SRC_TIME		1
+
+extern int  POLL_Start( const char *device, int src, int cpu );
+extern void POLL_Take( STATS *st, POLL_COST *cost );
+extern void POLL_Stop( void );
+
+/* m99_lat_cap.c: binary per-sample capture */
+extern int  CAP_Start( const char *file, int32 timerval, int interval );
+extern void CAP_Push( u_int32 seq, u_int32 irqLat, u_int32 sigLat );
+extern void CAP_Poll( void );
+extern void CAP_Stop( void );
+
+/* m99_lat_trc.c: Chrome/Perfetto JSON trace, ftrace markers */
+extern int  TRC_Start( const char *file, const char *device, int32 thrUs,
+					   int marker );
+extern void TRC_Push( u_int32 seq, u_int32 irqLat, u_int32 sigLat );
+extern void TRC_Lost( u_int32 interval, u_int32 lost );
+extern void TRC_Poll( void );
+extern void TRC_Stop( void );
+
+/* m99_lat_base.c: baseline save/compare, regression gate */
+#define BASE_NUM_PCT	5		/* p50 p90 p99 p999 max */
+
+typedef struct {
+	double pct[BASE_NUM_PCT];	/* max. increase, -1: no check */
+	int    rel[BASE_NUM_PCT];	/* pct[] in % of baseline, else us */
+	double ks;					/* max. KS distance D+, -1: no check */
+} BASE_LIM;
+
+extern int BASE_Limits( const char *spec, BASE_LIM *lim );
+extern int BASE_Save( const char *file, int32 timerval,
+					  const u_int32 *irqHist, const u_int32 *sigHist );
+extern int BASE_Compare( FILE *fp, const char *file, int32 timerval,
+						 const u_int32 *irqHist, const u_int32 *sigHist,
+						 const BASE_LIM *lim );
+
+/* m99_lat_prom.c: Prometheus textfile for permanent monitoring */
+extern int  PROM_Open( const char *dir, const RUN_CFG *cfg );
+extern void PROM_Update( const INTERVAL *iv );
+extern void PROM_Close( void );
+
+/* m99_lat_out.c: machine readable interval records */
+#define OUT_FMT_CSV		1
+#define OUT_FMT_JSON	2
+
+extern int  OUT_Open( const char *fmt, const char *file, const RUN_CFG *cfg );
+extern int  OUT_ToStdout( void );
+extern void OUT_Record( const INTERVAL *iv );
+extern void OUT_Close( void );
+
+#endif /* _M99_LAT_H */
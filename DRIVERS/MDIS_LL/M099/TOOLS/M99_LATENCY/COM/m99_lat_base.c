@@ -0,0 +1,328 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_base.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Baseline save/compare of m99_latency (regression gate)
+ *
+ *               A baseline is the run histogram (4us buckets) of irq
+ *               and signal latency in a small text file:
+ *
+ *               m99_latency baseline 1
+ *               timerval <ticks>
+ *               <path> <bucket> <count>     irq / sig, non-empty only
+ *
+ *               A later run is compared per path with percentile deltas
+ *               (p50 p90 p99 p99.9 max) and a one-sided two sample
+ *               Kolmogorov-Smirnov test (new run slower than baseline).
+ *               Each delta and the KS distance D+ has a limit, see
+ *               BASE_Limits(). Exceeded limits are a regression, for KS
+ *               only if D+ is also significant (alpha 0.01).
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+#define BASE_MAGIC		"m99_latency baseline"
+#define BASE_VERSION	1
+/* one-sided KS critical value factor for alpha 0.01: sqrt(-ln(0.01)/2) */
+#define BASE_KS_C		1.5174
+
+static const char *G_path[2] = { "irq", "sig" };
+
+/* compared percentiles, order of BASE_LIM.pct */
+static const struct {
+	const char *name;
+	double q;				/* 0: max */
+} G_q[BASE_NUM_PCT] = {
+	{ "p50", 0.50 }, { "p90", 0.90 }, { "p99", 0.99 }, { "p999", 0.999 },
+	{ "max", 0.0 }
+};
+
+static u_int64 HistCount( const u_int32 *h )
+{
+	u_int64 n = 0;
+	int i;
+
+	for( i=0; i<STATS_HIST_SIZE; i++ )
+		n += h[i];
+	return n;
+}
+
+/* bucket [ticks] below which fraction q of the samples lie, 0: max */
+static int32 HistQ( const u_int32 *h, u_int64 n, double q )
+{
+	double acc = 0;
+	int i;
+
+	if( !n )
+		return -1;
+	if( q == 0.0 ){
+		for( i=STATS_HIST_SIZE-1; i>0 && !h[i]; i-- )
+			;
+		return i;
+	}
+	for( i=0; i<STATS_HIST_SIZE-1; i++ ){
+		acc += h[i];
+		if( acc >= q * n )
+			return i;
+	}
+	return STATS_HIST_SIZE-1;
+}
+
+/* no libm in the MDIS tool link */
+static double Sqrt( double x )
+{
+	double r = x > 1 ? x : 1;
+	int i;
+
+	if( x <= 0 )
+		return 0;
+	for( i=0; i<64; i++ )
+		r = (r + x / r) / 2;
+	return r;
+}
+
+/*
+ * one-sided KS: D+ = max(Fbase - Fnew), new run slower where its CDF lies
+ * below the baseline. Critical D+ for alpha 0.01 returned in *crit.
+ */
+static double KsPlus( const u_int32 *b, u_int64 nb, const u_int32 *n,
+					  u_int64 nn, double *crit )
+{
+	double fb = 0, fn = 0, d = 0;
+	int i;
+
+	for( i=0; i<STATS_HIST_SIZE; i++ ){
+		fb += (double)b[i] / nb;
+		fn += (double)n[i] / nn;
+		if( fb - fn > d )
+			d = fb - fn;
+	}
+	*crit = BASE_KS_C * Sqrt( (double)(nb + nn) / ((double)nb * nn) );
+	return d;
+}
+
+/**********************************************************************/
+/** parse regression limits
+ *
+ *  \a spec is a comma separated list of <name>=<limit>, name one of
+ *  p50 p90 p99 p999 max (limit in us, or in % of the baseline with a
+ *  trailing %) or ks (max. KS distance D+, 0..1). Limits not given
+ *  keep their default, -1 disables a check.
+ *
+ *  \return 0 | -1 on syntax error
+ */
+int BASE_Limits( const char *spec, BASE_LIM *lim )
+{
+	char buf[256], *tok, *val, *end;
+	int i;
+
+	/* defaults: relative limits on the body of the distribution */
+	for( i=0; i<BASE_NUM_PCT; i++ ){
+		lim->pct[i] = -1;
+		lim->rel[i] = 0;
+	}
+	lim->pct[0] = 10; lim->rel[0] = 1;	/* p50  +10% */
+	lim->pct[2] = 20; lim->rel[2] = 1;	/* p99  +20% */
+	lim->ks = 0.1;
+
+	if( spec == NULL )
+		return 0;
+
+	strncpy( buf, spec, sizeof(buf)-1 );
+	buf[sizeof(buf)-1] = '\0';
+	for( tok=strtok( buf, "," ); tok; tok=strtok( NULL, "," )){
+		if( (val = strchr( tok, '=' )) == NULL )
+			goto SYNTAX;
+		*val++ = '\0';
+
+		if( !strcmp( tok, "ks" )){
+			lim->ks = strtod( val, &end );
+			if( end == val || *end )
+				goto SYNTAX;
+			continue;
+		}
+		for( i=0; i<BASE_NUM_PCT; i++ )
+			if( !strcmp( tok, G_q[i].name ))
+				break;
+		if( i == BASE_NUM_PCT )
+			goto SYNTAX;
+		lim->pct[i] = strtod( val, &end );
+		lim->rel[i] = *end == '%';
+		if( end == val || (*end && strcmp( end, "%" )))
+			goto SYNTAX;
+	}
+	return 0;
+
+ SYNTAX:
+	printf("*** bad regression limit %s\n", spec );
+	return -1;
+}
+
+/**********************************************************************/
+/** save run histograms as baseline
+ *
+ *  \return 0 | -1 on error
+ */
+int BASE_Save( const char *file, int32 timerval, const u_int32 *irqHist,
+			   const u_int32 *sigHist )
+{
+	const u_int32 *h[2];
+	FILE *fp;
+	int p, i, rv;
+
+	h[0] = irqHist;
+	h[1] = sigHist;
+	if( (fp = fopen( file, "w" )) == NULL ){
+		printf("*** can't create baseline %s\n", file );
+		return -1;
+	}
+	fprintf( fp, "%s %d\ntimerval %d\n", BASE_MAGIC, BASE_VERSION,
+			 (int)timerval );
+	for( p=0; p<2; p++ )
+		for( i=0; i<STATS_HIST_SIZE; i++ )
+			if( h[p][i] )
+				fprintf( fp, "%s %d %u\n", G_path[p], i, (unsigned)h[p][i] );
+
+	rv = ferror( fp );
+	if( fclose( fp ) || rv ){
+		printf("*** can't write baseline %s\n", file );
+		return -1;
+	}
+	printf("baseline: saved to %s\n", file );
+	return 0;
+}
+
+/**********************************************************************/
+/** compare run histograms with baseline
+ *
+ *  \param fp		output for the report
+ *  \param lim		regression limits
+ *
+ *  \return 0 no regression | 1 regression | -1 baseline not usable
+ */
+int BASE_Compare( FILE *fp, const char *file, int32 timerval,
+				  const u_int32 *irqHist, const u_int32 *sigHist,
+				  const BASE_LIM *lim )
+{
+	static u_int32 base[2][STATS_HIST_SIZE];
+	const u_int32 *h[2];
+	char line[128], name[16];
+	FILE *bf;
+	int p, i, bucket, ver = 0, regress = 0, unusable = 0;
+	int32 btv = -1;
+	unsigned cnt;
+
+	h[0] = irqHist;
+	h[1] = sigHist;
+	memset( base, 0, sizeof(base) );
+
+	if( (bf = fopen( file, "r" )) == NULL ){
+		printf("*** can't open baseline %s\n", file );
+		return -1;
+	}
+	if( !fgets( line, sizeof(line), bf ) ||
+		strncmp( line, BASE_MAGIC, strlen(BASE_MAGIC) ) ||
+		(ver = atoi( line + strlen(BASE_MAGIC) )) != BASE_VERSION ){
+		printf("*** %s: no baseline (version %d)\n", file, ver );
+		fclose( bf );
+		return -1;
+	}
+	while( fgets( line, sizeof(line), bf )){
+		if( sscanf( line, "timerval %d", &i ) == 1 )
+			btv = i;
+		else if( sscanf( line, "%15s %d %u", name, &bucket, &cnt ) == 3 &&
+				 bucket >= 0 && bucket < STATS_HIST_SIZE )
+			for( p=0; p<2; p++ )
+				if( !strcmp( name, G_path[p] ))
+					base[p][bucket] = cnt;
+	}
+	fclose( bf );
+
+	if( btv != timerval )
+		fprintf( fp, "BASE: warning: baseline timerval %d, run %d\n",
+				 (int)btv, (int)timerval );
+
+	fprintf( fp, "BASE: compare with %s\n", file );
+	fprintf( fp, "BASE: path  what   base[us]    run[us]    delta   limit\n" );
+	for( p=0; p<2; p++ ){
+		u_int64 nb = HistCount( base[p] ), nr = HistCount( h[p] );
+		double d, crit;
+
+		if( !nb || !nr ){
+			fprintf( fp, "BASE: %-4s no samples (baseline %llu, run %llu)\n",
+					 G_path[p], (unsigned long long)nb,
+					 (unsigned long long)nr );
+			unusable = 1;
+			continue;
+		}
+
+		for( i=0; i<BASE_NUM_PCT; i++ ){
+			int32 b = TICKS2US(HistQ( base[p], nb, G_q[i].q ));
+			int32 r = TICKS2US(HistQ( h[p], nr, G_q[i].q ));
+			double lmt = -1;
+			int bad = 0;
+
+			if( lim->pct[i] >= 0 ){
+				lmt = lim->rel[i] ? b * lim->pct[i] / 100.0 : lim->pct[i];
+				/* relative limits: at least one bucket */
+				if( lim->rel[i] && lmt < TIME_PER_TICK )
+					lmt = TIME_PER_TICK;
+				bad = r - b > lmt;
+			}
+			fprintf( fp, "BASE: %-4s %-5s %9d  %9d %+8d", G_path[p],
+					 G_q[i].name, (int)b, (int)r, (int)(r - b) );
+			if( lmt >= 0 )
+				fprintf( fp, " %7.0f%s\n", lmt, bad ? "  REGRESSION" : "" );
+			else
+				fprintf( fp, " %7s\n", "-" );
+			regress |= bad;
+		}
+
+		d = KsPlus( base[p], nb, h[p], nr, &crit );
+		fprintf( fp, "BASE: %-4s KS D+ %.4f crit %.4f (n %llu/%llu)",
+				 G_path[p], d, crit, (unsigned long long)nb,
+				 (unsigned long long)nr );
+		if( lim->ks >= 0 && d > lim->ks && d > crit ){
+			fprintf( fp, " limit %.4f  REGRESSION\n", lim->ks );
+			regress = 1;
+		}
+		else if( lim->ks >= 0 )
+			fprintf( fp, " limit %.4f\n", lim->ks );
+		else
+			fprintf( fp, "\n" );
+	}
+	if( unusable ){
+		fprintf( fp, "BASE: not comparable\n" );
+		return -1;
+	}
+	fprintf( fp, "BASE: %s\n", regress ? "REGRESSION" : "ok" );
+	return regress;
+}
@@ -0,0 +1,302 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_cap.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Binary per-sample capture of m99_latency
+ *
+ *               The signal handler only copies each sample into a lock
+ *               free single producer/single consumer ring. A background
+ *               writer thread encodes the samples into delta/varint
+ *               blocks (see m99_cap.h) and writes them to the file, so
+ *               file I/O never delays the measurement. When the ring is
+ *               full, samples are dropped and counted instead of
+ *               blocking the handler.
+ *
+ *               Without thread support the ring is drained from the
+ *               main loop once per interval.
+ *
+ *     Switches: LINUX   use a pthread as writer
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef LINUX
+# include <pthread.h>
+# include <signal.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_oss.h>
+#define M99CAP_WRITER
+#include <MEN/m99_cap.h>
+#include "m99_lat.h"
+
+#define CAP_RING_SIZE	0x10000		/* samples, must be power of 2 */
+#define CAP_FLUSH_US	1000000		/* max. age of a pending block */
+#define CAP_POLL_MS		10			/* writer thread poll period */
+
+#if defined(__GNUC__)
+# define CAP_BARRIER()	__sync_synchronize()
+#else
+# define CAP_BARRIER()
+#endif
+
+static M99CAP_SAMPLE	G_ring[CAP_RING_SIZE];
+static volatile u_int32	G_head;		/* written by producer only */
+static volatile u_int32	G_tail;		/* written by consumer only */
+static u_int32			G_ringDropped;	/* ring full (producer) */
+static u_int32			G_ioDropped;	/* write error (consumer) */
+static u_int32			G_written;
+
+static FILE				*G_fp;
+static u_int64			G_t0;
+static int				G_ioError;
+static volatile int		G_run;
+static int				G_threaded;
+#ifdef LINUX
+static pthread_t		G_thread;
+#endif
+
+/* block under construction */
+static u_int8			G_blk[M99CAP_BLK_BYTES];
+static int				G_blkLen;
+static u_int32			G_blkCnt;
+static u_int64			G_blkStart;
+static M99CAP_SAMPLE	G_prev;
+static int64			G_prevDts;
+
+/**********************************************************************/
+/** write pending block to file
+ */
+static void FlushBlock( void )
+{
+	u_int8 hdr[1+M99CAP_VARINT_MAX];
+	int n;
+
+	if( G_blkCnt == 0 )
+		return;
+
+	hdr[0] = M99CAP_TAG_BLOCK;
+	n = 1 + M99CAP_PutVarint( &hdr[1], G_blkCnt );
+
+	if( !G_ioError &&
+		( fwrite( hdr, 1, n, G_fp ) != (size_t)n ||
+		  fwrite( G_blk, 1, G_blkLen, G_fp ) != (size_t)G_blkLen ||
+		  fflush( G_fp ) != 0 )){
+		printf("*** capture: write error, capture stopped\n");
+		G_ioError = 1;
+	}
+
+	if( G_ioError )
+		G_ioDropped += G_blkCnt;
+	else
+		G_written += G_blkCnt;
+
+	G_blkCnt = 0;
+	G_blkLen = 0;
+}
+
+/**********************************************************************/
+/** append one sample to the pending block
+ */
+static void EncodeSample( const M99CAP_SAMPLE *s )
+{
+	u_int8 *p = G_blk + G_blkLen;
+	int64 dts;
+
+	if( G_blkCnt == 0 ){
+		p += M99CAP_PutVarint( p, s->seq );
+		p += M99CAP_PutVarint( p, s->irqLat );
+		p += M99CAP_PutVarint( p, s->sigLat );
+		p += M99CAP_PutVarint( p, s->tsUs );
+		G_prevDts  = 0;
+		G_blkStart = s->tsUs;
+	}
+	else {
+		dts = (int64)(s->tsUs - G_prev.tsUs);
+		p += M99CAP_PutVarint( p, (u_int32)(s->seq - G_prev.seq) );
+		p += M99CAP_PutVarint( p, M99CAP_ZZ_ENC( (int64)s->irqLat -
+												 (int64)G_prev.irqLat ));
+		p += M99CAP_PutVarint( p, M99CAP_ZZ_ENC( (int64)s->sigLat -
+												 (int64)G_prev.sigLat ));
+		p += M99CAP_PutVarint( p, M99CAP_ZZ_ENC( dts - G_prevDts ));
+		G_prevDts = dts;
+	}
+
+	G_blkLen = (int)(p - G_blk);
+	G_prev = *s;
+
+	if( ++G_blkCnt == M99CAP_BLK_MAX )
+		FlushBlock();
+}
+
+/**********************************************************************/
+/** move all samples from ring into blocks
+ */
+static void Drain( void )
+{
+	u_int32 head = G_head;
+
+	CAP_BARRIER();
+	while( G_tail != head ){
+		EncodeSample( &G_ring[G_tail & (CAP_RING_SIZE-1)] );
+		CAP_BARRIER();
+		G_tail++;
+	}
+
+	/* don't keep a slowly filling block in memory for too long */
+	if( G_blkCnt && (HostTimeUs() - G_t0 - G_blkStart) >= CAP_FLUSH_US )
+		FlushBlock();
+}
+
+#ifdef LINUX
+static void *WriterThread( void *arg )
+{
+	while( G_run ){
+		Drain();
+		UOS_Delay( CAP_POLL_MS );
+	}
+	return NULL;
+}
+#endif
+
+/**********************************************************************/
+/** create capture file and start writer
+ *
+ *  \param file		capture file name
+ *  \param timerval	timer value of the run (stored in header)
+ *  \param interval	report interval [s] (stored in header)
+ *
+ *  \return 0 | -1 on error
+ */
+int CAP_Start( const char *file, int32 timerval, int interval )
+{
+	M99CAP_HDR hdr;
+	u_int8 p[M99CAP_HDR_SIZE];
+
+	if( (G_fp = fopen( file, "wb" )) == NULL ){
+		printf("*** capture: can't create %s\n", file );
+		return -1;
+	}
+
+	memset( &hdr, 0, sizeof(hdr) );
+	hdr.version   = M99CAP_VERSION;
+	hdr.timerval  = timerval;
+	hdr.tickNs    = TICKS2US(1000);
+	hdr.startTime = (u_int32)time( NULL );
+	hdr.interval  = interval;
+	M99CAP_PutHdr( p, &hdr );
+
+	if( fwrite( p, 1, sizeof(p), G_fp ) != sizeof(p) || fflush( G_fp )){
+		printf("*** capture: can't write %s\n", file );
+		fclose( G_fp );
+		G_fp = NULL;
+		return -1;
+	}
+
+	G_t0  = HostTimeUs();
+	G_run = 1;
+
+#ifdef LINUX
+	{
+		/* writer must never be the target of the measured signal */
+		sigset_t all, old;
+
+		sigfillset( &all );
+		pthread_sigmask( SIG_BLOCK, &all, &old );
+		G_threaded = pthread_create( &G_thread, NULL, WriterThread,
+									 NULL ) == 0;
+		pthread_sigmask( SIG_SETMASK, &old, NULL );
+	}
+#endif
+	return 0;
+}
+
+/**********************************************************************/
+/** queue one sample (called from signal handler)
+ */
+void CAP_Push( u_int32 seq, u_int32 irqLat, u_int32 sigLat )
+{
+	M99CAP_SAMPLE *s;
+	u_int32 head = G_head;
+
+	if( G_fp == NULL )
+		return;
+
+	if( head - G_tail >= CAP_RING_SIZE ){
+		G_ringDropped++;
+		return;
+	}
+
+	s = &G_ring[head & (CAP_RING_SIZE-1)];
+	s->seq    = seq;
+	s->irqLat = irqLat;
+	s->sigLat = sigLat;
+	s->tsUs   = HostTimeUs() - G_t0;
+
+	CAP_BARRIER();
+	G_head = head + 1;
+}
+
+/**********************************************************************/
+/** drain ring from main loop if there is no writer thread
+ */
+void CAP_Poll( void )
+{
+	if( G_fp != NULL && !G_threaded )
+		Drain();
+}
+
+/**********************************************************************/
+/** stop writer, flush remaining samples and close file
+ */
+void CAP_Stop( void )
+{
+	u_int8 p[1+2*M99CAP_VARINT_MAX];
+	int n;
+
+	if( G_fp == NULL )
+		return;
+
+	G_run = 0;
+#ifdef LINUX
+	if( G_threaded )
+		pthread_join( G_thread, NULL );
+	G_threaded = 0;
+#endif
+	Drain();
+	FlushBlock();
+
+	p[0] = M99CAP_TAG_END;
+	n = 1 + M99CAP_PutVarint( &p[1], G_written );
+	n += M99CAP_PutVarint( &p[n], G_ringDropped + G_ioDropped );
+	if( !G_ioError )
+		fwrite( p, 1, n, G_fp );
+	fclose( G_fp );
+	G_fp = NULL;
+
+	printf("capture: %u samples written, %u dropped\n",
+		   (unsigned)G_written, (unsigned)(G_ringDropped + G_ioDropped) );
+}
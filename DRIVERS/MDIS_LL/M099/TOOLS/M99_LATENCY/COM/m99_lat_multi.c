@@ -0,0 +1,388 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_multi.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Latency measurement of several M99 devices in one run
+ *
+ *               All devices get the same timer value and run at the
+ *               same time, so interference between the interrupt sources
+ *               shows up in the latencies. Each device sends its own
+ *               signal (SIGRTMIN+n on Linux, queued; UOS_SIG_USR2/USR1
+ *               elsewhere), the handler dispatches by signal code.
+ *
+ *               Per interval one line per device and an aggregate line
+ *               are printed. The skew column is the offset of a device's
+ *               timer expiry to the last expiry of the first device,
+ *               folded into +-period/2. The host time of an expiry is
+ *               estimated as handler time minus signal latency. With a
+ *               common timer value the skew moves slowly with the
+ *               oscillator drift of the modules. Jitter mode of a
+ *               device makes the skew meaningless.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#ifdef LINUX
+# include <signal.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_oss.h>
+#include <MEN/m99_drv.h>
+#include "m99_lat.h"
+
+#define CHK(expr) \
+ if(!(expr)){ \
+	printf("*** Expression %s at line %d failed (%s)\n", \
+    #expr, __LINE__, M_errstring(UOS_ErrnoGet() )); \
+    goto ABORT;\
+ }
+
+/* expiry skew to the first device [us] */
+typedef struct {
+	int32   min;
+	int32   max;
+	double  sum;
+	u_int32 count;
+} SKEW;
+
+typedef struct {
+	const char *name;
+	MDIS_PATH  path;
+	u_int32    signo;			/* signal of this device */
+	int        started;			/* signals set in driver */
+	/* two interval buffers, the handler fills [cur] */
+	STATS      irq[2], sig[2];
+	SKEW       skew[2];
+	volatile int cur;
+	u_int32    handled;			/* signals handled so far */
+	u_int64    expUs;			/* host time of last timer expiry */
+	int        haveExp;
+	/* whole run, main loop only */
+	SIG_LOSS   loss;			/* signals lost, from driver counters */
+	STATS      irqTot, sigTot;
+	SKEW       skewTot;
+} LAT_DEV;
+
+static LAT_DEV G_dev[MULTI_MAX_DEV];
+static int G_nDev;
+static int64 G_periodUs;
+
+static STATS G_irqAll, G_sigAll;
+
+/* signal of device i */
+static u_int32 DevSignal( int i )
+{
+#ifdef LINUX
+	return SIGRTMIN + i;
+#else
+	return i == 0 ? UOS_SIG_USR2 : UOS_SIG_USR1;
+#endif
+}
+
+static void SkewInit( SKEW *sk )
+{
+	sk->min   = 0x7fffffff;
+	sk->max   = -0x7fffffff;
+	sk->sum   = 0;
+	sk->count = 0;
+}
+
+static void SkewAdd( SKEW *sk, int32 us )
+{
+	if( us < sk->min )
+		sk->min = us;
+	if( us > sk->max )
+		sk->max = us;
+	sk->sum += us;
+	sk->count++;
+}
+
+static void SkewMerge( SKEW *dst, const SKEW *src )
+{
+	if( !src->count )
+		return;
+	if( src->min < dst->min )
+		dst->min = src->min;
+	if( src->max > dst->max )
+		dst->max = src->max;
+	dst->sum   += src->sum;
+	dst->count += src->count;
+}
+
+/* offset of expiry to reference expiry, folded into +-period/2 */
+static int32 SkewFold( u_int64 expUs, u_int64 refUs )
+{
+	int64 d = (int64)(expUs - refUs) % G_periodUs;
+
+	if( d < 0 )
+		d += G_periodUs;
+	if( d >= (G_periodUs + 1) / 2 )
+		d -= G_periodUs;
+	return (int32)d;
+}
+
+static void MergeStats( STATS *dst, const STATS *src )
+{
+	int32 i;
+
+	if( !src->count )
+		return;
+	if( src->min < dst->min )
+		dst->min = src->min;
+	if( src->max > dst->max )
+		dst->max = src->max;
+	dst->avgAcc += src->avgAcc;
+	dst->count  += src->count;
+	for( i=0; i<STATS_HIST_SIZE; i++ )
+		dst->hist[i] += src->hist[i];
+}
+
+static void __MAPILIB MultiSigHandler( u_int32 sigCode )
+{
+	LAT_DEV *dev;
+	int32 tval=0, irqLat=0;
+	u_int64 now;
+	int i;
+
+	for( i=0; i<G_nDev; i++ )
+		if( G_dev[i].signo == sigCode )
+			break;
+	if( i == G_nDev )
+		return;
+	dev = &G_dev[i];
+
+	M_getstat( dev->path, M99_GET_TIME, &tval );
+	now = HostTimeUs();
+	M_getstat( dev->path, M99_IRQ_LAT, &irqLat );
+
+	UpdateStats( &dev->irq[dev->cur], irqLat );
+	UpdateStats( &dev->sig[dev->cur], tval );
+	dev->handled++;
+
+	dev->expUs   = now - TICKS2US(tval);
+	dev->haveExp = 1;
+	if( i > 0 && G_dev[0].haveExp )
+		SkewAdd( &dev->skew[dev->cur],
+				 SkewFold( dev->expUs, G_dev[0].expUs ));
+}
+
+/* print one table line, NULL skew prints no skew */
+static void PrintLine( const char *name, const STATS *irq, const STATS *sig,
+					   u_int32 lost, const SKEW *sk )
+{
+	printf("%-12.12s | ", name );
+	PrintStats( irq );
+	printf(" | ");
+	PrintStats( sig );
+	printf(" | %6u", (unsigned)lost );
+	if( sk && sk->count )
+		printf(" | %6d %8.1f %6d\n", (int)sk->min, sk->sum / sk->count,
+			   (int)sk->max );
+	else
+		printf(" |      -        -      -\n");
+}
+
+/* print whole run totals of one device */
+static void PrintTotal( const char *name, const STATS *irq, const STATS *sig,
+						u_int32 lost, u_int32 handled, const SKEW *sk )
+{
+	printf("%-12.12s   irq %d/%.1f/%d  sig %d/%.1f/%d [us]  lost %u of %u",
+		   name,
+		   irq->count ? (int)TICKS2US(irq->min) : 0,
+		   irq->count ? (double)TICKS2US(irq->avgAcc) / irq->count : 0.0,
+		   (int)TICKS2US(irq->max),
+		   sig->count ? (int)TICKS2US(sig->min) : 0,
+		   sig->count ? (double)TICKS2US(sig->avgAcc) / sig->count : 0.0,
+		   (int)TICKS2US(sig->max),
+		   (unsigned)lost, (unsigned)(handled + lost) );
+	if( sk && sk->count )
+		printf("  skew %d..%d [us]", (int)sk->min, (int)sk->max );
+	printf("\n");
+}
+
+/**********************************************************************/
+/** measure several devices until key pressed
+ *
+ *  \param device	device names
+ *  \param nDev		number of devices, 2..MULTI_MAX_DEV
+ *  \param timerval	timer value of all devices
+ *  \param interval	report interval [s]
+ *
+ *  \return 0 | 1 on error
+ */
+int MULTI_Run( char **device, int nDev, int32 timerval, int interval )
+{
+	LAT_DEV *dev;
+	STATS *irq, *sig;
+	SKEW *skew;
+	u_int32 lost[MULTI_MAX_DEV];
+	u_int32 allLost, allHandled;
+	int i, j, rv = 1;
+
+#ifndef LINUX
+	if( nDev > 2 ){
+		printf("*** max. 2 devices (one signal each) on this OS\n");
+		return 1;
+	}
+#endif
+	if( nDev > MULTI_MAX_DEV ){
+		printf("*** max. %d devices\n", MULTI_MAX_DEV );
+		return 1;
+	}
+
+	G_nDev     = 0;
+	G_periodUs = TICKS2US((int64)timerval);
+	CHK( UOS_SigInit( MultiSigHandler ) == 0 );
+
+	for( i=0; i<nDev; i++ ){
+		dev = &G_dev[i];
+		memset( dev, 0, sizeof(*dev) );
+		dev->name = device[i];
+		dev->signo = DevSignal( i );
+		for( j=0; j<2; j++ ){
+			InitStats( &dev->irq[j] );
+			InitStats( &dev->sig[j] );
+			SkewInit( &dev->skew[j] );
+		}
+		InitStats( &dev->irqTot );
+		InitStats( &dev->sigTot );
+		dev->irq[0].first = 3;
+		dev->sig[0].first = 3;
+		SkewInit( &dev->skewTot );
+
+		if( (dev->path = M_open( device[i] )) < 0 ){
+			printf("*** can't open %s: %s\n", device[i],
+				   M_errstring(UOS_ErrnoGet()) );
+			goto ABORT;
+		}
+		G_nDev++;
+		CHK( UOS_SigInstall( dev->signo ) == 0 );
+	}
+
+	/* start all devices, same timer value */
+	for( i=0; i<nDev; i++ ){
+		dev = &G_dev[i];
+		dev->started = 1;
+		if( DrvStart( dev->path, timerval, dev->signo )){
+			/* driver without M99_BLK_CONFIG */
+			CHK( M_setstat(dev->path,M99_SIG_set_cond1, dev->signo ) == 0 );
+			CHK( M_setstat(dev->path,M99_SIG_set_cond2, dev->signo ) == 0 );
+			CHK( M_setstat(dev->path,M99_SIG_set_cond3, dev->signo ) == 0 );
+			CHK( M_setstat(dev->path,M99_SIG_set_cond4, dev->signo ) == 0 );
+			CHK( M_setstat(dev->path,M99_TIMERVAL,timerval) == 0 );
+		}
+		CHK( M_setstat(dev->path,M_MK_IRQ_ENABLE,1) == 0 );
+	}
+
+	printf("generating interrupts on %d devices: timerval=%d\n", nDev,
+		   timerval );
+	printf("(press any key for exit)\n");
+	printf("             |          Interrupt-Latency          |"
+		   "            Signal-Latency          |        |"
+		   "  expiry skew to %s\n", G_dev[0].name );
+	printf("device       |  min[us]  avg[us]  max[us]  (irq/s) |"
+		   "  min[us]  avg[us]  max[us]  (sigs/s) |   lost |"
+		   "    min      avg    max [us]\n");
+
+	while( UOS_KeyPressed() == -1 ){
+
+		UOS_Delay( interval * 1000 );
+
+		/* only switch buffers masked, no histogram copies */
+		UOS_SigMask();
+		for( i=0; i<nDev; i++ ){
+			dev = &G_dev[i];
+			dev->cur ^= 1;
+			lost[i] = SigLost( dev->path, dev->handled, 0, &dev->loss );
+		}
+		UOS_SigUnMask();
+
+		InitStats( &G_irqAll );
+		InitStats( &G_sigAll );
+		allLost = 0;
+		for( i=0; i<nDev; i++ ){
+			dev  = &G_dev[i];
+			irq  = &dev->irq[dev->cur ^ 1];
+			sig  = &dev->sig[dev->cur ^ 1];
+			skew = &dev->skew[dev->cur ^ 1];
+			PrintLine( dev->name, irq, sig, lost[i], i ? skew : NULL );
+			allLost += lost[i];
+
+			MergeStats( &G_irqAll, irq );
+			MergeStats( &G_sigAll, sig );
+			MergeStats( &dev->irqTot, irq );
+			MergeStats( &dev->sigTot, sig );
+			SkewMerge( &dev->skewTot, skew );
+
+			/* free for the handler after the next switch */
+			InitStats( irq );
+			InitStats( sig );
+			SkewInit( skew );
+		}
+		PrintLine( "all", &G_irqAll, &G_sigAll, allLost, NULL );
+		printf("\n");
+	}
+	rv = 0;
+
+ ABORT:
+	for( i=0; i<G_nDev; i++ ){
+		dev = &G_dev[i];
+		if( dev->started ){
+			M_setstat(dev->path, M99_SIG_clr_cond1, dev->signo );
+			M_setstat(dev->path, M99_SIG_clr_cond2, dev->signo );
+			M_setstat(dev->path, M99_SIG_clr_cond3, dev->signo );
+			M_setstat(dev->path, M99_SIG_clr_cond4, dev->signo );
+		}
+	}
+	UOS_Delay( 10 );			/* deliver pending signals */
+	for( i=0; i<G_nDev; i++ ){
+		dev = &G_dev[i];
+		if( dev->started )
+			SigLost( dev->path, dev->handled, 1, &dev->loss );
+		UOS_SigRemove( dev->signo );
+	}
+	UOS_SigExit();
+
+	InitStats( &G_irqAll );
+	InitStats( &G_sigAll );
+	allLost = allHandled = 0;
+	for( i=0; i<G_nDev; i++ ){
+		dev = &G_dev[i];
+		M_close( dev->path );
+		if( rv )
+			continue;
+		PrintTotal( dev->name, &dev->irqTot, &dev->sigTot, dev->loss.lost,
+					dev->handled, i ? &dev->skewTot : NULL );
+		MergeStats( &G_irqAll, &dev->irqTot );
+		MergeStats( &G_sigAll, &dev->sigTot );
+		allLost    += dev->loss.lost;
+		allHandled += dev->handled;
+	}
+	if( !rv )
+		PrintTotal( "all", &G_irqAll, &G_sigAll, allLost, allHandled, NULL );
+	return rv;
+}
@@ -0,0 +1,333 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_out.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Machine readable interval records of m99_latency
+ *
+ *               One record per report interval, either as CSV (header
+ *               line first) or as JSON lines. Each record is flushed
+ *               immediately so consumers can follow the file live.
+ *               All latencies are in us.
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+static FILE *G_fp;
+static int G_fmt;
+static RUN_CFG G_cfg;
+
+/* percentiles reported per interval */
+static const struct {
+	const char *name;
+	double q;
+} G_pct[] = {
+	{ "p50", 0.50 },
+	{ "p90", 0.90 },
+	{ "p99", 0.99 },
+	{ "p999", 0.999 }
+};
+#define NUM_PCT	(sizeof(G_pct)/sizeof(G_pct[0]))
+
+/**********************************************************************/
+/** open record output
+ *
+ *  \param fmt		"csv" or "json"
+ *  \param file		output file, NULL or "-" for stdout
+ *  \param cfg		run configuration (copied)
+ *
+ *  \return 0 | -1 on error
+ */
+int OUT_Open( const char *fmt, const char *file, const RUN_CFG *cfg )
+{
+	if( !strcmp( fmt, "csv" ))
+		G_fmt = OUT_FMT_CSV;
+	else if( !strcmp( fmt, "json" ))
+		G_fmt = OUT_FMT_JSON;
+	else {
+		printf("*** unknown output format %s\n", fmt );
+		return -1;
+	}
+
+	if( file == NULL || !strcmp( file, "-" ))
+		G_fp = stdout;
+	else if( (G_fp = fopen( file, "a" )) == NULL ){
+		printf("*** can't open output file %s\n", file );
+		return -1;
+	}
+
+	G_cfg = *cfg;
+
+	if( G_fmt == OUT_FMT_CSV ){
+		unsigned i;
+		const char *what[] = { "irq", "sig", "swt", "poll" };
+		int w;
+
+		fprintf( G_fp, "interval,time,device,timerval,interval_s" );
+		for( w=0; w<4; w++ ){
+			if( (w == 2 && !G_cfg.swt) || (w == 3 && !G_cfg.poll) )
+				continue;
+			fprintf( G_fp, ",%s_min,%s_avg,%s_max", what[w], what[w],
+					 what[w] );
+			for( i=0; i<NUM_PCT; i++ )
+				fprintf( G_fp, ",%s_%s", what[w], G_pct[i].name );
+			fprintf( G_fp, ",%s_count", what[w] );
+		}
+		if( G_cfg.poll )
+			fprintf( G_fp, ",polls,poll_ns_min,poll_ns_avg,poll_ns_max"
+					 ",poll_missed" );
+		if( G_cfg.sys )
+			fprintf( G_fp, ",sys_irqs,sys_softirqs,sys_ctxt,sys_faults"
+					 ",sys_majfaults,sys_rqwait_us,sys_running,spike_us" );
+		if( G_cfg.pmu ){
+			fprintf( G_fp, ",pmu_samples,pmu_outliers" );
+			for( i=0; i<PMU_NUM; i++ )
+				fprintf( G_fp, ",pmu_%s,pmu_%s_outl", PMU_Name[i],
+						 PMU_Name[i] );
+		}
+		fprintf( G_fp, ",irqs,overruns,sig_lost,sig_loss_ratio"
+				 ",drv_count,drv_min,drv_avg,drv_max,drv_overruns\n" );
+		fflush( G_fp );
+	}
+	return 0;
+}
+
+/**********************************************************************/
+/** check if records replace the legacy table on stdout
+ */
+int OUT_ToStdout( void )
+{
+	return G_fp == stdout;
+}
+
+static void CsvStats( const STATS *st )
+{
+	unsigned i;
+
+	if( !st->count ){
+		fprintf( G_fp, ",,," );
+		for( i=0; i<NUM_PCT; i++ )
+			fprintf( G_fp, "," );
+		fprintf( G_fp, ",0" );
+		return;
+	}
+
+	fprintf( G_fp, ",%d,%.1f,%d", (int)TICKS2US(st->min),
+			 (double)TICKS2US(st->avgAcc) / st->count,
+			 (int)TICKS2US(st->max) );
+	for( i=0; i<NUM_PCT; i++ )
+		fprintf( G_fp, ",%d",
+				 (int)TICKS2US(StatsPercentile( st, G_pct[i].q )) );
+	fprintf( G_fp, ",%d", (int)st->count );
+}
+
+static void JsonStats( const char *name, const STATS *st )
+{
+	unsigned i;
+
+	fprintf( G_fp, ",\"%s\":{\"count\":%d", name, (int)st->count );
+	if( st->count ){
+		fprintf( G_fp, ",\"min\":%d,\"avg\":%.1f,\"max\":%d",
+				 (int)TICKS2US(st->min),
+				 (double)TICKS2US(st->avgAcc) / st->count,
+				 (int)TICKS2US(st->max) );
+		for( i=0; i<NUM_PCT; i++ )
+			fprintf( G_fp, ",\"%s\":%d", G_pct[i].name,
+					 (int)TICKS2US(StatsPercentile( st, G_pct[i].q )) );
+	}
+	fprintf( G_fp, "}" );
+}
+
+/* lost signals relative to all signals sent */
+static double LossRatio( const INTERVAL *iv )
+{
+	u_int32 sent = iv->sigHandled + iv->sigLost;
+
+	return sent ? (double)iv->sigLost / sent : 0.0;
+}
+
+/* print string as JSON string literal */
+static void JsonString( const char *str )
+{
+	fputc( '"', G_fp );
+	for( ; *str; str++ ){
+		if( *str == '"' || *str == '\\' )
+			fputc( '\\', G_fp );
+		if( (unsigned char)*str >= 0x20 )
+			fputc( *str, G_fp );
+	}
+	fputc( '"', G_fp );
+}
+
+/**********************************************************************/
+/** emit record of one interval
+ */
+void OUT_Record( const INTERVAL *iv )
+{
+	unsigned long now = (unsigned long)time( NULL );
+	int i;
+
+	if( G_fp == NULL )
+		return;
+
+	if( G_fmt == OUT_FMT_CSV ){
+		fprintf( G_fp, "%u,%lu,%s,%d,%d", (unsigned)iv->no, now,
+				 G_cfg.device, (int)G_cfg.timerval, G_cfg.interval );
+		CsvStats( iv->irq );
+		CsvStats( iv->sig );
+		if( G_cfg.swt )
+			CsvStats( iv->swt );
+		if( G_cfg.poll ){
+			const POLL_COST *pc = iv->pollCost;
+
+			CsvStats( iv->poll );
+			if( pc->polls )
+				fprintf( G_fp, ",%u,%u,%.1f,%u,%u", (unsigned)pc->polls,
+						 (unsigned)pc->nsMin, (double)pc->nsSum / pc->polls,
+						 (unsigned)pc->nsMax, (unsigned)pc->missed );
+			else
+				fprintf( G_fp, ",0,,,,0" );
+		}
+		if( G_cfg.sys ){
+			const SYS_IV *sy = iv->sys;
+
+			fprintf( G_fp, ",%llu,%llu,%llu,%llu,%llu,%llu,%u,%d",
+					 (unsigned long long)sy->irqs,
+					 (unsigned long long)sy->softirqs,
+					 (unsigned long long)sy->ctxt,
+					 (unsigned long long)sy->faults,
+					 (unsigned long long)sy->majFaults,
+					 (unsigned long long)sy->rqWaitUs,
+					 (unsigned)sy->running, (int)iv->spikeUs );
+		}
+		if( G_cfg.pmu ){
+			const PMU_IV *pm = iv->pmu;
+
+			fprintf( G_fp, ",%u,%u", (unsigned)pm->samples,
+					 (unsigned)pm->outliers );
+			for( i=0; i<PMU_NUM; i++ )
+				if( pm->valid & (1 << i) )
+					fprintf( G_fp, ",%llu,%llu",
+							 (unsigned long long)pm->sum[i],
+							 (unsigned long long)pm->outSum[i] );
+				else
+					fprintf( G_fp, ",," );
+		}
+		fprintf( G_fp, ",%u,%u,%u,%.6f", (unsigned)iv->irqs,
+				 (unsigned)iv->overruns, (unsigned)iv->sigLost,
+				 LossRatio( iv ));
+		if( iv->drvValid && iv->drvCount )
+			fprintf( G_fp, ",%u,%d,%.1f,%d,%u\n", (unsigned)iv->drvCount,
+					 (int)TICKS2US(iv->drvMin),
+					 (double)TICKS2US(iv->drvSum) / iv->drvCount,
+					 (int)TICKS2US(iv->drvMax), (unsigned)iv->drvOverruns );
+		else if( iv->drvValid )
+			fprintf( G_fp, ",0,,,,0\n" );
+		else
+			fprintf( G_fp, ",,,,,\n" );
+	}
+	else {
+		fprintf( G_fp, "{\"interval\":%u,\"time\":%lu,\"config\":{"
+				 "\"device\":", (unsigned)iv->no, now );
+		JsonString( G_cfg.device );
+		fprintf( G_fp, ",\"timerval\":%d,\"timer_us\":%d,\"interval_s\":%d}",
+				 (int)G_cfg.timerval, (int)TICKS2US(G_cfg.timerval),
+				 G_cfg.interval );
+		JsonStats( "irq", iv->irq );
+		JsonStats( "sig", iv->sig );
+		if( iv->swt )
+			JsonStats( "swt", iv->swt );
+		if( iv->poll ){
+			const POLL_COST *pc = iv->pollCost;
+
+			JsonStats( "poll", iv->poll );
+			fprintf( G_fp, ",\"poll_cost\":{\"polls\":%u,\"missed\":%u",
+					 (unsigned)pc->polls, (unsigned)pc->missed );
+			if( pc->polls )
+				fprintf( G_fp, ",\"ns_min\":%u,\"ns_avg\":%.1f,\"ns_max\":%u",
+						 (unsigned)pc->nsMin, (double)pc->nsSum / pc->polls,
+						 (unsigned)pc->nsMax );
+			fprintf( G_fp, "}" );
+		}
+		if( iv->sys && iv->sys->valid ){
+			const SYS_IV *sy = iv->sys;
+
+			fprintf( G_fp, ",\"sys\":{\"irqs\":%llu,\"softirqs\":%llu,"
+					 "\"ctxt\":%llu,\"faults\":%llu,\"majfaults\":%llu,"
+					 "\"rqwait_us\":%llu,\"running\":%u}",
+					 (unsigned long long)sy->irqs,
+					 (unsigned long long)sy->softirqs,
+					 (unsigned long long)sy->ctxt,
+					 (unsigned long long)sy->faults,
+					 (unsigned long long)sy->majFaults,
+					 (unsigned long long)sy->rqWaitUs,
+					 (unsigned)sy->running );
+			if( iv->spikeUs )
+				fprintf( G_fp, ",\"spike_us\":%d", (int)iv->spikeUs );
+		}
+		if( iv->pmu && iv->pmu->valid ){
+			const PMU_IV *pm = iv->pmu;
+
+			fprintf( G_fp, ",\"pmu\":{\"samples\":%u,\"outliers\":%u",
+					 (unsigned)pm->samples, (unsigned)pm->outliers );
+			for( i=0; i<PMU_NUM; i++ )
+				if( pm->valid & (1 << i) )
+					fprintf( G_fp, ",\"%s\":[%llu,%llu]", PMU_Name[i],
+							 (unsigned long long)pm->sum[i],
+							 (unsigned long long)pm->outSum[i] );
+			fprintf( G_fp, "}" );
+		}
+		fprintf( G_fp, ",\"irqs\":%u,\"overruns\":%u,\"sig_lost\":%u,"
+				 "\"sig_loss_ratio\":%.6f",
+				 (unsigned)iv->irqs, (unsigned)iv->overruns,
+				 (unsigned)iv->sigLost, LossRatio( iv ));
+		if( iv->drvValid ){
+			fprintf( G_fp, ",\"drv\":{\"count\":%u", (unsigned)iv->drvCount );
+			if( iv->drvCount )
+				fprintf( G_fp, ",\"min\":%d,\"avg\":%.1f,\"max\":%d",
+						 (int)TICKS2US(iv->drvMin),
+						 (double)TICKS2US(iv->drvSum) / iv->drvCount,
+						 (int)TICKS2US(iv->drvMax) );
+			fprintf( G_fp, ",\"overruns\":%u}", (unsigned)iv->drvOverruns );
+		}
+		fprintf( G_fp, "}\n" );
+	}
+	fflush( G_fp );
+}
+
+/**********************************************************************/
+/** close record output
+ */
+void OUT_Close( void )
+{
+	if( G_fp != NULL && G_fp != stdout )
+		fclose( G_fp );
+	G_fp = NULL;
+}
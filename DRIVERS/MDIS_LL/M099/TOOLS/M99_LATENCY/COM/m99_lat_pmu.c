@@ -0,0 +1,300 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_pmu.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  perf_event counters of the signal receiver of m99_latency
+ *
+ *               Counts cycles and cache misses (hardware PMU) and context
+ *               switches, cpu migrations and page faults (kernel software
+ *               counters) of the receiving thread. The counters are read
+ *               by the signal handler for every sample, the delta since
+ *               the previous sample is charged to the sample and summed
+ *               separately for normal and outlier samples (signal latency
+ *               above a threshold).
+ *
+ *               Hardware and software counters are two perf groups, so
+ *               one read() each per sample. Without PMU (VMs, missing
+ *               driver, perf_event_paranoid) only the software group is
+ *               used.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#ifdef LINUX
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+const char *PMU_Name[PMU_NUM] = {
+	"cycles", "cache-misses", "ctx-switches", "migrations", "page-faults"
+};
+
+#ifdef LINUX
+/* one perf group, counters in read order */
+typedef struct {
+	int fd;					/* leader, -1: not open */
+	int n;
+	int fds[PMU_NUM];		/* all members, leader first */
+	int idx[PMU_NUM];		/* PMU_xxx of each member */
+} PMU_GRP;
+
+static PMU_GRP G_grp[2];
+static u_int32 G_valid;
+static u_int64 G_prev[PMU_NUM];
+static int G_havePrev;
+static PMU_IV G_iv, G_tot;
+
+static int Open( u_int32 type, u_int64 config, int group )
+{
+	struct perf_event_attr pe;
+	int fd;
+
+	memset( &pe, 0, sizeof(pe) );
+	pe.type        = type;
+	pe.size        = sizeof(pe);
+	pe.config      = config;
+	pe.read_format = PERF_FORMAT_GROUP;
+
+	fd = (int)syscall( __NR_perf_event_open, &pe, 0, -1, group, 0 );
+	if( fd < 0 ){
+		/* perf_event_paranoid: user space only */
+		pe.exclude_kernel = 1;
+		pe.exclude_hv     = 1;
+		fd = (int)syscall( __NR_perf_event_open, &pe, 0, -1, group, 0 );
+	}
+	return fd;
+}
+
+/* open leader and members, members that fail are left out */
+static void OpenGroup( PMU_GRP *g, u_int32 type, const u_int64 *config,
+					   const int *idx, int n )
+{
+	int i, fd;
+
+	g->n  = 0;
+	g->fd = -1;
+	for( i=0; i<n; i++ ){
+		fd = Open( type, config[i], g->fd );
+		if( fd < 0 ){
+			if( g->fd < 0 )
+				return;			/* no leader, no group */
+			continue;
+		}
+		if( g->fd < 0 )
+			g->fd = fd;
+		g->fds[g->n]   = fd;
+		g->idx[g->n++] = idx[i];
+		G_valid |= 1 << idx[i];
+	}
+}
+
+static void ReadAll( u_int64 *val )
+{
+	u_int64 buf[1 + PMU_NUM];
+	int g, i;
+
+	for( g=0; g<2; g++ ){
+		if( G_grp[g].fd < 0 )
+			continue;
+		if( read( G_grp[g].fd, buf, sizeof(buf) ) < (ssize_t)sizeof(u_int64) )
+			continue;
+		for( i=0; i<G_grp[g].n && i < (int)buf[0]; i++ )
+			val[G_grp[g].idx[i]] = buf[1 + i];
+	}
+}
+
+static void IvAdd( PMU_IV *dst, const PMU_IV *src )
+{
+	int i;
+
+	for( i=0; i<PMU_NUM; i++ ){
+		dst->sum[i]    += src->sum[i];
+		dst->outSum[i] += src->outSum[i];
+	}
+	dst->samples  += src->samples;
+	dst->outliers += src->outliers;
+}
+#endif /* LINUX */
+
+/**********************************************************************/
+/** open counters for the calling (receiving) thread
+ *
+ *  \return 0 | -1 if no counter at all
+ */
+int PMU_Start( void )
+{
+#ifdef LINUX
+	static const u_int64 hwCfg[] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES };
+	static const int hwIdx[] = { PMU_CYCLES, PMU_CACHEMISS };
+	static const u_int64 swCfg[] = {
+		PERF_COUNT_SW_CONTEXT_SWITCHES, PERF_COUNT_SW_CPU_MIGRATIONS,
+		PERF_COUNT_SW_PAGE_FAULTS };
+	static const int swIdx[] = { PMU_CTXSW, PMU_MIGR, PMU_FAULTS };
+
+	G_valid = 0;
+	OpenGroup( &G_grp[0], PERF_TYPE_HARDWARE, hwCfg, hwIdx, 2 );
+	OpenGroup( &G_grp[1], PERF_TYPE_SOFTWARE, swCfg, swIdx, 3 );
+	if( !G_valid ){
+		printf("*** perf_event_open failed, no counters\n");
+		return -1;
+	}
+	if( G_grp[0].fd < 0 )
+		printf("no hardware PMU, software counters only\n");
+
+	memset( &G_iv, 0, sizeof(G_iv) );
+	memset( &G_tot, 0, sizeof(G_tot) );
+	G_havePrev = 0;
+	return 0;
+#else
+	printf("*** perf counters only supported on Linux\n");
+	return -1;
+#endif
+}
+
+/**********************************************************************/
+/** charge counters since the last sample to this sample
+ *
+ *  Called from the signal handler.
+ *
+ *  \param outlier	sample latency above threshold
+ */
+void PMU_Sample( int outlier )
+{
+#ifdef LINUX
+	u_int64 cur[PMU_NUM];
+	int i;
+
+	if( !G_valid )
+		return;
+
+	memcpy( cur, G_prev, sizeof(cur) );
+	ReadAll( cur );
+	if( G_havePrev ){
+		for( i=0; i<PMU_NUM; i++ ){
+			u_int64 d = cur[i] - G_prev[i];
+
+			G_iv.sum[i] += d;
+			if( outlier )
+				G_iv.outSum[i] += d;
+		}
+		G_iv.samples++;
+		if( outlier )
+			G_iv.outliers++;
+	}
+	memcpy( G_prev, cur, sizeof(cur) );
+	G_havePrev = 1;
+#else
+	(void)outlier;
+#endif
+}
+
+/**********************************************************************/
+/** get counters of the current interval, start the next one
+ *
+ *  Call with signals masked.
+ */
+void PMU_Take( PMU_IV *iv )
+{
+#ifdef LINUX
+	*iv = G_iv;
+	iv->valid = G_valid;
+	IvAdd( &G_tot, &G_iv );
+	memset( &G_iv, 0, sizeof(G_iv) );
+#else
+	memset( iv, 0, sizeof(*iv) );
+#endif
+}
+
+/**********************************************************************/
+/** print per sample averages of normal and outlier samples
+ *
+ *  \param fp		output
+ *  \param what		line prefix
+ *  \param iv		counters, NULL for the whole run
+ */
+void PMU_Print( FILE *fp, const char *what, const PMU_IV *iv )
+{
+#ifdef LINUX
+	u_int32 nNorm;
+	int i;
+
+	if( iv == NULL ){
+		iv = &G_tot;
+		fprintf( fp, "PMU: %u samples, %u outliers\n",
+				 (unsigned)iv->samples, (unsigned)iv->outliers );
+		fprintf( fp, "PMU: per sample      %12s %12s %7s\n",
+				 "normal", "outlier", "ratio" );
+	}
+	nNorm = iv->samples - iv->outliers;
+
+	for( i=0; i<PMU_NUM; i++ ){
+		double n, o;
+
+		if( !(G_valid & (1 << i)) )
+			continue;
+		n = nNorm ? (double)(iv->sum[i] - iv->outSum[i]) / nNorm : 0.0;
+		o = iv->outliers ? (double)iv->outSum[i] / iv->outliers : 0.0;
+		if( what )
+			fprintf( fp, "%s %s %.4g/%.4g", what, PMU_Name[i], n, o );
+		else if( n > 0 && iv->outliers )
+			fprintf( fp, "PMU:  %-14s %12.1f %12.1f %7.2f\n", PMU_Name[i],
+					 n, o, o / n );
+		else
+			fprintf( fp, "PMU:  %-14s %12.1f %12.1f %7s\n", PMU_Name[i],
+					 n, o, "-" );
+		what = what ? "," : NULL;
+	}
+	if( what )
+		fprintf( fp, "\n" );
+#else
+	(void)fp;
+	(void)what;
+	(void)iv;
+#endif
+}
+
+/**********************************************************************/
+/** close counters
+ */
+void PMU_Stop( void )
+{
+#ifdef LINUX
+	int g, i;
+
+	for( g=0; g<2; g++ ){
+		for( i=G_grp[g].n-1; i>=0; i-- )
+			close( G_grp[g].fds[i] );
+		G_grp[g].n  = 0;
+		G_grp[g].fd = -1;
+	}
+	G_valid = 0;
+#endif
+}
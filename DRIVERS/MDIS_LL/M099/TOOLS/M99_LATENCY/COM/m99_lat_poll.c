@@ -0,0 +1,234 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_poll.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Busy polling detection thread of m99_latency
+ *
+ *               A thread pinned to one cpu spins on a driver getstat and
+ *               detects each timer expiry in user space, next to the
+ *               signal path on the same timer:
+ *
+ *               POLL_SRC_IRQCOUNT  polls M99_IRQCOUNT, on a change the
+ *                                  time since expiry is read with
+ *                                  M99_GET_TIME (one more getstat)
+ *               POLL_SRC_TIME      polls M99_GET_TIME, an expiry shows
+ *                                  as elapsed time going backwards
+ *
+ *               The detection latency (expiry to observation) goes into
+ *               STATS like the signal latency. Each poll is timed with
+ *               the host clock for the cost of one getstat.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#ifdef LINUX
+# include <time.h>
+# include <pthread.h>
+# include <sched.h>
+# include <signal.h>
+# include <unistd.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_oss.h>
+#include <MEN/m99_drv.h>
+#include "m99_lat.h"
+
+#ifdef LINUX
+static pthread_t G_thread;
+static pthread_mutex_t G_lock = PTHREAD_MUTEX_INITIALIZER;
+static STATS G_stats;
+static POLL_COST G_cost;
+static volatile int G_run;
+static MDIS_PATH G_ppath = -1;
+static int G_src, G_cpu;
+
+static u_int64 NowNs( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void ResetCost( POLL_COST *c )
+{
+	memset( c, 0, sizeof(*c) );
+	c->nsMin = 0xffffffff;
+}
+
+/* one timed getstat */
+static int32 Poll( int32 code, int32 *val, u_int32 *ns )
+{
+	u_int64 t0 = NowNs();
+	int32 rv;
+
+	rv = M_getstat( G_ppath, code, val );
+	*ns = (u_int32)(NowNs() - t0);
+	return rv;
+}
+
+static void *PollThread( void *arg )
+{
+	int32 val, last = -1, tval;
+	u_int32 ns, step;
+
+	(void)arg;
+	if( G_cpu >= 0 ){
+		cpu_set_t set;
+
+		CPU_ZERO( &set );
+		CPU_SET( G_cpu, &set );
+		pthread_setaffinity_np( pthread_self(), sizeof(set), &set );
+	}
+
+	while( G_run ){
+		if( Poll( G_src == POLL_SRC_TIME ? M99_GET_TIME : M99_IRQCOUNT,
+				  &val, &ns ))
+			break;
+
+		pthread_mutex_lock( &G_lock );
+		G_cost.polls++;
+		G_cost.nsSum += ns;
+		if( ns < G_cost.nsMin )
+			G_cost.nsMin = ns;
+		if( ns > G_cost.nsMax )
+			G_cost.nsMax = ns;
+
+		if( G_src == POLL_SRC_TIME ){
+			/* elapsed time restarts at each expiry */
+			if( last >= 0 && val < last ){
+				UpdateStats( &G_stats, val );
+				G_cost.detected++;
+			}
+		}
+		else if( last >= 0 && val != last ){
+			pthread_mutex_unlock( &G_lock );
+			if( M_getstat( G_ppath, M99_GET_TIME, &tval ))
+				break;
+			pthread_mutex_lock( &G_lock );
+			UpdateStats( &G_stats, tval );
+			G_cost.detected++;
+			step = (u_int32)(val - last);
+			if( step > 1 )
+				G_cost.missed += step - 1;
+		}
+		pthread_mutex_unlock( &G_lock );
+		last = val;
+	}
+	return NULL;
+}
+#endif /* LINUX */
+
+/**********************************************************************/
+/** start polling thread on its own path to \a device
+ *
+ *  \param device	M99 device, timer must be running with irq enabled
+ *  \param src		POLL_SRC_xxx
+ *  \param cpu		cpu to pin the thread to, -1: last online cpu
+ *
+ *  \return 0 | -1 on error
+ */
+int POLL_Start( const char *device, int src, int cpu )
+{
+#ifdef LINUX
+	sigset_t all, old;
+	int rv;
+
+	if( (G_ppath = M_open( device )) < 0 ){
+		printf("*** can't open %s for polling: %s\n", device,
+			   M_errstring(UOS_ErrnoGet()) );
+		return -1;
+	}
+
+	InitStats( &G_stats );
+	G_stats.first    = 3;
+	G_stats.totalMin = 0x7fffffff;
+	ResetCost( &G_cost );
+	G_src = src;
+	G_cpu = cpu >= 0 ? cpu : (int)sysconf( _SC_NPROCESSORS_ONLN ) - 1;
+	G_run = 1;
+
+	/* poller must never be the target of the measured signal */
+	sigfillset( &all );
+	pthread_sigmask( SIG_BLOCK, &all, &old );
+	rv = pthread_create( &G_thread, NULL, PollThread, NULL );
+	pthread_sigmask( SIG_SETMASK, &old, NULL );
+	if( rv ){
+		printf("*** can't start polling thread\n");
+		G_run = 0;
+		M_close( G_ppath );
+		G_ppath = -1;
+		return -1;
+	}
+	return 0;
+#else
+	(void)device;
+	(void)src;
+	(void)cpu;
+	printf("*** polling thread only supported on Linux\n");
+	return -1;
+#endif
+}
+
+/**********************************************************************/
+/** get stats and poll cost of the current interval, start the next one
+ */
+void POLL_Take( STATS *st, POLL_COST *cost )
+{
+#ifdef LINUX
+	int32 tmin, tmax;
+
+	pthread_mutex_lock( &G_lock );
+	*st   = G_stats;
+	*cost = G_cost;
+	tmin = G_stats.totalMin;
+	tmax = G_stats.totalMax;
+	InitStats( &G_stats );
+	G_stats.totalMin = tmin;
+	G_stats.totalMax = tmax;
+	ResetCost( &G_cost );
+	pthread_mutex_unlock( &G_lock );
+#else
+	InitStats( st );
+	memset( cost, 0, sizeof(*cost) );
+#endif
+}
+
+/**********************************************************************/
+/** stop polling thread
+ */
+void POLL_Stop( void )
+{
+#ifdef LINUX
+	if( G_ppath < 0 )
+		return;
+	G_run = 0;
+	pthread_join( G_thread, NULL );
+	M_close( G_ppath );
+	G_ppath = -1;
+#endif
+}
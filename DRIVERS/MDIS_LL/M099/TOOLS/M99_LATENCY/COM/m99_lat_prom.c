@@ -0,0 +1,234 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_prom.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Prometheus textfile exporter of m99_latency
+ *
+ *               For permanent monitoring. After every interval the file
+ *               <dir>/m99_latency_<device>.prom is rewritten with the
+ *               totals since start:
+ *
+ *               m99_irqs_total, m99_signals_total, m99_overruns_total,
+ *               m99_signals_lost_total          counters
+ *               m99_latency_seconds{path=...}   cumulative histogram of
+ *                                               irq, sig (swt, poll)
+ *
+ *               The file is written under a temporary name and renamed,
+ *               so a collector (e.g. node_exporter textfile collector)
+ *               never sees a partial file. No network code.
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+#define PROM_PATHS	4			/* irq, sig, swt, poll */
+
+/* histogram bucket upper bounds [us] */
+static const u_int32 G_le[] = {
+	10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000
+};
+#define NUM_LE	(sizeof(G_le)/sizeof(G_le[0]))
+
+/* run totals of one latency path */
+typedef struct {
+	u_int64 hist[STATS_HIST_SIZE];
+	u_int64 sum;			/* [ticks] */
+	u_int64 count;
+} PROM_HIST;
+
+static const char *G_pathName[PROM_PATHS] = { "irq", "sig", "swt", "poll" };
+static PROM_HIST G_hist[PROM_PATHS];
+static int G_on;
+static char G_file[512], G_tmp[520], G_dev[64];
+static RUN_CFG G_cfg;
+static u_int64 G_irqs, G_sigs, G_overruns, G_lost, G_intervals;
+static int G_err;
+
+static void Acc( int path, const STATS *st )
+{
+	PROM_HIST *h = &G_hist[path];
+	int i;
+
+	if( st == NULL )
+		return;
+	for( i=0; i<STATS_HIST_SIZE; i++ )
+		h->hist[i] += st->hist[i];
+	h->sum   += (u_int32)st->avgAcc;
+	h->count += (u_int32)st->count;
+}
+
+/* TYPE, HELP and sample under the same name, the text format needs it */
+static void Counter( FILE *fp, const char *name, const char *help,
+					 u_int64 val )
+{
+	fprintf( fp, "# TYPE %s_total counter\n# HELP %s_total %s\n", name,
+			 name, help );
+	fprintf( fp, "%s_total{device=\"%s\"} %llu\n", name, G_dev,
+			 (unsigned long long)val );
+}
+
+static void Histogram( FILE *fp, int path )
+{
+	const PROM_HIST *h = &G_hist[path];
+	u_int64 acc = 0;
+	u_int32 i, b = 0;
+
+	/* bucket b holds [b,b+1) ticks, last one all larger values: +Inf only */
+	for( i=0; i<NUM_LE; i++ ){
+		for( ; b < STATS_HIST_SIZE-1 && TICKS2US(b+1) <= G_le[i]; b++ )
+			acc += h->hist[b];
+		fprintf( fp, "m99_latency_seconds_bucket{device=\"%s\",path=\"%s\","
+				 "le=\"%g\"} %llu\n", G_dev, G_pathName[path],
+				 G_le[i] / 1e6, (unsigned long long)acc );
+	}
+	fprintf( fp, "m99_latency_seconds_bucket{device=\"%s\",path=\"%s\","
+			 "le=\"+Inf\"} %llu\n", G_dev, G_pathName[path],
+			 (unsigned long long)h->count );
+	fprintf( fp, "m99_latency_seconds_sum{device=\"%s\",path=\"%s\"} %g\n",
+			 G_dev, G_pathName[path], TICKS2US((double)h->sum) / 1e6 );
+	fprintf( fp, "m99_latency_seconds_count{device=\"%s\",path=\"%s\"} "
+			 "%llu\n", G_dev, G_pathName[path],
+			 (unsigned long long)h->count );
+}
+
+/* write all metrics to the temp file and move it over the old one */
+static int WriteFile( void )
+{
+	FILE *fp;
+	int p, rv;
+
+	if( (fp = fopen( G_tmp, "w" )) == NULL )
+		return -1;
+
+	Counter( fp, "m99_irqs", "timer interrupts counted by the driver",
+			 G_irqs );
+	Counter( fp, "m99_signals", "signals handled", G_sigs );
+	Counter( fp, "m99_overruns", "interrupts without handled signal",
+			 G_overruns );
+	Counter( fp, "m99_signals_lost", "signals sent but not handled",
+			 G_lost );
+	Counter( fp, "m99_intervals", "report intervals", G_intervals );
+
+	fprintf( fp, "# TYPE m99_timer_period_seconds gauge\n"
+			 "# HELP m99_timer_period_seconds M99 timer period\n"
+			 "m99_timer_period_seconds{device=\"%s\"} %g\n", G_dev,
+			 TICKS2US((double)G_cfg.timerval) / 1e6 );
+	fprintf( fp, "# TYPE m99_last_update_timestamp_seconds gauge\n"
+			 "# HELP m99_last_update_timestamp_seconds end of last "
+			 "interval\n"
+			 "m99_last_update_timestamp_seconds{device=\"%s\"} %lu\n",
+			 G_dev, (unsigned long)time( NULL ));
+
+	fprintf( fp, "# TYPE m99_latency_seconds histogram\n"
+			 "# HELP m99_latency_seconds latency from timer expiry\n" );
+	for( p=0; p<PROM_PATHS; p++ )
+		if( p < 2 || (p == 2 && G_cfg.swt) || (p == 3 && G_cfg.poll) )
+			Histogram( fp, p );
+	fprintf( fp, "# EOF\n" );
+
+	rv = ferror( fp );
+	if( fclose( fp ) || rv || rename( G_tmp, G_file )){
+		remove( G_tmp );
+		return -1;
+	}
+	return 0;
+}
+
+/**********************************************************************/
+/** start exporter
+ *
+ *  \param dir		directory of the textfile
+ *  \param cfg		run configuration (copied)
+ *
+ *  \return 0 | -1 if the file can't be written
+ */
+int PROM_Open( const char *dir, const RUN_CFG *cfg )
+{
+	char *p;
+
+	G_cfg = *cfg;
+	memset( G_hist, 0, sizeof(G_hist) );
+	G_irqs = G_sigs = G_overruns = G_lost = G_intervals = 0;
+	G_err = 0;
+
+	/* device name as label and file name part */
+	strncpy( G_dev, cfg->device, sizeof(G_dev)-1 );
+	for( p=G_dev; *p; p++ )
+		if( !isalnum( (unsigned char)*p ) && *p != '_' )
+			*p = '_';
+
+	sprintf( G_file, "%.400s/m99_latency_%s.prom", dir, G_dev );
+	/* collectors only read *.prom */
+	sprintf( G_tmp, "%s.tmp", G_file );
+
+	if( WriteFile() ){
+		printf("*** can't write %s\n", G_file );
+		return -1;
+	}
+	G_on = 1;
+	return 0;
+}
+
+/**********************************************************************/
+/** add interval to the totals and rewrite the textfile
+ */
+void PROM_Update( const INTERVAL *iv )
+{
+	if( !G_on )
+		return;
+
+	Acc( 0, iv->irq );
+	Acc( 1, iv->sig );
+	Acc( 2, iv->swt );
+	Acc( 3, iv->poll );
+	G_irqs     += iv->irqs;
+	G_sigs     += iv->sigHandled;
+	G_overruns += iv->overruns;
+	G_lost     += iv->sigLost;
+	G_intervals++;
+
+	/* keep measuring, report a failing disk only once */
+	if( WriteFile() ){
+		if( !G_err )
+			fprintf( stderr, "*** can't write %s\n", G_file );
+		G_err = 1;
+	}
+	else
+		G_err = 0;
+}
+
+/**********************************************************************/
+/** stop exporter, the last file stays in place
+ */
+void PROM_Close( void )
+{
+	G_on = 0;
+}
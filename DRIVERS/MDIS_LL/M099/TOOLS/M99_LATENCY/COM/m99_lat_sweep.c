@@ -0,0 +1,347 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_sweep.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  IRQ affinity / receiver cpu sweep of m99_latency
+ *
+ *               Moves the Linux irq of the M99 (/proc/irq/<n>/
+ *               smp_affinity_list) and the signal receiving process
+ *               (sched_setaffinity) over all pairs of online cpus. Each
+ *               placement is measured for a fixed time, the first
+ *               samples after a move are dropped. At the end a latency
+ *               matrix (rows: irq cpu, columns: receiver cpu) is printed
+ *               with the best and worst placement marked, judged by the
+ *               99th percentile of the signal latency.
+ *
+ *               Changing the irq affinity needs root. The original irq
+ *               and process affinity are restored at the end.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef LINUX
+# include <ctype.h>
+# include <sched.h>
+# include <unistd.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_oss.h>
+#include <MEN/m99_drv.h>
+#include "m99_lat.h"
+
+#ifdef LINUX
+
+#define CHK(expr) \
+ if(!(expr)){ \
+	printf("*** Expression %s at line %d failed (%s)\n", \
+    #expr, __LINE__, M_errstring(UOS_ErrnoGet() )); \
+    goto ABORT;\
+ }
+
+#define SWEEP_MAX_CPU	16
+
+/* result of one placement [us] */
+typedef struct {
+	u_int32 count;
+	double  irqAvg;
+	int32   irqMax;
+	double  sigAvg;
+	int32   sigP99;
+	int32   sigMax;
+} CELL;
+
+static MDIS_PATH G_spath;
+static STATS G_irq, G_sig;
+static CELL G_cell[SWEEP_MAX_CPU][SWEEP_MAX_CPU];
+
+static void __MAPILIB SweepSigHandler( u_int32 sigCode )
+{
+	int32 tval=0, irqLat=0;
+
+	if( sigCode != UOS_SIG_USR2 )
+		return;
+	M_getstat( G_spath, M99_GET_TIME, &tval );
+	M_getstat( G_spath, M99_IRQ_LAT, &irqLat );
+	UpdateStats( &G_irq, irqLat );
+	UpdateStats( &G_sig, tval );
+}
+
+/* find irq of device in /proc/interrupts by name or "mdis" */
+static int FindIrq( const char *device )
+{
+	FILE *fp;
+	char line[512], low[512], dev[64];
+	int irq = -1, n = 0, i;
+
+	for( i=0; device[i] && i < (int)sizeof(dev)-1; i++ )
+		dev[i] = (char)tolower( (unsigned char)device[i] );
+	dev[i] = '\0';
+
+	if( (fp = fopen( "/proc/interrupts", "r" )) == NULL )
+		return -1;
+	while( fgets( line, sizeof(line), fp )){
+		for( i=0; line[i]; i++ )
+			low[i] = (char)tolower( (unsigned char)line[i] );
+		low[i] = '\0';
+		if( !isdigit( (unsigned char)line[strspn( line, " " )] ))
+			continue;
+		if( strstr( low, dev ) || strstr( low, "mdis" )){
+			irq = atoi( line );
+			n++;
+		}
+	}
+	fclose( fp );
+	return n == 1 ? irq : -1;
+}
+
+static int IrqAffinityGet( int irq, char *buf, int size )
+{
+	char name[64];
+	FILE *fp;
+
+	sprintf( name, "/proc/irq/%d/smp_affinity_list", irq );
+	if( (fp = fopen( name, "r" )) == NULL )
+		return -1;
+	if( fgets( buf, size, fp ) == NULL )
+		buf[0] = '\0';
+	fclose( fp );
+	buf[strcspn( buf, "\n" )] = '\0';
+	return buf[0] ? 0 : -1;
+}
+
+static int IrqAffinitySet( int irq, const char *list )
+{
+	char name[64];
+	FILE *fp;
+	int rv;
+
+	sprintf( name, "/proc/irq/%d/smp_affinity_list", irq );
+	if( (fp = fopen( name, "w" )) == NULL )
+		return -1;
+	rv = fprintf( fp, "%s\n", list ) < 0;
+	rv |= fclose( fp ) != 0;
+	return rv ? -1 : 0;
+}
+
+static int SelfAffinity( int cpu )
+{
+	cpu_set_t set;
+
+	CPU_ZERO( &set );
+	CPU_SET( cpu, &set );
+	return sched_setaffinity( 0, sizeof(set), &set );
+}
+
+/* print one matrix, \a sig selects signal or irq latency */
+static void PrintMatrix( int nCpu, int sig, int bi, int br, int wi, int wr )
+{
+	int i, r;
+
+	printf("%s latency [us] %s, rows: irq cpu, columns: receiver cpu\n",
+		   sig ? "signal" : "irq", sig ? "avg/p99/max" : "avg/max" );
+	printf("irq\\rcv");
+	for( r=0; r<nCpu; r++ )
+		printf(" %17d", r );
+	printf("\n");
+
+	for( i=0; i<nCpu; i++ ){
+		printf("%7d", i );
+		for( r=0; r<nCpu; r++ ){
+			const CELL *c = &G_cell[i][r];
+			char txt[40];
+
+			if( !c->count )
+				sprintf( txt, "-" );
+			else if( sig )
+				sprintf( txt, "%.0f/%d/%d", c->sigAvg, (int)c->sigP99,
+						 (int)c->sigMax );
+			else
+				sprintf( txt, "%.0f/%d", c->irqAvg, (int)c->irqMax );
+			printf(" %16s%c", txt,
+				   i == bi && r == br ? '*' : i == wi && r == wr ? '!' : ' ' );
+		}
+		printf("\n");
+	}
+}
+#endif /* LINUX */
+
+/**********************************************************************/
+/** sweep irq and receiver cpu, print latency matrix
+ *
+ *  \param device	device name
+ *  \param timerval	timer value
+ *  \param hold		measuring time per placement [s]
+ *  \param irq		Linux irq of the device, -1: from /proc/interrupts
+ *
+ *  \return 0 | 1 on error
+ */
+int SWEEP_Run( const char *device, int32 timerval, int hold, int irq )
+{
+#ifdef LINUX
+	char orgIrq[256], cpuStr[16];
+	cpu_set_t orgSelf;
+	int nCpu, i, r, k, bi = -1, br = -1, wi = -1, wr = -1, rv = 1;
+	int started = 0, moved = 0;
+	STATS sig;
+
+	nCpu = (int)sysconf( _SC_NPROCESSORS_ONLN );
+	if( nCpu > SWEEP_MAX_CPU )
+		nCpu = SWEEP_MAX_CPU;
+
+	if( irq < 0 && (irq = FindIrq( device )) < 0 ){
+		printf("*** irq of %s not found in /proc/interrupts, use -q\n",
+			   device );
+		return 1;
+	}
+	if( IrqAffinityGet( irq, orgIrq, sizeof(orgIrq) ) ||
+		sched_getaffinity( 0, sizeof(orgSelf), &orgSelf )){
+		printf("*** can't read affinity of irq %d\n", irq );
+		return 1;
+	}
+
+	memset( G_cell, 0, sizeof(G_cell) );
+	CHK( (G_spath = M_open( device )) >= 0 );
+	CHK( UOS_SigInit( SweepSigHandler ) == 0 );
+	CHK( UOS_SigInstall( UOS_SIG_USR2 ) == 0 );
+	started = 1;
+	if( DrvStart( G_spath, timerval, UOS_SIG_USR2 )){
+		CHK( M_setstat(G_spath,M99_SIG_set_cond1, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_spath,M99_SIG_set_cond2, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_spath,M99_SIG_set_cond3, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_spath,M99_SIG_set_cond4, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_spath,M99_TIMERVAL,timerval) == 0 );
+	}
+	CHK( M_setstat(G_spath,M_MK_IRQ_ENABLE,1) == 0 );
+
+	printf("sweeping irq %d and receiver over %d cpus, %d s each: "
+		   "timerval=%d\n", irq, nCpu, hold, timerval );
+	printf("(press any key for exit)\n");
+	printf("irq cpu  rcv cpu  |  min[us]  avg[us]  max[us]  (sigs)\n");
+
+	for( i=0; i<nCpu; i++ ){
+		sprintf( cpuStr, "%d", i );
+		moved = 1;
+		if( IrqAffinitySet( irq, cpuStr )){
+			printf("*** can't set affinity of irq %d (root?)\n", irq );
+			goto ABORT;
+		}
+		for( r=0; r<nCpu; r++ ){
+			CELL *c = &G_cell[i][r];
+
+			CHK( SelfAffinity( r ) == 0 );
+
+			UOS_SigMask();
+			InitStats( &G_irq );
+			InitStats( &G_sig );
+			G_irq.first = 3;
+			G_sig.first = 3;
+			UOS_SigUnMask();
+
+			for( k=0; k<hold * 10; k++ ){
+				UOS_Delay( 100 );
+				if( UOS_KeyPressed() != -1 )
+					goto ABORT;
+			}
+
+			UOS_SigMask();
+			sig = G_sig;
+			c->count  = G_sig.count;
+			c->irqAvg = G_irq.count ?
+				(double)TICKS2US(G_irq.avgAcc) / G_irq.count : 0.0;
+			c->irqMax = TICKS2US(G_irq.max);
+			UOS_SigUnMask();
+
+			if( c->count ){
+				c->sigAvg = (double)TICKS2US(sig.avgAcc) / sig.count;
+				c->sigP99 = TICKS2US(StatsPercentile( &sig, 0.99 ));
+				c->sigMax = TICKS2US(sig.max);
+			}
+
+			printf("%7d  %7d  | ", i, r );
+			PrintStats( &sig );
+			printf("\n");
+		}
+	}
+	rv = 0;
+
+ ABORT:
+	if( started ){
+		M_setstat(G_spath, M99_SIG_clr_cond1, UOS_SIG_USR2 );
+		M_setstat(G_spath, M99_SIG_clr_cond2, UOS_SIG_USR2 );
+		M_setstat(G_spath, M99_SIG_clr_cond3, UOS_SIG_USR2 );
+		M_setstat(G_spath, M99_SIG_clr_cond4, UOS_SIG_USR2 );
+		UOS_SigRemove( UOS_SIG_USR2 );
+		UOS_SigExit();
+	}
+	if( G_spath >= 0 )
+		M_close( G_spath );
+	if( moved )
+		IrqAffinitySet( irq, orgIrq );
+	sched_setaffinity( 0, sizeof(orgSelf), &orgSelf );
+
+	/* best/worst by p99, then max */
+	for( i=0; i<nCpu; i++ )
+		for( r=0; r<nCpu; r++ ){
+			const CELL *c = &G_cell[i][r];
+
+			if( !c->count )
+				continue;
+			if( bi < 0 || c->sigP99 < G_cell[bi][br].sigP99 ||
+				(c->sigP99 == G_cell[bi][br].sigP99 &&
+				 c->sigMax < G_cell[bi][br].sigMax) ){
+				bi = i;
+				br = r;
+			}
+			if( wi < 0 || c->sigP99 > G_cell[wi][wr].sigP99 ||
+				(c->sigP99 == G_cell[wi][wr].sigP99 &&
+				 c->sigMax > G_cell[wi][wr].sigMax) ){
+				wi = i;
+				wr = r;
+			}
+		}
+	if( bi < 0 )
+		return rv;
+
+	printf("\n");
+	PrintMatrix( nCpu, 1, bi, br, wi, wr );
+	printf("\n");
+	PrintMatrix( nCpu, 0, bi, br, wi, wr );
+	printf("\n* best:  irq cpu %d, receiver cpu %d  p99 %d us, max %d us\n",
+		   bi, br, (int)G_cell[bi][br].sigP99, (int)G_cell[bi][br].sigMax );
+	printf("! worst: irq cpu %d, receiver cpu %d  p99 %d us, max %d us\n",
+		   wi, wr, (int)G_cell[wi][wr].sigP99, (int)G_cell[wi][wr].sigMax );
+	return rv;
+#else
+	(void)device;
+	(void)timerval;
+	(void)hold;
+	(void)irq;
+	printf("*** affinity sweep only supported on Linux\n");
+	return 1;
+#endif
+}
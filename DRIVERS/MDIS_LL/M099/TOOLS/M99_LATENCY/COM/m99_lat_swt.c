@@ -0,0 +1,182 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_swt.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Software timer reference thread of m99_latency
+ *
+ *               A cyclictest like thread sleeps with clock_nanosleep to
+ *               absolute deadlines at the M99 timer period and records
+ *               its wakeup latency in the same STATS (1 tick = 4us per
+ *               histogram bucket) as the irq and signal latency. Both
+ *               run at the same time, so latency of the M99 irq path can
+ *               be told apart from general scheduling latency.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#ifdef LINUX
+# include <time.h>
+# include <pthread.h>
+# include <sched.h>
+# include <signal.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+#ifdef LINUX
+static pthread_t G_thread;
+static pthread_mutex_t G_lock = PTHREAD_MUTEX_INITIALIZER;
+static STATS G_stats;
+static volatile int G_run;
+static long G_periodNs;
+
+static void TsAdd( struct timespec *ts, long ns )
+{
+	ts->tv_nsec += ns;
+	while( ts->tv_nsec >= 1000000000 ){
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+static long TsDiffNs( const struct timespec *a, const struct timespec *b )
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000L + (a->tv_nsec - b->tv_nsec);
+}
+
+static void *SwtThread( void *arg )
+{
+	struct timespec next, now;
+	long lat;
+
+	(void)arg;
+	clock_gettime( CLOCK_MONOTONIC, &next );
+	TsAdd( &next, G_periodNs );
+
+	while( G_run ){
+		if( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL ))
+			continue;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		lat = TsDiffNs( &now, &next );
+
+		pthread_mutex_lock( &G_lock );
+		UpdateStats( &G_stats, (int32)(lat / (1000 * TIME_PER_TICK)) );
+		pthread_mutex_unlock( &G_lock );
+
+		/* absolute deadlines, skip periods already over */
+		TsAdd( &next, G_periodNs );
+		while( TsDiffNs( &now, &next ) > 0 )
+			TsAdd( &next, G_periodNs );
+	}
+	return NULL;
+}
+#endif /* LINUX */
+
+/**********************************************************************/
+/** start software timer thread
+ *
+ *  \param timerval	period [ticks], same as M99 timer
+ *  \param prio		SCHED_FIFO priority, 0: default policy
+ *
+ *  \return 0 | -1 on error
+ */
+int SWT_Start( int32 timerval, int prio )
+{
+#ifdef LINUX
+	pthread_attr_t attr;
+	struct sched_param sp;
+	sigset_t all, old;
+	int rv;
+
+	InitStats( &G_stats );
+	G_stats.first    = 3;
+	G_stats.totalMin = 0x7fffffff;
+	G_periodNs = (long)TICKS2US(timerval) * 1000;
+	G_run = 1;
+
+	pthread_attr_init( &attr );
+	if( prio > 0 ){
+		memset( &sp, 0, sizeof(sp) );
+		sp.sched_priority = prio;
+		pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED );
+		pthread_attr_setschedpolicy( &attr, SCHED_FIFO );
+		pthread_attr_setschedparam( &attr, &sp );
+	}
+	/* reference must never be the target of the measured signal */
+	sigfillset( &all );
+	pthread_sigmask( SIG_BLOCK, &all, &old );
+	rv = pthread_create( &G_thread, &attr, SwtThread, NULL );
+	pthread_sigmask( SIG_SETMASK, &old, NULL );
+	pthread_attr_destroy( &attr );
+	if( rv ){
+		printf("*** can't start software timer thread%s\n",
+			   prio > 0 ? " (SCHED_FIFO needs privileges)" : "" );
+		G_run = 0;
+		return -1;
+	}
+	return 0;
+#else
+	(void)timerval;
+	(void)prio;
+	printf("*** software timer thread only supported on Linux\n");
+	return -1;
+#endif
+}
+
+/**********************************************************************/
+/** get stats of the current interval and start the next one
+ */
+void SWT_Take( STATS *st )
+{
+#ifdef LINUX
+	int32 tmin, tmax;
+
+	pthread_mutex_lock( &G_lock );
+	*st = G_stats;
+	tmin = G_stats.totalMin;
+	tmax = G_stats.totalMax;
+	InitStats( &G_stats );
+	G_stats.totalMin = tmin;
+	G_stats.totalMax = tmax;
+	pthread_mutex_unlock( &G_lock );
+#else
+	InitStats( st );
+#endif
+}
+
+/**********************************************************************/
+/** stop software timer thread
+ */
+void SWT_Stop( void )
+{
+#ifdef LINUX
+	if( !G_run )
+		return;
+	G_run = 0;
+	pthread_join( G_thread, NULL );
+#endif
+}
@@ -0,0 +1,348 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_sys.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  System activity sampler of m99_latency
+ *
+ *               Once per report interval the counters of
+ *
+ *               /proc/interrupts   per irq line (sum over cpus)
+ *               /proc/softirqs     per softirq type (sum over cpus)
+ *               /proc/stat         ctxt, procs_running, procs_blocked
+ *               /proc/vmstat       pgfault, pgmajfault
+ *               /proc/schedstat    run queue wait time per cpu
+ *
+ *               are read and turned into deltas of that interval. For
+ *               intervals without latency spike the deltas feed a
+ *               running mean per counter. For a spike interval the
+ *               counters that rose most above their mean are reported.
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+#define SYS_MAX_MET		160		/* counters tracked */
+#define SYS_TOP			4		/* counters named per spike */
+#define SYS_MIN_RISE	2.0		/* delta / mean to count as risen */
+#define SYS_MIN_DELTA	20		/* ignore smaller rises */
+
+/* metric classes, summed into the SYS_IV columns */
+#define MC_IRQ		0
+#define MC_SOFTIRQ	1
+#define MC_CTXT		2
+#define MC_FAULT	3
+#define MC_MAJFAULT	4
+#define MC_RQWAIT	5			/* run queue wait [us] */
+#define MC_GAUGE	6			/* current value, no delta */
+
+typedef struct {
+	char    name[40];
+	int     cls;
+	int     seen;				/* found in current sample */
+	u_int64 cur, prev;
+	double  mean;				/* mean delta of quiet intervals */
+	u_int32 nMean;
+} SYS_MET;
+
+static SYS_MET G_met[SYS_MAX_MET];
+static int G_nMet;
+static int G_sysOn;
+
+static SYS_MET *Met( const char *name, int cls )
+{
+	int i;
+
+	for( i=0; i<G_nMet; i++ )
+		if( !strcmp( G_met[i].name, name ))
+			return &G_met[i];
+	if( G_nMet == SYS_MAX_MET )
+		return NULL;
+
+	memset( &G_met[G_nMet], 0, sizeof(SYS_MET) );
+	strncpy( G_met[G_nMet].name, name, sizeof(G_met[0].name)-1 );
+	G_met[G_nMet].cls = cls;
+	return &G_met[G_nMet++];
+}
+
+static void Put( const char *name, int cls, u_int64 val )
+{
+	int n = G_nMet;
+	SYS_MET *m = Met( name, cls );
+
+	if( m ){
+		/* new counter: no delta before its second sample */
+		if( G_nMet != n )
+			m->prev = val;
+		m->cur  = val;
+		m->seen = 1;
+	}
+}
+
+/* per line counters summed over the cpu columns (interrupts, softirqs) */
+static void ReadPerCpu( const char *file, const char *prefix, int cls )
+{
+	FILE *fp;
+	char line[1024], name[40], *p, *end, *last;
+	int nCpu = 0, c;
+	u_int64 sum;
+
+	if( (fp = fopen( file, "r" )) == NULL )
+		return;
+
+	/* header: CPU0 CPU1 ... */
+	if( fgets( line, sizeof(line), fp ))
+		for( p=line; (p = strstr( p, "CPU" )) != NULL; p += 3 )
+			nCpu++;
+
+	while( fgets( line, sizeof(line), fp )){
+		line[strcspn( line, "\n" )] = '\0';
+		p = line + strspn( line, " " );
+		if( (end = strchr( p, ':' )) == NULL )
+			continue;
+		*end++ = '\0';
+
+		sum = 0;
+		for( c=0; c<nCpu; c++ ){
+			u_int64 v = strtoull( end, &p, 10 );
+
+			if( p == end )
+				break;
+			sum += v;
+			end = p;
+		}
+
+		/* numbered irqs: add the device name (last word) */
+		last = strrchr( end, ' ' );
+		if( isdigit( (unsigned char)line[strspn( line, " " )] ) && last &&
+			last[1] )
+			sprintf( name, "%s%.6s %.20s", prefix,
+					 line + strspn( line, " " ), last + 1 );
+		else
+			sprintf( name, "%s%.20s", prefix, line + strspn( line, " " ));
+		Put( name, cls, sum );
+	}
+	fclose( fp );
+}
+
+/* "key value" files (stat, vmstat) */
+static void ReadKeyVal( const char *file )
+{
+	FILE *fp;
+	char line[256], key[64];
+	unsigned long long v;
+
+	if( (fp = fopen( file, "r" )) == NULL )
+		return;
+	while( fgets( line, sizeof(line), fp )){
+		if( sscanf( line, "%63s %llu", key, &v ) != 2 )
+			continue;
+		if( !strcmp( key, "ctxt" ))
+			Put( "ctxt", MC_CTXT, v );
+		else if( !strcmp( key, "procs_running" ))
+			Put( "procs_running", MC_GAUGE, v );
+		else if( !strcmp( key, "procs_blocked" ))
+			Put( "procs_blocked", MC_GAUGE, v );
+		else if( !strcmp( key, "pgfault" ))
+			Put( "pgfault", MC_FAULT, v );
+		else if( !strcmp( key, "pgmajfault" ))
+			Put( "pgmajfault", MC_MAJFAULT, v );
+	}
+	fclose( fp );
+}
+
+/* run queue wait per cpu, 8th field of the cpu lines [ns] */
+static void ReadSchedstat( void )
+{
+	FILE *fp;
+	char line[512], cpu[16], name[40];
+	unsigned long long f[9];
+
+	if( (fp = fopen( "/proc/schedstat", "r" )) == NULL )
+		return;
+	while( fgets( line, sizeof(line), fp )){
+		if( strncmp( line, "cpu", 3 ) ||
+			sscanf( line, "%15s %llu %llu %llu %llu %llu %llu %llu %llu",
+					cpu, &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6],
+					&f[7] ) != 9 )
+			continue;
+		sprintf( name, "rqwait %s", cpu );
+		Put( name, MC_RQWAIT, f[7] / 1000 );
+	}
+	fclose( fp );
+}
+
+static void ReadAll( void )
+{
+	int i;
+
+	for( i=0; i<G_nMet; i++ ){
+		G_met[i].prev = G_met[i].cur;
+		G_met[i].seen = 0;
+	}
+	ReadPerCpu( "/proc/interrupts", "irq ", MC_IRQ );
+	ReadPerCpu( "/proc/softirqs", "softirq ", MC_SOFTIRQ );
+	ReadKeyVal( "/proc/stat" );
+	ReadKeyVal( "/proc/vmstat" );
+	ReadSchedstat();
+}
+
+static u_int64 Delta( const SYS_MET *m )
+{
+	if( m->cls == MC_GAUGE )
+		return m->cur;
+	return m->cur >= m->prev ? m->cur - m->prev : 0;
+}
+
+/**********************************************************************/
+/** start sampler, read the initial counters
+ *
+ *  \return 0 | -1 if /proc not readable
+ */
+int SYS_Start( void )
+{
+	FILE *fp;
+
+	if( (fp = fopen( "/proc/stat", "r" )) == NULL ){
+		printf("*** /proc/stat not readable, no system sampling\n");
+		return -1;
+	}
+	fclose( fp );
+
+	G_nMet = 0;
+	ReadAll();		/* first interval starts now */
+	G_sysOn = 1;
+	return 0;
+}
+
+/**********************************************************************/
+/** sample counters at the end of an interval
+ *
+ *  \param sys		filled with the interval sums of the counters
+ */
+void SYS_Sample( SYS_IV *sys )
+{
+	int i;
+
+	memset( sys, 0, sizeof(*sys) );
+	if( !G_sysOn )
+		return;
+
+	ReadAll();
+	sys->valid = 1;
+	for( i=0; i<G_nMet; i++ ){
+		const SYS_MET *m = &G_met[i];
+		u_int64 d;
+
+		if( !m->seen )
+			continue;
+		d = Delta( m );
+		switch( m->cls ){
+		case MC_IRQ:		sys->irqs     += d; break;
+		case MC_SOFTIRQ:	sys->softirqs += d; break;
+		case MC_CTXT:		sys->ctxt     += d; break;
+		case MC_FAULT:		sys->faults   += d; break;
+		case MC_MAJFAULT:	sys->majFaults += d; break;
+		case MC_RQWAIT:		sys->rqWaitUs += d; break;
+		default:
+			if( !strcmp( m->name, "procs_running" ))
+				sys->running = (u_int32)d;
+			break;
+		}
+	}
+}
+
+/**********************************************************************/
+/** judge last sample: learn as normal or report what rose with a spike
+ *
+ *  \param fp		output for the spike report
+ *  \param no		interval number
+ *  \param spikeUs	max. latency of a spike interval, 0: no spike
+ */
+void SYS_Judge( FILE *fp, u_int32 no, int32 spikeUs )
+{
+	int top[SYS_TOP], nTop = 0, i, k;
+	double rise[SYS_TOP], r;
+
+	if( !G_sysOn )
+		return;
+
+	if( !spikeUs ){
+		for( i=0; i<G_nMet; i++ ){
+			SYS_MET *m = &G_met[i];
+
+			if( !m->seen )
+				continue;
+			m->nMean++;
+			m->mean += ((double)Delta( m ) - m->mean) / m->nMean;
+		}
+		return;
+	}
+
+	/* counters furthest above their normal rate */
+	for( i=0; i<G_nMet; i++ ){
+		const SYS_MET *m = &G_met[i];
+		double d = (double)Delta( m );
+
+		if( !m->seen || d < m->mean + SYS_MIN_DELTA )
+			continue;
+		r = m->mean > 0.5 ? d / m->mean : d;
+		if( r < SYS_MIN_RISE )
+			continue;
+
+		/* insert sorted, drop the smallest if full */
+		for( k=nTop; k>0 && rise[k-1] < r; k-- )
+			;
+		if( k == SYS_TOP )
+			continue;
+		if( nTop < SYS_TOP )
+			nTop++;
+		memmove( &top[k+1], &top[k], (nTop-1-k) * sizeof(top[0]) );
+		memmove( &rise[k+1], &rise[k], (nTop-1-k) * sizeof(rise[0]) );
+		top[k]  = i;
+		rise[k] = r;
+	}
+
+	fprintf( fp, "SYS: interval %u spike %d us:", (unsigned)no,
+			 (int)spikeUs );
+	if( !nTop )
+		fprintf( fp, " no system counter above normal" );
+	for( k=0; k<nTop; k++ ){
+		const SYS_MET *m = &G_met[top[k]];
+
+		fprintf( fp, "%s %s %llu", k ? "," : "", m->name,
+				 (unsigned long long)Delta( m ));
+		if( m->nMean && m->mean > 0.5 )
+			fprintf( fp, " (x%.1f)", rise[k] );
+		else
+			fprintf( fp, " (normal 0)" );
+	}
+	fprintf( fp, "\n" );
+}
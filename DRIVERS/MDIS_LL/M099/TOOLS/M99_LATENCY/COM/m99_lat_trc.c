@@ -0,0 +1,337 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_lat_trc.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Trace export of m99_latency (Chrome/Perfetto JSON)
+ *
+ *               Every sample becomes two spans of a trace in the Chrome
+ *               trace event format (chrome://tracing, ui.perfetto.dev):
+ *
+ *               expiry-isr      "M99 irq" track, timer expiry to ISR
+ *               isr-handler     "signal" track, ISR to signal handler
+ *
+ *               plus instant events for signals lost in a report interval
+ *               and samples with a signal latency above a threshold. Time stamps are CLOCK_MONOTONIC [us], the
+ *               expiry is derived from the handler time and M99_GET_TIME.
+ *
+ *               As with the capture, the signal handler only fills a
+ *               ring, the JSON is written from the main loop.
+ *
+ *               Optionally lost signals and threshold violations are
+ *               also written to the ftrace trace_marker, so they show up
+ *               in the kernel trace. Violations are written from the
+ *               handler at the time they occur, losses at the end of the
+ *               interval they are detected in.
+ *
+ *     Switches: LINUX   trace_marker
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#ifdef LINUX
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include "m99_lat.h"
+
+#define TRC_RING_SIZE	0x10000		/* samples, must be power of 2 */
+#define TRC_PID			1
+#define TRC_TID_IRQ		1
+#define TRC_TID_SIG		2
+
+#if defined(__GNUC__)
+# define TRC_BARRIER()	__sync_synchronize()
+#else
+# define TRC_BARRIER()
+#endif
+
+typedef struct {
+	u_int32 seq;
+	u_int32 irqLat;			/* [ticks] */
+	u_int32 sigLat;			/* [ticks] */
+	u_int64 tsUs;			/* handler time */
+} TRC_SAMPLE;
+
+static TRC_SAMPLE		G_ring[TRC_RING_SIZE];
+static volatile u_int32	G_head;		/* written by handler only */
+static volatile u_int32	G_tail;		/* written by main loop only */
+static u_int32			G_dropped;
+
+static FILE		*G_fp;
+static int		G_on;
+static int		G_events;
+static int32	G_thrUs;
+static u_int32	G_lost, G_violations;
+#ifdef LINUX
+static int		G_mfd = -1;			/* trace_marker */
+static u_int32	G_markerErr;
+#endif
+
+/* one event, comma separated from the previous one */
+static void Event( const char *fmt, ... )
+{
+	va_list ap;
+
+	fprintf( G_fp, "%s\n", G_events++ ? "," : "" );
+	va_start( ap, fmt );
+	vfprintf( G_fp, fmt, ap );
+	va_end( ap );
+}
+
+/* copy src as JSON string contents: quote, backslash, controls escaped */
+static void JsonStr( char *dst, int size, const char *src )
+{
+	int n = 0;
+
+	for( ; *src && n < size - 7; src++ ){
+		unsigned char c = (unsigned char)*src;
+
+		if( c == '"' || c == '\\' ){
+			dst[n++] = '\\';
+			dst[n++] = c;
+		}
+		else if( c < 0x20 )
+			n += sprintf( dst + n, "\\u%04x", c );
+		else
+			dst[n++] = c;
+	}
+	dst[n] = '\0';
+}
+
+static void Write( const TRC_SAMPLE *s )
+{
+	u_int64 expiry = s->tsUs - TICKS2US((u_int64)s->sigLat);
+	u_int64 isr    = expiry + TICKS2US((u_int64)s->irqLat);
+	u_int32 sigUs  = TICKS2US(s->sigLat);
+
+	Event( "{\"name\":\"expiry-isr\",\"cat\":\"irq\",\"ph\":\"X\","
+		   "\"ts\":%llu,\"dur\":%u,\"pid\":%d,\"tid\":%d,"
+		   "\"args\":{\"seq\":%u}}",
+		   (unsigned long long)expiry, (unsigned)TICKS2US(s->irqLat),
+		   TRC_PID, TRC_TID_IRQ, (unsigned)s->seq );
+	Event( "{\"name\":\"isr-handler\",\"cat\":\"signal\",\"ph\":\"X\","
+		   "\"ts\":%llu,\"dur\":%u,\"pid\":%d,\"tid\":%d,"
+		   "\"args\":{\"seq\":%u}}",
+		   (unsigned long long)isr,
+		   (unsigned)(s->sigLat > s->irqLat ?
+					  TICKS2US(s->sigLat - s->irqLat) : 0),
+		   TRC_PID, TRC_TID_SIG, (unsigned)s->seq );
+
+	if( G_thrUs > 0 && (int32)sigUs > G_thrUs )
+		Event( "{\"name\":\"threshold\",\"cat\":\"signal\",\"ph\":\"i\","
+			   "\"s\":\"g\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,"
+			   "\"args\":{\"seq\":%u,\"irq_us\":%u,\"sig_us\":%u}}",
+			   (unsigned long long)s->tsUs, TRC_PID, TRC_TID_SIG,
+			   (unsigned)s->seq, (unsigned)TICKS2US(s->irqLat),
+			   (unsigned)sigUs );
+}
+
+/**********************************************************************/
+/** create trace file and/or open trace_marker
+ *
+ *  \param file		trace file, NULL: none
+ *  \param device	device name (process name in the trace)
+ *  \param thrUs	signal latency threshold for markers [us], 0: none
+ *  \param marker	write overruns/violations to ftrace trace_marker
+ *
+ *  \return 0 | -1 on error
+ */
+int TRC_Start( const char *file, const char *device, int32 thrUs,
+			   int marker )
+{
+	char name[256];
+
+	G_thrUs = thrUs;
+	G_lost = G_violations = G_dropped = 0;
+#ifdef LINUX
+	G_markerErr = 0;
+#endif
+	G_head = G_tail = 0;
+
+	if( marker ){
+#ifdef LINUX
+		if( (G_mfd = open( "/sys/kernel/tracing/trace_marker",
+						   O_WRONLY )) < 0 &&
+			(G_mfd = open( "/sys/kernel/debug/tracing/trace_marker",
+						   O_WRONLY )) < 0 ){
+			printf("*** trace: can't open trace_marker (tracefs mounted,"
+				   " root?)\n");
+			return -1;
+		}
+#else
+		printf("*** trace: trace_marker only supported on Linux\n");
+		return -1;
+#endif
+	}
+
+	if( file ){
+		if( (G_fp = fopen( file, "w" )) == NULL ){
+			printf("*** trace: can't create %s\n", file );
+			TRC_Stop();
+			return -1;
+		}
+		JsonStr( name, sizeof(name), device );
+		G_events = 0;
+		fprintf( G_fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" );
+		Event( "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+			   "\"args\":{\"name\":\"m99_latency %s\"}}", TRC_PID, name );
+		Event( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+			   "\"args\":{\"name\":\"M99 irq\"}}", TRC_PID, TRC_TID_IRQ );
+		Event( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+			   "\"args\":{\"name\":\"signal\"}}", TRC_PID, TRC_TID_SIG );
+	}
+
+	G_on = 1;
+	return 0;
+}
+
+/**********************************************************************/
+/** queue one sample (called from signal handler)
+ *
+ *  \param seq		signal sequence number
+ *  \param irqLat	irq latency [ticks]
+ *  \param sigLat	signal latency [ticks]
+ */
+void TRC_Push( u_int32 seq, u_int32 irqLat, u_int32 sigLat )
+{
+	TRC_SAMPLE *s;
+	u_int32 head = G_head;
+	int viol;
+
+	if( !G_on )
+		return;
+
+	viol = G_thrUs > 0 && (int32)TICKS2US(sigLat) > G_thrUs;
+	G_violations += viol;
+
+#ifdef LINUX
+	if( G_mfd >= 0 && viol ){
+		char msg[96];
+		int n;
+
+		n = sprintf( msg, "m99_latency: seq %u irq %u us sig %u us"
+					 " threshold", (unsigned)seq,
+					 (unsigned)TICKS2US(irqLat), (unsigned)TICKS2US(sigLat) );
+		if( write( G_mfd, msg, n ) != n )
+			G_markerErr++;
+	}
+#endif
+
+	if( G_fp == NULL )
+		return;
+	if( head - G_tail >= TRC_RING_SIZE ){
+		G_dropped++;
+		return;
+	}
+
+	s = &G_ring[head & (TRC_RING_SIZE-1)];
+	s->seq    = seq;
+	s->irqLat = irqLat;
+	s->sigLat = sigLat;
+	s->tsUs   = HostTimeUs();
+
+	TRC_BARRIER();
+	G_head = head + 1;
+}
+
+/**********************************************************************/
+/** record signals lost in a report interval (main loop)
+ *
+ *  \param interval	interval number
+ *  \param lost		signals lost, from the driver send counters
+ */
+void TRC_Lost( u_int32 interval, u_int32 lost )
+{
+	if( !G_on )
+		return;
+
+	G_lost += lost;
+
+#ifdef LINUX
+	if( G_mfd >= 0 ){
+		char msg[64];
+		int n;
+
+		n = sprintf( msg, "m99_latency: interval %u %u signals lost",
+					 (unsigned)interval, (unsigned)lost );
+		if( write( G_mfd, msg, n ) != n )
+			G_markerErr++;
+	}
+#endif
+
+	if( G_fp != NULL )
+		Event( "{\"name\":\"lost\",\"cat\":\"signal\",\"ph\":\"i\","
+			   "\"s\":\"p\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,"
+			   "\"args\":{\"interval\":%u,\"lost\":%u}}",
+			   (unsigned long long)HostTimeUs(), TRC_PID, TRC_TID_SIG,
+			   (unsigned)interval, (unsigned)lost );
+}
+
+/**********************************************************************/
+/** write queued samples (main loop)
+ */
+void TRC_Poll( void )
+{
+	u_int32 head = G_head;
+
+	if( G_fp == NULL )
+		return;
+
+	TRC_BARRIER();
+	while( G_tail != head ){
+		Write( &G_ring[G_tail & (TRC_RING_SIZE-1)] );
+		TRC_BARRIER();
+		G_tail++;
+	}
+	fflush( G_fp );
+}
+
+/**********************************************************************/
+/** write remaining samples, close trace file and trace_marker
+ */
+void TRC_Stop( void )
+{
+	if( G_fp != NULL ){
+		TRC_Poll();
+		fprintf( G_fp, "\n]}\n" );
+		fclose( G_fp );
+		G_fp = NULL;
+		printf("trace: %u events, %u signals lost, %u above threshold, "
+			   "%u dropped\n", (unsigned)G_events, (unsigned)G_lost,
+			   (unsigned)G_violations, (unsigned)G_dropped );
+	}
+#ifdef LINUX
+	if( G_mfd >= 0 ){
+		if( G_markerErr )
+			printf("trace: %u trace_marker writes failed\n",
+				   (unsigned)G_markerErr );
+		close( G_mfd );
+		G_mfd = -1;
+	}
+#endif
+	G_on = 0;
+}
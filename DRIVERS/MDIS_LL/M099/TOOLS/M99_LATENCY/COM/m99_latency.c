@@ -30,12 +30,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef LINUX
+# include <time.h>
+#endif
 
 #include <MEN/men_typs.h>
 #include <MEN/mdis_api.h>
 #include <MEN/usr_utl.h>
 #include <MEN/usr_oss.h>
 #include <MEN/m99_drv.h>
+#include "m99_lat.h"
 
 #define CHK(expr) \
  if(!(expr)){ \
@@ -44,21 +48,17 @@
     goto ABORT;\
  }
 
-#define TIME_PER_TICK	4		/* 68230 timer runs at 250kHz */
-#define TICKS2US(tks) ((tks)*TIME_PER_TICK)
-
-typedef struct {
-	int32 min;
-	int32 max; 
-	int32 avgAcc;
-	int32 count;
-	int32 first;
-	int32 totalMin;
-	int32 totalMax;
-} STATS;
-
-static STATS G_irqStats, G_sigStats;
+/* two interval buffers, the handler fills [G_cur] */
+static STATS G_irqStats[2], G_sigStats[2];
+static volatile int G_cur;
 static MDIS_PATH G_path;
+static int G_capture;
+static int G_trace;						/* trace export / markers */
+static volatile u_int32 G_sigHandled;
+static int G_seqTrack;					/* read M99_SIG_SEQ in handler */
+static volatile int G_frecFrozen;
+static int G_pmu;						/* read perf counters in handler */
+static int32 G_pmuUs;					/* outlier threshold [us] */
 static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 
 /**********************************************************************/
@@ -66,19 +66,78 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
  */
 static void usage(void)
 {
-	printf("Usage: m99_latency [<opts>] <device> [<opts>]\n");
+	printf("Usage: m99_latency [<opts>] <device> [<device>...] [<opts>]\n");
 	printf("Function: Measures interrupt and signal "
 		   "latency \n");
 	printf("Options:\n");
 	printf("    -t=<rate>      timer value [250]=1ms\n");
 	printf("    -i=<interval>  interval      [1]=1s\n");
+	printf("    -c=<file>      capture every sample to binary file [none]\n");
+	printf("                   (decode with m99_capdec)\n");
+	printf("    -o=<fmt>       emit one record per interval     [none]\n");
+	printf("                   csv | json (JSON lines)\n");
+	printf("    -f=<file>      append records to file, - = stdout  [-]\n");
+	printf("                   (records on stdout replace the table)\n");
+	printf("    -l             append signal loss to table     [off]\n");
+	printf("    -d             append exact driver irq interval stats\n");
+	printf("                   to table (count, overruns)      [off]\n");
+	printf("                   (overruns need M99_OVR_LIMIT set)\n");
+	printf("    -e             measure driver isr execution time,\n");
+	printf("                   print breakdown and M-Module bus\n");
+	printf("                   accesses at end                 [off]\n");
+	printf("    -r=<us>        arm driver flight recorder, dump window\n");
+	printf("                   when irq latency exceeds <us>   [off]\n");
+	printf("    -s=<prio>      run clock_nanosleep thread at timer period\n");
+	printf("                   as reference, SCHED_FIFO <prio>,\n");
+	printf("                   0=default policy (Linux only)   [off]\n");
+	printf("    -p=<src>       busy polling thread next to the signal\n");
+	printf("                   path, detects expiries by polling\n");
+	printf("                   irq:  M99_IRQCOUNT (+ M99_GET_TIME)\n");
+	printf("                   time: M99_GET_TIME\n");
+	printf("                   reports cost per poll (Linux only) [off]\n");
+	printf("    -a=<cpu>       cpu of polling thread  [last online cpu]\n");
+	printf("    -w=<s>         sweep irq affinity and receiver cpu over\n");
+	printf("                   all cpu pairs, <s> seconds each, print\n");
+	printf("                   latency matrix (Linux only, root) [off]\n");
+	printf("    -q=<irq>       Linux irq of device for -w\n");
+	printf("                   [from /proc/interrupts]\n");
+	printf("    -y=<us>        sample system activity (/proc) per\n");
+	printf("                   interval, name counters that rose with\n");
+	printf("                   a latency max above <us>, 0=sample only\n");
+	printf("                   (Linux only)                    [off]\n");
+	printf("    -m=<us>        count cycles, cache misses, ctx switches,\n");
+	printf("                   migrations and page faults of the signal\n");
+	printf("                   receiver, compare samples with signal\n");
+	printf("                   latency above <us> to the others\n");
+	printf("                   (Linux perf_event)              [off]\n");
+	printf("    -j=<file>      write irq timeline as Chrome/Perfetto\n");
+	printf("                   JSON trace (expiry->isr->handler)  [none]\n");
+	printf("    -k=<us>        mark samples with signal latency above\n");
+	printf("                   <us> in trace / trace_marker     [off]\n");
+	printf("    -u             write lost signals and -k violations\n");
+	printf("                   to ftrace trace_marker (Linux)   [off]\n");
+	printf("    -x=<dir>       rewrite Prometheus textfile\n");
+	printf("                   <dir>/m99_latency_<device>.prom every\n");
+	printf("                   interval (counters, histograms)  [none]\n");
+	printf("    -n=<n>         stop after <n> intervals     [key press]\n");
+	printf("    -b=<file>      save irq/signal latency distribution of\n");
+	printf("                   the run as baseline file         [none]\n");
+	printf("    -g=<file>      compare run with baseline file, exit\n");
+	printf("                   code 2 on regression             [none]\n");
+	printf("    -v=<limits>    regression limits for -g, comma list\n");
+	printf("                   of p50|p90|p99|p999|max=<us>[%%] and\n");
+	printf("                   ks=<D+>, -1 disables a check\n");
+	printf("                   [p50=10%%,p99=20%%,ks=0.1]\n");
 	printf("    device     devicename (M99)        [none]\n");
+	printf("               several devices: measured together with the\n");
+	printf("               same timer value, per device, aggregate and\n");
+	printf("               expiry skew to first device (-t, -i only)\n");
 	printf("\n");
 	printf("Copyright 2003-2019, MEN Mikro Elektronik GmbH\n");
 	printf("%s\n", IdentString );
 }
 
-static void InitStats( STATS *st )
+void InitStats( STATS *st )
 {
 	st->min = 0x7fffffff;
 	st->max = 0;
@@ -87,9 +146,10 @@ static void InitStats( STATS *st )
 	st->first = 0;
 	st->totalMin = 0;
 	st->totalMax = 0;
+	memset( st->hist, 0, sizeof(st->hist) );
 }
 
-static void UpdateStats( STATS *st, int32 tval )
+void UpdateStats( STATS *st, int32 tval )
 {
 	if( !st->first )
 	{
@@ -105,6 +165,8 @@ static void UpdateStats( STATS *st, int32 tval )
 
 		st->count++;
 		st->avgAcc += tval;
+		st->hist[tval < 0 ? 0 :
+				 tval >= STATS_HIST_SIZE ? STATS_HIST_SIZE-1 : tval]++;
 	}
 	else
 	{
@@ -112,7 +174,63 @@ static void UpdateStats( STATS *st, int32 tval )
 	}
 }
 
-static void PrintStats( const STATS *st )
+/**********************************************************************/
+/** get value [ticks] below which the fraction q of the interval lies
+ */
+int32 StatsPercentile( const STATS *st, double q )
+{
+	double need = q * st->count, acc = 0;
+	int32 i;
+
+	if( !st->count )
+		return -1;
+
+	for( i=0; i<STATS_HIST_SIZE-1; i++ ){
+		acc += st->hist[i];
+		if( acc >= need )
+			return i;
+	}
+	return st->max;
+}
+
+/* add interval histogram to run histogram */
+static void HistAdd( u_int32 *tot, const STATS *st )
+{
+	int i;
+
+	for( i=0; i<STATS_HIST_SIZE; i++ )
+		tot[i] += st->hist[i];
+}
+
+/**********************************************************************/
+/** print run histograms side by side
+ *
+ *  Columns irq, sig and the reference paths that ran (\a swt, \a poll
+ *  NULL if not). One row per 4us bucket seen by any of them, last
+ *  bucket collects all larger values.
+ */
+static void HistPrint( const u_int32 *irq, const u_int32 *sig,
+					   const u_int32 *swt, const u_int32 *poll )
+{
+	int i;
+
+	printf("HIST: lat[us]        irq        sig%s%s\n",
+		   swt ? "        swt" : "", poll ? "       poll" : "" );
+	for( i=0; i<STATS_HIST_SIZE; i++ ){
+		if( !irq[i] && !sig[i] && !(swt && swt[i]) && !(poll && poll[i]) )
+			continue;
+		printf("HIST: %s%6d %10u %10u",
+			   i == STATS_HIST_SIZE-1 ? ">=" : "  ", (int)TICKS2US(i),
+			   (unsigned)irq[i], (unsigned)sig[i] );
+		if( swt )
+			printf(" %10u", (unsigned)swt[i] );
+		if( poll )
+			printf(" %10u", (unsigned)poll[i] );
+		printf("\n");
+	}
+}
+
+void PrintStats( const STATS *st )
 {
 	printf("%6ld   %6ld   %6ld    (%6ld)",
 		   TICKS2US(st->min), 
@@ -122,19 +240,268 @@ static void PrintStats( const STATS *st )
 		  );
 }
 
+/**********************************************************************/
+/** print frozen flight recorder window and re-arm recorder
+ */
+static void FrecDump( FILE *fp )
+{
+	M99_FREC_WINDOW win;
+	M_SG_BLOCK blk;
+	u_int32 i;
+
+	blk.size = sizeof(win);
+	blk.data = (void*)&win;
+	if( M_getstat( G_path, M99_BLK_FREC, (int32*)&blk ) ){
+		fprintf( fp, "*** can't read flight recorder (%s)\n",
+				 M_errstring(UOS_ErrnoGet()) );
+		return;
+	}
+
+	fprintf( fp, "FREC: irq latency > %d us, %u records\n",
+			 (int)TICKS2US(win.thresh), (unsigned)win.count );
+	fprintf( fp, "FREC:        seq  lat[us]  period[us]  sig\n" );
+	for( i=0; i<win.count; i++ )
+		fprintf( fp, "FREC: %c%10u  %7d  %10d  %s\n",
+				 i == win.trigIdx ? '>' : ' ',
+				 (unsigned)win.ent[i].seq,
+				 (int)TICKS2US(win.ent[i].latency),
+				 (int)TICKS2US(win.ent[i].preload),
+				 win.ent[i].flags & M99_FREC_F_SIGSENT ? "yes" : "-" );
+
+	M_setstat( G_path, M99_FREC_STATE, M99_FREC_ARMED );
+}
+
+/**********************************************************************/
+/** print isr execution time measured by the driver (M99_ISRT)
+ */
+static void IsrtPrint( void )
+{
+	static const char *phase[M99_ISRT_NPHASES] = {
+		"status", "counter", "signal", "mbuf/led", "jitter step"
+	};
+	M99_ISRTIME it;
+	M_SG_BLOCK blk;
+	int i;
+
+	blk.size = sizeof(it);
+	blk.data = (void*)&it;
+	if( M_getstat( G_path, M99_BLK_ISRTIME, (int32*)&blk ) ){
+		printf("*** can't read isr time (%s)\n",
+			   M_errstring(UOS_ErrnoGet()) );
+		return;
+	}
+	if( !it.count ){
+		printf("ISR: no isr measured\n");
+		return;
+	}
+
+	printf("ISR: %u calls measured\n", (unsigned)it.count );
+	printf("ISR:%14s%8s %8s %8s\n", "", "min", "avg", "max" );
+	printf("ISR: total [us]   %8d %8.1f %8d\n",
+		   (int)TICKS2US(it.ticks.min),
+		   (double)TICKS2US(it.ticks.sum) / it.count,
+		   (int)TICKS2US(it.ticks.max) );
+	if( !it.hasCycles ){
+		printf("ISR: no cpu cycle counter, no phase breakdown\n");
+		return;
+	}
+	printf("ISR: total [cyc]  %8u %8.1f %8u\n", (unsigned)it.cycles.min,
+		   (double)it.cycles.sum / it.count, (unsigned)it.cycles.max );
+	for( i=0; i<M99_ISRT_NPHASES; i++ )
+		printf("ISR:  %-11s %8u %8.1f %8u  %5.1f%%\n", phase[i],
+			   (unsigned)it.phase[i].min,
+			   (double)it.phase[i].sum / it.count,
+			   (unsigned)it.phase[i].max,
+			   it.cycles.sum ?
+			   100.0 * it.phase[i].sum / it.cycles.sum : 0.0 );
+}
+
+/**********************************************************************/
+/** read driver bus access counters (M99_BLK_BUSSTAT)
+ *
+ *  \return 0 | -1 if not supported by driver
+ */
+static int BusRead( M99_BUSSTAT *bs )
+{
+	M_SG_BLOCK blk;
+
+	blk.size = sizeof(*bs);
+	blk.data = (void*)bs;
+	return M_getstat( G_path, M99_BLK_BUSSTAT, (int32*)&blk ) ? -1 : 0;
+}
+
+/**********************************************************************/
+/** print bus accesses since \a b0, per register group and per isr
+ */
+static void BusPrint( const M99_BUSSTAT *b0 )
+{
+	static const char *grp[M99_BUS_NGROUPS] = {
+		"timer ctrl", "preload", "counter", "ports", "sram"
+	};
+	M99_BUSSTAT b1;
+	u_int32 calls;
+	int i;
+
+	if( BusRead( &b1 ) ){
+		printf("BUS: no bus access counters in driver\n");
+		return;
+	}
+
+	printf("BUS:%14s%8s %8s %8s\n", "", "reads", "writes", "skipped" );
+	for( i=0; i<M99_BUS_NGROUPS; i++ )
+		printf("BUS:  %-11s %8u %8u %8u\n", grp[i],
+			   (unsigned)(b1.grp[i].reads   - b0->grp[i].reads),
+			   (unsigned)(b1.grp[i].writes  - b0->grp[i].writes),
+			   (unsigned)(b1.grp[i].skipped - b0->grp[i].skipped) );
+
+	if( (calls = b1.isrCalls - b0->isrCalls) != 0 )
+		printf("BUS:  per isr     %8.2f %8.2f %8.2f\n",
+			   (double)(b1.isr.reads   - b0->isr.reads)   / calls,
+			   (double)(b1.isr.writes  - b0->isr.writes)  / calls,
+			   (double)(b1.isr.skipped - b0->isr.skipped) / calls );
+}
+
+/**********************************************************************/
+/** read and reset driver interval stats (M99_BLK_IVSTAT)
+ *
+ *  \return 0 | -1 if not supported by driver
+ */
+static int DrvInterval( INTERVAL *iv )
+{
+	M99_IVSTAT st;
+	M_SG_BLOCK blk;
+
+	blk.size = sizeof(st);
+	blk.data = (void*)&st;
+	iv->drvValid = M_getstat( G_path, M99_BLK_IVSTAT, (int32*)&blk ) == 0;
+	if( !iv->drvValid )
+		return -1;
+
+	iv->drvCount    = st.count;
+	iv->drvMin      = st.min;
+	iv->drvMax      = st.max;
+	iv->drvSum      = st.sum;
+	iv->drvOverruns = st.overruns;
+	return 0;
+}
+
+/**********************************************************************/
+/** configure and start driver with one call (M99_BLK_CONFIG)
+ *
+ *  Signal \a sig for all 4 conditions, timer preload and counter reset
+ *  are applied with a single timer restart. The caller enables irqs
+ *  with M_MK_IRQ_ENABLE afterwards, only that enables the irq in the
+ *  MDIS kernel.
+ *
+ *  \return 0 | -1 if not supported by driver
+ */
+int DrvStart( MDIS_PATH path, int32 timerval, u_int32 sig )
+{
+	M99_CONFIG cfg;
+	M_SG_BLOCK blk;
+	int i;
+
+	memset( &cfg, 0, sizeof(cfg) );
+	cfg.flags     = M99_CFG_TIMER | M99_CFG_SIGNALS | M99_CFG_RESET;
+	cfg.timerval  = timerval;
+	for( i=0; i<M99_MAX_SIGNALS; i++ )
+		cfg.sig[i] = sig;
+
+	blk.size = sizeof(cfg);
+	blk.data = (void*)&cfg;
+	return M_setstat( path, M99_BLK_CONFIG, (INT32_OR_64)&blk ) ? -1 : 0;
+}
+
+/**********************************************************************/
+/** signals lost since the previous call (M99_BLK_SIGSTAT)
+ *
+ *  Called once per interval, \a handled taken before (with the signal
+ *  handler masked). Lost are the signals the driver sent minus the
+ *  signals handled. A signal still pending or sent after \a handled
+ *  was taken is not yet handled, so a deficit only counts when it is
+ *  still there at the next call. The final call, after the conditions
+ *  are cleared and pending signals are delivered, takes the deficit as
+ *  it is.
+ *
+ *  \param path		device path, all 4 conditions signal this process
+ *  \param handled	signals handled so far
+ *  \param final		no more signals pending
+ *  \param sl		loss state, zero before the first call
+ *
+ *  \return lost signals | 0 if not supported by driver
+ */
+u_int32 SigLost( MDIS_PATH path, u_int32 handled, int final,
+				 SIG_LOSS *sl )
+{
+	M99_SIGSTAT st;
+	M_SG_BLOCK blk;
+	u_int32 sent = 0, ahead, settled, lost = 0;
+	int i;
+
+	blk.size = sizeof(st);
+	blk.data = (void*)&st;
+	if( M_getstat( path, M99_BLK_SIGSTAT, (int32*)&blk ))
+		return 0;
+
+	for( i=0; i<M99_MAX_SIGNALS; i++ )
+		sent += st.sent[i];
+	ahead = sent - handled;
+	if( ahead >= 0x80000000 )		/* counters cleared by other path */
+		ahead = 0;
+
+	settled = final || ahead < sl->ahead ? ahead : sl->ahead;
+	if( settled > sl->lost ){
+		lost = settled - sl->lost;
+		sl->lost = settled;
+	}
+	sl->ahead = ahead;
+	return lost;
+}
+
 static void __MAPILIB SigHandler( u_int32 sigCode )
 {
+	if( sigCode == UOS_SIG_USR1 )
+		G_frecFrozen = 1;
+
 	if( sigCode == UOS_SIG_USR2 ){
 		int32 tval=0, irqLat=0;
 
 		M_getstat( G_path, M99_GET_TIME, &tval );
 		M_getstat( G_path, M99_IRQ_LAT, &irqLat );
 		
-		UpdateStats( &G_irqStats, irqLat );
-		UpdateStats( &G_sigStats, tval );		
+		UpdateStats( &G_irqStats[G_cur], irqLat );
+		UpdateStats( &G_sigStats[G_cur], tval );		
+		G_sigHandled++;
+		if( G_pmu )
+			PMU_Sample( TICKS2US(tval) > G_pmuUs );
+
+		if( G_seqTrack ){
+			int32 seq=0;
+
+			M_getstat( G_path, M99_SIG_SEQ, &seq );
+			if( G_capture )
+				CAP_Push( seq, irqLat, tval );
+			if( G_trace )
+				TRC_Push( seq, irqLat, tval );
+		}
 	}
 }
 
+/**********************************************************************/
+/** get monotonic host time in us
+ */
+u_int64 HostTimeUs( void )
+{
+#ifdef LINUX
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	return (u_int64)UOS_MsecTimerGet() * 1000;
+#endif
+}
+
 
 /**********************************************************************/
 /** where all begins...
@@ -143,13 +510,44 @@ int main( int argc, char **argv )
 {
 	int   interval;
 	int32 n,timerval;
-	char *device=NULL,*str,*errstr,buf[40];
-	STATS irqStats, sigStats;
+	char *device=NULL,*str,*errstr,buf[256];
+	char *devs[MULTI_MAX_DEV+1];
+	int nDev = 0;
+	char capFile[256], outFmt[16], outFile[256], trcFile[256];
+	char promDir[256], baseSave[256], baseCmp[256];
+	BASE_LIM baseLim;
+	u_int32 maxInterval;
+	int rv = 0;
+	int32 frecUs;
+	STATS *irqStats, *sigStats, swtStats, pollStats;
+	static u_int32 irqHist[STATS_HIST_SIZE], sigHist[STATS_HIST_SIZE],
+		swtHist[STATS_HIST_SIZE], pollHist[STATS_HIST_SIZE];
+	int swt, swtPrio, poll = -1, pollCpu, sweep, sweepIrq, sysUs, pmuUs;
+	int trcUs, trcMarker;
+	SYS_IV sysIv;
+	PMU_IV pmuIv;
+	POLL_COST pollCost;
+	u_int64 pollNs = 0, pollCnt = 0;
+	double sigSum = 0, pollSum = 0;
+	u_int32 sigN = 0, pollN = 0;
+	RUN_CFG cfg;
+	INTERVAL iv;
+	M99_BUSSTAT bus0;
+	int table = 1, showLost, isrt, showDrv;
+	u_int32 nInterval = 0;
+	int32 irqCount = 0;
+	u_int32 lastIrqCount = 0, lastHandled = 0, handled, handledNow;
+	u_int32 lost;
+	SIG_LOSS sigLoss;
 
-	InitStats(&irqStats);
-	InitStats(&sigStats);
+	irqStats = &G_irqStats[1];
+	sigStats = &G_sigStats[1];
+	InitStats(irqStats);
+	InitStats(sigStats);
+	InitStats(&swtStats);
+	InitStats(&pollStats);
 
-	if ((errstr = UTL_ILLIOPT("t=i=?", buf))) {	/* check args */
+	if ((errstr = UTL_ILLIOPT("t=i=c=o=f=lder=s=p=a=w=q=y=m=j=k=ux=n=b=g=v=?", buf))) {	/* check args */
 		printf("*** %s\n", errstr);
 		return(1);
 	}
@@ -159,11 +557,11 @@ int main( int argc, char **argv )
 		return(1);
 	}
 
-	for (n=1; n<argc; n++)   		/* search for device */
-		if (*argv[n] != '-') {
-			device = argv[n];
-			break;
-		}
+	for (n=1; n<argc; n++)   		/* search for device(s) */
+		if (*argv[n] != '-' && nDev <= MULTI_MAX_DEV)
+			devs[nDev++] = argv[n];
+	if (nDev)
+		device = devs[0];
 
 	if (!device) {
 		usage();
@@ -174,63 +572,397 @@ int main( int argc, char **argv )
 
 	interval	= ((str=UTL_TSTOPT("i=")) ? atoi(str) : 1);
 
+	memset( capFile, 0, sizeof(capFile) );
+	if( (str=UTL_TSTOPT("c=")) )
+		strncpy( capFile, str, sizeof(capFile)-1 );
+
+	memset( outFmt, 0, sizeof(outFmt) );
+	memset( outFile, 0, sizeof(outFile) );
+	memset( &bus0, 0, sizeof(bus0) );
+	if( (str=UTL_TSTOPT("o=")) )
+		strncpy( outFmt, str, sizeof(outFmt)-1 );
+	if( (str=UTL_TSTOPT("f=")) )
+		strncpy( outFile, str, sizeof(outFile)-1 );
+
+	frecUs		= ((str=UTL_TSTOPT("r=")) ? atoi(str) : 0);
+	showLost	= !!UTL_TSTOPT("l");
+	isrt		= !!UTL_TSTOPT("e");
+	showDrv		= !!UTL_TSTOPT("d");
+	swtPrio		= ((str=UTL_TSTOPT("s=")) ? atoi(str) : -1);
+	swt			= swtPrio >= 0;
+	pollCpu		= ((str=UTL_TSTOPT("a=")) ? atoi(str) : -1);
+	sweep		= ((str=UTL_TSTOPT("w=")) ? atoi(str) : 0);
+	sweepIrq	= ((str=UTL_TSTOPT("q=")) ? atoi(str) : -1);
+	sysUs		= ((str=UTL_TSTOPT("y=")) ? atoi(str) : -1);
+	pmuUs		= ((str=UTL_TSTOPT("m=")) ? atoi(str) : -1);
+	trcUs		= ((str=UTL_TSTOPT("k=")) ? atoi(str) : 0);
+	trcMarker	= !!UTL_TSTOPT("u");
+	memset( trcFile, 0, sizeof(trcFile) );
+	if( (str=UTL_TSTOPT("j=")) )
+		strncpy( trcFile, str, sizeof(trcFile)-1 );
+	memset( promDir, 0, sizeof(promDir) );
+	if( (str=UTL_TSTOPT("x=")) )
+		strncpy( promDir, str, sizeof(promDir)-1 );
+	maxInterval	= ((str=UTL_TSTOPT("n=")) ? atoi(str) : 0);
+	memset( baseSave, 0, sizeof(baseSave) );
+	memset( baseCmp, 0, sizeof(baseCmp) );
+	if( (str=UTL_TSTOPT("b=")) )
+		strncpy( baseSave, str, sizeof(baseSave)-1 );
+	if( (str=UTL_TSTOPT("g=")) )
+		strncpy( baseCmp, str, sizeof(baseCmp)-1 );
+	if( BASE_Limits( UTL_TSTOPT("v="), &baseLim ))
+		return(1);
+	if( (str=UTL_TSTOPT("p=")) ){
+		if( !strcmp( str, "irq" ))
+			poll = POLL_SRC_IRQCOUNT;
+		else if( !strcmp( str, "time" ))
+			poll = POLL_SRC_TIME;
+		else {
+			printf("*** unknown poll source %s\n", str );
+			return(1);
+		}
+	}
+
+	if( nDev > 1 ){
+		if( capFile[0] || outFmt[0] || frecUs || showLost || isrt || showDrv ||
+			swt || poll >= 0 || sweep || sysUs >= 0 || pmuUs >= 0 ||
+			trcFile[0] || trcMarker || promDir[0] || maxInterval ||
+			baseSave[0] || baseCmp[0] ){
+			printf("*** -c -o -l -d -e -r -s -p -w -y -m -j -u -x -n -b -g: "
+				   "single device only\n");
+			return(1);
+		}
+		return MULTI_Run( devs, nDev, timerval, interval );
+	}
+
+	if( sweep > 0 ){
+		if( capFile[0] || outFmt[0] || frecUs || showLost || isrt || showDrv ||
+			swt || poll >= 0 || sysUs >= 0 || pmuUs >= 0 || trcFile[0] ||
+			trcMarker || promDir[0] || maxInterval || baseSave[0] ||
+			baseCmp[0] ){
+			printf("*** -w: no other measurement options\n");
+			return(1);
+		}
+		return SWEEP_Run( device, timerval, sweep, sweepIrq );
+	}
+
+	cfg.device   = device;
+	cfg.timerval = timerval;
+	cfg.interval = interval;
+	cfg.swt      = swt;
+	cfg.poll     = poll >= 0;
+	cfg.sys      = sysUs >= 0;
+	cfg.pmu      = pmuUs >= 0;
+	if( outFmt[0] ){
+		if( OUT_Open( outFmt, outFile[0] ? outFile : NULL, &cfg ))
+			return(1);
+		table = !OUT_ToStdout();
+	}
+	if( promDir[0] && PROM_Open( promDir, &cfg ))
+		return(1);
+	G_seqTrack = capFile[0] || trcFile[0] || trcMarker;
+	memset( &sigLoss, 0, sizeof(sigLoss) );
+
 	CHK((G_path = M_open(device)) >= 0);
-	G_irqStats.first    = 3;
-	G_irqStats.totalMin = 0x7fffffff;
-	G_irqStats.totalMax = 0;
-	G_sigStats.first    = 3;
-	G_sigStats.totalMin = 0x7fffffff;
-	G_sigStats.totalMax = 0;
+	G_cur = 0;
+	InitStats( &G_irqStats[0] );
+	InitStats( &G_sigStats[0] );
+	G_irqStats[0].first    = 3;
+	G_irqStats[0].totalMin = 0x7fffffff;
+	G_irqStats[0].totalMax = 0;
+	G_sigStats[0].first    = 3;
+	G_sigStats[0].totalMin = 0x7fffffff;
+	G_sigStats[0].totalMax = 0;
+
+	if( capFile[0] ){
+		CHK( CAP_Start( capFile, timerval, interval ) == 0 );
+		G_capture = 1;
+	}
+
+	if( trcFile[0] || trcMarker ){
+		CHK( TRC_Start( trcFile[0] ? trcFile : NULL, device, trcUs,
+						trcMarker ) == 0 );
+		G_trace = 1;
+	}
+
+	/* counters of this thread, which receives the signals */
+	if( pmuUs >= 0 ){
+		CHK( PMU_Start() == 0 );
+		G_pmuUs = pmuUs;
+		G_pmu   = 1;
+	}
 
 	CHK( UOS_SigInit( SigHandler ) == 0 );
 	CHK( UOS_SigInstall( UOS_SIG_USR2 ) == 0 );
 
-	CHK( M_setstat(G_path,M99_SIG_set_cond1, UOS_SIG_USR2 ) == 0 );
-	CHK( M_setstat(G_path,M99_SIG_set_cond2, UOS_SIG_USR2 ) == 0 );
-	CHK( M_setstat(G_path,M99_SIG_set_cond3, UOS_SIG_USR2 ) == 0 );
-	CHK( M_setstat(G_path,M99_SIG_set_cond4, UOS_SIG_USR2 ) == 0 );
+	if( frecUs > 0 ){
+		CHK( UOS_SigInstall( UOS_SIG_USR1 ) == 0 );
+		CHK( M_setstat(G_path,M99_SIG_set_frec, UOS_SIG_USR1 ) == 0 );
+		CHK( M_setstat(G_path,M99_FREC_THRESH, frecUs/TIME_PER_TICK ) == 0 );
+	}
 
 	CHK( M_setstat(G_path,M_MK_IRQ_COUNT,0) == 0 );
-	CHK( M_setstat(G_path,M99_TIMERVAL,timerval) == 0 );
+	if( isrt ){
+		CHK( M_setstat(G_path,M99_ISRT,1) == 0 );
+		BusRead( &bus0 );		/* start of bus access counting */
+	}
+
+	if( DrvStart( G_path, timerval, UOS_SIG_USR2 ) == 0 ){
+		lastIrqCount = 0;		/* driver counters cleared by config */
+	}
+	else {
+		/* driver without M99_BLK_CONFIG: one setstat per step */
+		CHK( M_setstat(G_path,M99_SIG_set_cond1, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_path,M99_SIG_set_cond2, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_path,M99_SIG_set_cond3, UOS_SIG_USR2 ) == 0 );
+		CHK( M_setstat(G_path,M99_SIG_set_cond4, UOS_SIG_USR2 ) == 0 );
+		CHK( M_getstat(G_path,M99_IRQCOUNT,&irqCount) == 0 );
+		lastIrqCount = (u_int32)irqCount;
+		CHK( M_setstat(G_path,M99_TIMERVAL,timerval) == 0 );
+		DrvInterval( &iv );		/* start first interval */
+	}
 	CHK( M_setstat(G_path,M_MK_IRQ_ENABLE,1) == 0 );
 
-	printf("generating interrupts: timerval=%d\n", timerval );
-	printf("(press any key for exit)\n");
-	printf("    current Interrupt-Latency        |     current Signal-Latency          \n");
-	printf("  min[us]  avg[us]  max[us]  (irq/s) |  min[us]  avg[us]  max[us]  (sigs/s)\n");
-	printf(" =================================== | ====================================\n");
+	if( swt )
+		CHK( SWT_Start( timerval, swtPrio ) == 0 );
+	if( poll >= 0 )
+		CHK( POLL_Start( device, poll, pollCpu ) == 0 );
+	if( sysUs >= 0 )
+		CHK( SYS_Start() == 0 );
+
+	if( table ){
+		printf("generating interrupts: timerval=%d\n", timerval );
+		printf("(press any key for exit)\n");
+		printf("    current Interrupt-Latency        |     current Signal-Latency          ");
+		if( swt )
+			printf(" |     current Timer-Thread-Latency");
+		if( poll >= 0 )
+			printf(" |     current Poll-Detection-Latency");
+		if( sysUs >= 0 )
+			printf(" |          system activity per interval");
+		if( pmuUs >= 0 )
+			printf(" |     receiver counters per interval");
+		printf("\n");
+		printf("  min[us]  avg[us]  max[us]  (irq/s) |  min[us]  avg[us]  max[us]  (sigs/s)");
+		if( swt )
+			printf(" |  min[us]  avg[us]  max[us] (wakes/s)");
+		if( poll >= 0 )
+			printf(" |  min[us]  avg[us]  max[us]   (det/s) ns/poll");
+		if( sysUs >= 0 )
+			printf(" |    irqs softirq  ctxsw  faults rqwait[us] run");
+		if( pmuUs >= 0 )
+			printf(" | outl     Mcycles  ctxsw  migr  faults");
+		printf("\n");
+		printf(" =================================== | ====================================");
+		if( swt )
+			printf(" | ====================================");
+		if( poll >= 0 )
+			printf(" | ============================================");
+		if( sysUs >= 0 )
+			printf(" | =============================================");
+		if( pmuUs >= 0 )
+			printf(" | ====================================");
+		printf("\n");
+	}
 	
 	/* Do not change the tool output because it is required for TestAutomation */
 	
 	while ( UOS_KeyPressed() == -1 ) {	
 		
 		UOS_Delay( interval * 1000 );
+		CAP_Poll();
+		TRC_Poll();
+		/* buffers of the previous interval are free for the handler */
+		InitStats( &G_sigStats[G_cur ^ 1] );
+		InitStats( &G_irqStats[G_cur ^ 1] );
+
+		/* only switch buffers and take handler counters masked */
 		UOS_SigMask();
-		sigStats = G_sigStats;
-		irqStats = G_irqStats;
-		InitStats( &G_sigStats );
-		InitStats( &G_irqStats );
-		
-		PrintStats( &irqStats );
-		printf(" | ");
-		PrintStats( &sigStats );
-		printf("\n");
+		G_cur ^= 1;
+		handledNow = G_sigHandled;
+		PMU_Take( &pmuIv );
 		UOS_SigUnMask();
+
+		sigStats = &G_sigStats[G_cur ^ 1];
+		irqStats = &G_irqStats[G_cur ^ 1];
+		handled = handledNow - lastHandled;
+		lastHandled = handledNow;
+		lost = SigLost( G_path, handledNow, 0, &sigLoss );
+		M_getstat( G_path, M99_IRQCOUNT, &irqCount );
+
+		DrvInterval( &iv );
+		if( swt ){
+			SWT_Take( &swtStats );
+			HistAdd( swtHist, &swtStats );
+		}
+		if( poll >= 0 ){
+			POLL_Take( &pollStats, &pollCost );
+			HistAdd( pollHist, &pollStats );
+			pollNs  += pollCost.nsSum;
+			pollCnt += pollCost.polls;
+			pollSum += pollStats.avgAcc;
+			pollN   += pollStats.count;
+			sigSum  += sigStats->avgAcc;
+			sigN    += sigStats->count;
+		}
+		HistAdd( irqHist, irqStats );
+		HistAdd( sigHist, sigStats );
+		SYS_Sample( &sysIv );
+		iv.spikeUs = 0;
+		if( sysUs > 0 ){
+			int32 maxUs = TICKS2US(irqStats->max > sigStats->max ?
+								   irqStats->max : sigStats->max);
+
+			if( maxUs > sysUs )
+				iv.spikeUs = maxUs;
+		}
+		
+		if( table ){
+			PrintStats( irqStats );
+			printf(" | ");
+			PrintStats( sigStats );
+			if( swt ){
+				printf(" | ");
+				PrintStats( &swtStats );
+			}
+			if( poll >= 0 ){
+				printf(" | ");
+				PrintStats( &pollStats );
+				printf(" %7.0f", pollCost.polls ?
+					   (double)pollCost.nsSum / pollCost.polls : 0.0 );
+			}
+			if( sysIv.valid )
+				printf(" | %7llu %7llu %6llu %7llu %10llu %3u",
+					   (unsigned long long)sysIv.irqs,
+					   (unsigned long long)sysIv.softirqs,
+					   (unsigned long long)sysIv.ctxt,
+					   (unsigned long long)sysIv.faults,
+					   (unsigned long long)sysIv.rqWaitUs,
+					   (unsigned)sysIv.running );
+			if( pmuIv.valid & (1 << PMU_CYCLES) )
+				printf(" | %4u %11.3f", (unsigned)pmuIv.outliers,
+					   pmuIv.sum[PMU_CYCLES] / 1e6 );
+			else if( pmuIv.valid )
+				printf(" | %4u %11s", (unsigned)pmuIv.outliers, "-" );
+			if( pmuIv.valid )
+				printf(" %6llu %5llu %7llu",
+					   (unsigned long long)pmuIv.sum[PMU_CTXSW],
+					   (unsigned long long)pmuIv.sum[PMU_MIGR],
+					   (unsigned long long)pmuIv.sum[PMU_FAULTS] );
+			if( showLost )
+				printf(" | %6u lost (%6.2f%%)", (unsigned)lost,
+					   handled + lost ? 100.0 * lost / (handled + lost) : 0.0 );
+			if( showDrv && iv.drvValid )
+				printf(" | drv %6u irqs %5u ovr", (unsigned)iv.drvCount,
+					   (unsigned)iv.drvOverruns );
+			printf("\n");
+		}
+
+		iv.no       = ++nInterval;
+		if( G_trace && lost )
+			TRC_Lost( iv.no, lost );
+		iv.irq      = irqStats;
+		iv.sig      = sigStats;
+		iv.swt      = swt ? &swtStats : NULL;
+		iv.poll     = poll >= 0 ? &pollStats : NULL;
+		iv.pollCost = &pollCost;
+		iv.sys      = sysUs >= 0 ? &sysIv : NULL;
+		iv.pmu      = pmuUs >= 0 ? &pmuIv : NULL;
+		iv.irqs     = (u_int32)irqCount - lastIrqCount;
+		iv.overruns = iv.irqs > handled ? iv.irqs - handled : 0;
+		iv.sigHandled = handled;
+		iv.sigLost  = lost;
+		lastIrqCount = (u_int32)irqCount;
+		OUT_Record( &iv );
+		PROM_Update( &iv );
+		SYS_Judge( table ? stdout : stderr, iv.no, iv.spikeUs );
+		if( pmuIv.valid && pmuIv.outliers ){
+			sprintf( buf, "PMU: interval %u outliers %u, per sample "
+					 "normal/outlier:", (unsigned)iv.no,
+					 (unsigned)pmuIv.outliers );
+			PMU_Print( table ? stdout : stderr, buf, &pmuIv );
+		}
+
+		if( G_frecFrozen ){
+			G_frecFrozen = 0;
+			FrecDump( table ? stdout : stderr );
+		}
+		if( maxInterval && nInterval >= maxInterval )
+			break;
 	}
 	
  ABORT:	
+	SWT_Stop();
+	POLL_Stop();
 	M_setstat(G_path, M99_SIG_clr_cond1, UOS_SIG_USR2 );
 	M_setstat(G_path, M99_SIG_clr_cond2, UOS_SIG_USR2 );
 	M_setstat(G_path, M99_SIG_clr_cond3, UOS_SIG_USR2 );
 	M_setstat(G_path, M99_SIG_clr_cond4, UOS_SIG_USR2 );
+	if( G_path >= 0 ){
+		UOS_Delay( 10 );		/* deliver pending signal */
+		SigLost( G_path, G_sigHandled, 1, &sigLoss );
+	}
+	if( frecUs > 0 ){
+		M_setstat(G_path, M99_FREC_THRESH, 0 );
+		M_setstat(G_path, M99_SIG_clr_frec, UOS_SIG_USR1 );
+		UOS_SigRemove( UOS_SIG_USR1 );
+	}
+
+	if( isrt ){
+		IsrtPrint();
+		BusPrint( &bus0 );
+		M_setstat(G_path, M99_ISRT, 0 );
+	}
 
 	UOS_SigRemove( UOS_SIG_USR2 );
 	UOS_SigExit();
+	G_pmu = 0;
+	G_capture = 0;
+	CAP_Stop();
+	G_trace = 0;
+	TRC_Stop();
+	OUT_Close();
+	PROM_Close();
 	if( G_path >= 0 ) 
 		M_close( G_path );	
-	printf("IRQ: total min/max   %d/%d [us]       | ", TICKS2US(irqStats.totalMin),  TICKS2US(irqStats.totalMax) );
-	printf("SIG: total min/max   %d/%d [us]\n", TICKS2US(sigStats.totalMin),  TICKS2US(sigStats.totalMax) );
-	return 0;
+	if( table ){
+		printf("IRQ: total min/max   %d/%d [us]       | ", TICKS2US(irqStats->totalMin),  TICKS2US(irqStats->totalMax) );
+		printf("SIG: total min/max   %d/%d [us]\n", TICKS2US(sigStats->totalMin),  TICKS2US(sigStats->totalMax) );
+		if( showLost )
+			printf("SIG: total lost      %u of %u\n", (unsigned)sigLoss.lost,
+				   (unsigned)(G_sigHandled + sigLoss.lost) );
+		if( swt )
+			printf("SWT: total min/max   %d/%d [us]\n",
+				   TICKS2US(swtStats.totalMin), TICKS2US(swtStats.totalMax) );
+		if( poll >= 0 ){
+			printf("POLL: total min/max  %d/%d [us]\n",
+				   TICKS2US(pollStats.totalMin), TICKS2US(pollStats.totalMax) );
+			if( pollCnt )
+				printf("POLL: %.0f ns per getstat over %.0f polls\n",
+					   (double)pollNs / pollCnt, (double)pollCnt );
+			if( pollN && sigN )
+				printf("POLL: avg detection %.1f us, signal %.1f us\n",
+					   TICKS2US(pollSum) / pollN, TICKS2US(sigSum) / sigN );
+		}
+		if( pmuUs >= 0 )
+			PMU_Print( stdout, NULL, NULL );
+		if( swt || poll >= 0 )
+			HistPrint( irqHist, sigHist, swt ? swtHist : NULL,
+					   poll >= 0 ? pollHist : NULL );
+	}
+	PMU_Stop();
+
+	if( baseSave[0] && BASE_Save( baseSave, timerval, irqHist, sigHist ))
+		rv = 1;
+	if( baseCmp[0] ){
+		switch( BASE_Compare( table ? stdout : stderr, baseCmp, timerval,
+							  irqHist, sigHist, &baseLim )){
+		case 0:		break;
+		case 1:		rv = 2; break;		/* regression */
+		default:	rv = 1; break;
+		}
+	}
+	return rv;
 }
 
 
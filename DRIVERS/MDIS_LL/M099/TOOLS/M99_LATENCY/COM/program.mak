@@ -26,13 +26,43 @@ MAK_LIBS=$(LIB_PREFIX)$(MEN_LIB_DIR)/usr_oss$(LIB_SUFFIX)     \
          $(LIB_PREFIX)$(MEN_LIB_DIR)/usr_utl$(LIB_SUFFIX)     \
          $(LIB_PREFIX)$(MEN_LIB_DIR)/mdis_api$(LIB_SUFFIX)    \
 
+# threads and clock_nanosleep, Linux builds only (MEN_LIN_DIR is set by
+# the MDIS for Linux makefile), other OSes build without them
+ifdef MEN_LIN_DIR
+MAK_LIBS+=-lpthread -lrt
+endif
+
 MAK_INCL=$(MEN_INC_DIR)/m99_drv.h     \
          $(MEN_INC_DIR)/men_typs.h    \
          $(MEN_INC_DIR)/mdis_api.h    \
          $(MEN_INC_DIR)/usr_oss.h     \
          $(MEN_INC_DIR)/usr_utl.h     \
+         $(MEN_INC_DIR)/m99_cap.h     \
+         $(MEN_MOD_DIR)/m99_lat.h     \
 
 MAK_INP1=$(MAK_NAME)$(INP_SUFFIX)
+MAK_INP2=m99_lat_cap$(INP_SUFFIX)
+MAK_INP3=m99_lat_out$(INP_SUFFIX)
+MAK_INP4=m99_lat_multi$(INP_SUFFIX)
+MAK_INP5=m99_lat_swt$(INP_SUFFIX)
+MAK_INP6=m99_lat_poll$(INP_SUFFIX)
+MAK_INP7=m99_lat_sweep$(INP_SUFFIX)
+MAK_INP8=m99_lat_sys$(INP_SUFFIX)
+MAK_INP9=m99_lat_pmu$(INP_SUFFIX)
+MAK_INP10=m99_lat_trc$(INP_SUFFIX)
+MAK_INP11=m99_lat_prom$(INP_SUFFIX)
+MAK_INP12=m99_lat_base$(INP_SUFFIX)
 
-MAK_INP=$(MAK_INP1)
+MAK_INP=$(MAK_INP1) \
+        $(MAK_INP2) \
+        $(MAK_INP3) \
+        $(MAK_INP4) \
+        $(MAK_INP5) \
+        $(MAK_INP6) \
+        $(MAK_INP7) \
+        $(MAK_INP8) \
+        $(MAK_INP9) \
+        $(MAK_INP10) \
+        $(MAK_INP11) \
+        $(MAK_INP12)
 
@@ -0,0 +1,729 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_report.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Offline HTML/SVG report of m99_latency capture files
+ *
+ *               Reads one or more capture files (m99_latency -c) and
+ *               writes a self-contained HTML page (inline SVG, no
+ *               scripts) with per run
+ *
+ *               - latency over time heatmap of irq and signal latency
+ *               - histograms and CDFs of irq and signal latency
+ *               - percentile table
+ *               - the largest signal latencies with time stamps
+ *
+ *               Several runs are shown side by side with the same axes,
+ *               the percentile table shows the deltas to the first run.
+ *
+ *               Every file is read twice: once for the statistics and
+ *               the time range, once to fill the heatmap.
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/usr_utl.h>
+#define M99CAP_READER
+#include <MEN/m99_cap.h>
+
+#define MAX_RUNS	4		/* side by side */
+#define HIST_SIZE	16384	/* ticks, larger values go to last bucket */
+#define HM_COLS		120		/* heatmap time columns */
+#define HM_ROWS		40		/* heatmap latency rows, 2 per octave */
+#define HM_ROW0_US	8		/* upper bound of first row */
+#define NUM_BINS	150		/* histogram / CDF bins */
+#define MAX_OUTL	100
+#define NINES_MAX	5		/* CDF y axis down to 1 - 10^-5 */
+
+#define IRQ			0
+#define SIG			1
+
+/* svg geometry */
+#define SVG_W		620
+#define SVG_H		220
+#define SVG_L		50		/* left margin for axis labels */
+#define SVG_B		30		/* bottom margin */
+
+/* one latency path of a run */
+typedef struct {
+	u_int32 min;
+	u_int32 max;
+	double  sum;
+	u_int32 hist[HIST_SIZE];
+} PATH;
+
+/* one capture file */
+typedef struct {
+	const char    *file;
+	M99CAP_HDR    hdr;
+	u_int32       tickUs;
+	u_int32       count;
+	u_int64       missed;		/* irqs without sample (seq gaps) */
+	u_int64       t0, t1;		/* first/last sample time [us] */
+	int           ended;
+	u_int32       dropped;
+	int           corrupt;
+	u_int32       above;		/* signal latency above -t */
+	PATH          path[2];
+	M99CAP_SAMPLE outl[MAX_OUTL];	/* largest signal latency, sorted */
+	int           nOutl;
+	u_int32       hm[2][HM_ROWS][HM_COLS];
+} RUN;
+
+static RUN G_run[MAX_RUNS];
+static int G_nRuns;
+static int G_nOutl = 20;
+static u_int32 G_thrUs;
+static double G_rowUs[HM_ROWS];		/* heatmap row upper bounds [us] */
+static int G_nRows;
+static u_int32 G_xMaxUs;			/* histogram / CDF x axis */
+static const char *G_pathName[2] = { "IRQ", "Signal" };
+static const char *G_color[2] = { "#1f77b4", "#d62728" };
+static const struct {
+	const char *name;
+	double q;
+} G_pct[] = {
+	{ "p50", 0.50 }, { "p90", 0.90 }, { "p99", 0.99 }, { "p99.9", 0.999 },
+	{ "p99.99", 0.9999 }
+};
+#define NUM_PCT	(sizeof(G_pct)/sizeof(G_pct[0]))
+
+static const char IdentString[]=MENT_XSTR(MAK_REVISION);
+
+/**********************************************************************/
+/** print usage
+ */
+static void usage(void)
+{
+	printf("Usage: m99_report [<opts>] <file> [<file>...] [<opts>]\n");
+	printf("Function: HTML report of m99_latency capture files\n");
+	printf("Options:\n");
+	printf("    -o=<file>  HTML output file                 [stdout]\n");
+	printf("    -t=<us>    mark signal latency threshold, count\n");
+	printf("               samples above                      [none]\n");
+	printf("    -n=<n>     largest latencies listed per run     [20]\n");
+	printf("    file       capture file (m99_latency -c=<file>),\n");
+	printf("               up to %d side by side\n", MAX_RUNS );
+	printf("\n");
+	printf("Copyright 2019, MEN Mikro Elektronik GmbH\n");
+	printf("%s\n", IdentString );
+}
+
+/* log10 for x > 0, the tools are linked without libm */
+static double Log10( double x )
+{
+	double t, t2, s = 0, p;
+	int e = 0, k;
+
+	while( x >= 2 ){
+		x /= 2;
+		e++;
+	}
+	while( x < 1 ){
+		x *= 2;
+		e--;
+	}
+	/* ln(x) = 2 atanh((x-1)/(x+1)), converges fast for x in [1,2) */
+	t  = (x - 1) / (x + 1);
+	t2 = t * t;
+	p  = t;
+	for( k=1; k<24; k+=2 ){
+		s += p / k;
+		p *= t2;
+	}
+	return (2 * s + e * 0.6931471805599453) * 0.4342944819032518;
+}
+
+/* value [ticks] below which the fraction q of all samples lies */
+static u_int32 Percentile( const PATH *pa, u_int32 count, double q )
+{
+	double need = q * count, acc = 0;
+	u_int32 i;
+
+	for( i=0; i<HIST_SIZE-1; i++ ){
+		acc += pa->hist[i];
+		if( acc >= need )
+			return i;
+	}
+	return pa->max;
+}
+
+static void Update( PATH *pa, u_int32 val )
+{
+	if( val < pa->min )
+		pa->min = val;
+	if( val > pa->max )
+		pa->max = val;
+	pa->sum += val;
+	pa->hist[val < HIST_SIZE ? val : HIST_SIZE-1]++;
+}
+
+/* keep the largest signal latencies, first seen wins on equal values */
+static void AddOutlier( RUN *r, const M99CAP_SAMPLE *s )
+{
+	int k;
+
+	if( r->nOutl == G_nOutl && s->sigLat <= r->outl[r->nOutl-1].sigLat )
+		return;
+	for( k = r->nOutl < G_nOutl ? r->nOutl : G_nOutl-1;
+		 k > 0 && r->outl[k-1].sigLat < s->sigLat; k-- )
+		r->outl[k] = r->outl[k-1];
+	r->outl[k] = *s;
+	if( r->nOutl < G_nOutl )
+		r->nOutl++;
+}
+
+/**********************************************************************/
+/** first pass: statistics, time range and outliers of one file
+ *
+ *  \return 0 | -1 if not a capture file
+ */
+static int ReadStats( RUN *r )
+{
+	M99CAP_RD rd;
+	M99CAP_SAMPLE s;
+	u_int32 prevSeq = 0;
+	int p, rv;
+
+	if( M99CAP_Open( &rd, r->file ) ){
+		printf("*** can't open %s or not a capture file\n", r->file );
+		return -1;
+	}
+	r->hdr    = rd.hdr;
+	r->tickUs = rd.hdr.tickNs / 1000;
+	for( p=0; p<2; p++ )
+		r->path[p].min = 0xffffffff;
+
+	while( (rv = M99CAP_Next( &rd, &s )) == 1 ){
+		if( !r->count )
+			r->t0 = s.tsUs;
+		else if( s.seq - prevSeq > 1 )
+			r->missed += s.seq - prevSeq - 1;
+		prevSeq = s.seq;
+		r->t1   = s.tsUs;
+
+		Update( &r->path[IRQ], s.irqLat );
+		Update( &r->path[SIG], s.sigLat );
+		if( G_thrUs && s.sigLat * r->tickUs > G_thrUs )
+			r->above++;
+		AddOutlier( r, &s );
+		r->count++;
+	}
+	r->corrupt = rv < 0;
+	r->ended   = rd.ended;
+	r->dropped = rd.dropped;
+	M99CAP_Close( &rd );
+
+	if( r->corrupt )
+		printf("*** %s: corrupt data after %u samples\n", r->file,
+			   (unsigned)r->count );
+	return 0;
+}
+
+/* heatmap row of a latency */
+static int Row( double us )
+{
+	int i;
+
+	for( i=0; i<G_nRows-1; i++ )
+		if( us < G_rowUs[i] )
+			return i;
+	return G_nRows-1;
+}
+
+/**********************************************************************/
+/** second pass: fill heatmap
+ */
+static void ReadHeatmap( RUN *r )
+{
+	M99CAP_RD rd;
+	M99CAP_SAMPLE s;
+	u_int64 span = r->t1 - r->t0 + 1;
+	int col;
+
+	if( M99CAP_Open( &rd, r->file ))
+		return;
+	while( M99CAP_Next( &rd, &s ) == 1 ){
+		col = (int)((s.tsUs - r->t0) * HM_COLS / span);
+		r->hm[IRQ][Row( (double)s.irqLat * r->tickUs )][col]++;
+		r->hm[SIG][Row( (double)s.sigLat * r->tickUs )][col]++;
+	}
+	M99CAP_Close( &rd );
+}
+
+/* common scales of all runs */
+static void Scales( void )
+{
+	u_int32 maxUs = 0, bodyUs = 0, v;
+	int i, p;
+
+	for( i=0; i<G_nRuns; i++ ){
+		RUN *r = &G_run[i];
+
+		if( !r->count )
+			continue;
+		for( p=0; p<2; p++ ){
+			if( (v = r->path[p].max * r->tickUs) > maxUs )
+				maxUs = v;
+			v = Percentile( &r->path[p], r->count, 0.999 ) * r->tickUs;
+			if( v > bodyUs )
+				bodyUs = v;
+		}
+	}
+
+	/* heatmap: rows up to the largest value of all runs */
+	G_rowUs[0] = HM_ROW0_US;
+	for( G_nRows=1; G_nRows<HM_ROWS && G_rowUs[G_nRows-1] <= maxUs;
+		 G_nRows++ )
+		G_rowUs[G_nRows] = G_rowUs[G_nRows-1] * 1.4142135623730951;
+
+	/*
+	 * histogram/CDF: 4 x p99.9 keeps the body readable when a single
+	 * spike is far out, larger values go to the last bin
+	 */
+	G_xMaxUs = bodyUs * 4 < maxUs ? bodyUs * 4 : maxUs;
+	if( G_thrUs && G_thrUs > G_xMaxUs && G_thrUs < maxUs )
+		G_xMaxUs = G_thrUs + G_thrUs / 10;
+	if( G_xMaxUs < 40 )
+		G_xMaxUs = 40;
+}
+
+/*--------------------------------------------------------------------*/
+/* HTML output                                                        */
+/*--------------------------------------------------------------------*/
+
+static void Esc( FILE *fp, const char *s )
+{
+	for( ; *s; s++ )
+		switch( *s ){
+		case '<':	fputs( "&lt;", fp ); break;
+		case '>':	fputs( "&gt;", fp ); break;
+		case '&':	fputs( "&amp;", fp ); break;
+		case '"':	fputs( "&quot;", fp ); break;
+		default:	fputc( *s, fp ); break;
+		}
+}
+
+static void SvgBegin( FILE *fp, const char *title )
+{
+	fprintf( fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" "
+			 "height=\"%d\" font-size=\"10\" font-family=\"sans-serif\">\n",
+			 SVG_W, SVG_H + 16 );
+	fprintf( fp, "<text x=\"%d\" y=\"11\" font-weight=\"bold\">%s</text>\n",
+			 SVG_L, title );
+	fprintf( fp, "<g transform=\"translate(0,16)\">\n" );
+	fprintf( fp, "<rect x=\"%d\" y=\"0\" width=\"%d\" height=\"%d\" "
+			 "fill=\"none\" stroke=\"#888\"/>\n", SVG_L, SVG_W - SVG_L - 10,
+			 SVG_H - SVG_B );
+}
+
+static void SvgEnd( FILE *fp )
+{
+	fprintf( fp, "</g></svg>\n" );
+}
+
+/* plot area coordinates */
+#define PX(f)	(SVG_L + (f) * (SVG_W - SVG_L - 10))
+#define PY(f)	((SVG_H - SVG_B) * (1.0 - (f)))
+
+/* x axis in us, 5 ticks, threshold marker */
+static void XAxisUs( FILE *fp, u_int32 maxUs, const char *unit )
+{
+	int i;
+
+	for( i=0; i<=5; i++ )
+		fprintf( fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">"
+				 "%u</text>\n", PX(i / 5.0), SVG_H - SVG_B + 12,
+				 (unsigned)(maxUs * i / 5) );
+	fprintf( fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">%s"
+			 "</text>\n", PX(0.5), SVG_H - 4, unit );
+	if( G_thrUs && G_thrUs <= maxUs )
+		fprintf( fp, "<line x1=\"%.1f\" x2=\"%.1f\" y1=\"0\" y2=\"%d\" "
+				 "stroke=\"#000\" stroke-dasharray=\"4,3\"/>\n",
+				 PX((double)G_thrUs / maxUs), PX((double)G_thrUs / maxUs),
+				 SVG_H - SVG_B );
+}
+
+/* counts of one path in NUM_BINS bins over 0..G_xMaxUs, last bin open */
+static void Bins( const RUN *r, int p, double *bin )
+{
+	u_int32 i;
+	int b;
+
+	memset( bin, 0, NUM_BINS * sizeof(double) );
+	for( i=0; i<HIST_SIZE; i++ ){
+		if( !r->path[p].hist[i] )
+			continue;
+		b = (int)((double)i * r->tickUs * NUM_BINS / G_xMaxUs);
+		bin[b < NUM_BINS ? b : NUM_BINS-1] += r->path[p].hist[i];
+	}
+}
+
+static void Histogram( FILE *fp, const RUN *r )
+{
+	double bin[2][NUM_BINS], top = 1;
+	int p, b;
+
+	for( p=0; p<2; p++ ){
+		Bins( r, p, bin[p] );
+		for( b=0; b<NUM_BINS; b++ )
+			if( bin[p][b] > top )
+				top = bin[p][b];
+	}
+
+	SvgBegin( fp, "Histogram (log count), last bin: all larger" );
+	for( b=1; b<=top; b*=10 )
+		fprintf( fp, "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">%d"
+				 "</text>\n", SVG_L - 3,
+				 PY(Log10( b + 1 ) / Log10( top + 1 )) + 3, b );
+	for( p=0; p<2; p++ )
+		for( b=0; b<NUM_BINS; b++ ){
+			double h;
+
+			if( !bin[p][b] )
+				continue;
+			h = Log10( bin[p][b] + 1 ) / Log10( top + 1 );
+			fprintf( fp, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" "
+					 "height=\"%.1f\" fill=\"%s\" fill-opacity=\"0.55\"/>\n",
+					 PX((double)b / NUM_BINS), PY(h),
+					 PX(1.0 / NUM_BINS) - SVG_L, PY(0) - PY(h), G_color[p] );
+		}
+	XAxisUs( fp, G_xMaxUs, "latency [us]" );
+	SvgEnd( fp );
+}
+
+/* y position of a CDF value on the "nines" scale */
+static double Nines( double f )
+{
+	double n = f < 1.0 ? -Log10( 1.0 - f ) : NINES_MAX;
+
+	return PY((n > NINES_MAX ? NINES_MAX : n) / NINES_MAX);
+}
+
+static void Cdf( FILE *fp, const RUN *r )
+{
+	static const char *lbl[] = { "0", "0.9", "0.99", "0.999", "0.9999",
+								 "0.99999" };
+	double bin[NUM_BINS], acc;
+	int p, b, n;
+
+	SvgBegin( fp, "CDF (tail scale)" );
+	for( n=0; n<=NINES_MAX; n++ ){
+		fprintf( fp, "<line x1=\"%d\" x2=\"%d\" y1=\"%.1f\" y2=\"%.1f\" "
+				 "stroke=\"#ddd\"/>\n", SVG_L, SVG_W - 10,
+				 PY((double)n / NINES_MAX), PY((double)n / NINES_MAX) );
+		fprintf( fp, "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">%s"
+				 "</text>\n", SVG_L - 3, PY((double)n / NINES_MAX) + 3,
+				 lbl[n] );
+	}
+	for( p=0; p<2 && r->count; p++ ){
+		Bins( r, p, bin );
+		fprintf( fp, "<polyline fill=\"none\" stroke=\"%s\" "
+				 "stroke-width=\"1.5\" points=\"%.1f,%.1f", G_color[p],
+				 PX(0.0), PY(0.0) );
+		for( b=0, acc=0; b<NUM_BINS; b++ ){
+			acc += bin[b];
+			fprintf( fp, " %.1f,%.1f", PX((double)(b + 1) / NUM_BINS),
+					 Nines( acc / r->count ));
+		}
+		fprintf( fp, "\"/>\n" );
+	}
+	XAxisUs( fp, G_xMaxUs, "latency [us]" );
+	SvgEnd( fp );
+}
+
+static void Heatmap( FILE *fp, const RUN *r, int p )
+{
+	char title[64];
+	u_int32 top = 1;
+	double rh = (double)(SVG_H - SVG_B) / G_nRows;
+	double cw = (double)(SVG_W - SVG_L - 10) / HM_COLS;
+	int row, col;
+
+	for( row=0; row<G_nRows; row++ )
+		for( col=0; col<HM_COLS; col++ )
+			if( r->hm[p][row][col] > top )
+				top = r->hm[p][row][col];
+
+	sprintf( title, "%s latency over time (log count)", G_pathName[p] );
+	SvgBegin( fp, title );
+	for( row=0; row<G_nRows; row++ ){
+		for( col=0; col<HM_COLS; col++ ){
+			u_int32 c = r->hm[p][row][col];
+
+			if( !c )
+				continue;
+			fprintf( fp, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.2f\" "
+					 "height=\"%.2f\" fill=\"%s\" fill-opacity=\"%.2f\"/>\n",
+					 SVG_L + col * cw, (G_nRows - 1 - row) * rh, cw, rh,
+					 G_color[p],
+					 0.15 + 0.85 * Log10( c + 1.0 ) / Log10( top + 1.0 ));
+		}
+		/* upper bound of every octave */
+		if( row % 2 == 0 && row < G_nRows-1 )
+			fprintf( fp, "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">"
+					 "%.0f</text>\n", SVG_L - 3,
+					 (G_nRows - 1 - row) * rh + 3, G_rowUs[row] );
+	}
+	for( col=0; col<=4; col++ )
+		fprintf( fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">"
+				 "%.1f</text>\n", PX(col / 4.0), SVG_H - SVG_B + 12,
+				 (double)(r->t1 - r->t0) * col / 4 / 1e6 );
+	fprintf( fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">time [s]"
+			 ", y: latency [us]</text>\n", PX(0.5), SVG_H - 4 );
+	SvgEnd( fp );
+}
+
+/* one percentile table row over all runs, delta to the first run */
+static void PctRow( FILE *fp, const char *name, int p, double q, int avg )
+{
+	double v, v0 = 0;
+	int i;
+
+	fprintf( fp, "<tr><td>%s %s</td>", G_pathName[p], name );
+	for( i=0; i<G_nRuns; i++ ){
+		const RUN *r = &G_run[i];
+
+		if( !r->count ){
+			fprintf( fp, "<td>-</td>" );
+			continue;
+		}
+		if( avg )
+			v = r->path[p].sum * r->tickUs / r->count;
+		else if( q < 0 )
+			v = (double)r->path[p].min * r->tickUs;
+		else if( q > 1 )
+			v = (double)r->path[p].max * r->tickUs;
+		else
+			v = (double)Percentile( &r->path[p], r->count, q ) * r->tickUs;
+
+		fprintf( fp, "<td>%.*f", avg, v );
+		if( i == 0 )
+			v0 = v;
+		else if( G_run[0].count )
+			fprintf( fp, " <span class=\"%s\">(%+.*f)</span>",
+					 v > v0 ? "up" : v < v0 ? "dn" : "eq", avg, v - v0 );
+		fprintf( fp, "</td>" );
+	}
+	fprintf( fp, "</tr>\n" );
+}
+
+static void Summary( FILE *fp )
+{
+	unsigned k;
+	int i, p;
+
+	fprintf( fp, "<h2>Summary</h2>\n<table>\n<tr><th></th>" );
+	for( i=0; i<G_nRuns; i++ ){
+		fprintf( fp, "<th>" );
+		Esc( fp, G_run[i].file );
+		fprintf( fp, "</th>" );
+	}
+	fprintf( fp, "</tr>\n<tr><td>timer period [us]</td>" );
+	for( i=0; i<G_nRuns; i++ )
+		fprintf( fp, "<td>%u</td>",
+				 (unsigned)(G_run[i].hdr.timerval * G_run[i].tickUs) );
+	fprintf( fp, "</tr>\n<tr><td>start (UTC)</td>" );
+	for( i=0; i<G_nRuns; i++ ){
+		time_t t = (time_t)G_run[i].hdr.startTime;
+		char buf[32];
+
+		strftime( buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", gmtime( &t ));
+		fprintf( fp, "<td>%s</td>", buf );
+	}
+	fprintf( fp, "</tr>\n<tr><td>duration [s]</td>" );
+	for( i=0; i<G_nRuns; i++ )
+		fprintf( fp, "<td>%.1f</td>",
+				 (double)(G_run[i].t1 - G_run[i].t0) / 1e6 );
+	fprintf( fp, "</tr>\n<tr><td>samples</td>" );
+	for( i=0; i<G_nRuns; i++ )
+		fprintf( fp, "<td>%u</td>", (unsigned)G_run[i].count );
+	fprintf( fp, "</tr>\n<tr><td>irqs without sample</td>" );
+	for( i=0; i<G_nRuns; i++ )
+		fprintf( fp, "<td>%llu</td>",
+				 (unsigned long long)G_run[i].missed );
+	fprintf( fp, "</tr>\n<tr><td>dropped by writer</td>" );
+	for( i=0; i<G_nRuns; i++ )
+		if( G_run[i].ended )
+			fprintf( fp, "<td>%u</td>", (unsigned)G_run[i].dropped );
+		else
+			fprintf( fp, "<td>? (no end record%s)</td>",
+					 G_run[i].corrupt ? ", corrupt" : "" );
+	if( G_thrUs ){
+		fprintf( fp, "</tr>\n<tr><td>signal &gt; %u us</td>",
+				 (unsigned)G_thrUs );
+		for( i=0; i<G_nRuns; i++ )
+			fprintf( fp, "<td>%u</td>", (unsigned)G_run[i].above );
+	}
+	fprintf( fp, "</tr>\n" );
+
+	for( p=0; p<2; p++ ){
+		fprintf( fp, "<tr><th colspan=\"%d\">%s latency [us]</th></tr>\n",
+				 G_nRuns + 1, G_pathName[p] );
+		PctRow( fp, "min", p, -1, 0 );
+		PctRow( fp, "avg", p, 0, 1 );
+		for( k=0; k<NUM_PCT; k++ )
+			PctRow( fp, G_pct[k].name, p, G_pct[k].q, 0 );
+		PctRow( fp, "max", p, 2, 0 );
+	}
+	fprintf( fp, "</table>\n" );
+}
+
+static void Outliers( FILE *fp, const RUN *r )
+{
+	int k;
+
+	fprintf( fp, "<table class=\"ol\">\n<tr><th>#</th><th>seq</th>"
+			 "<th>time [s]</th><th>UTC</th><th>irq [us]</th>"
+			 "<th>sig [us]</th></tr>\n" );
+	for( k=0; k<r->nOutl; k++ ){
+		const M99CAP_SAMPLE *s = &r->outl[k];
+		time_t t = (time_t)(r->hdr.startTime + (s->tsUs - r->t0) / 1000000);
+		char buf[16];
+
+		strftime( buf, sizeof(buf), "%H:%M:%S", gmtime( &t ));
+		fprintf( fp, "<tr><td>%d</td><td>%u</td><td>%.6f</td><td>%s</td>"
+				 "<td>%u</td><td%s>%u</td></tr>\n", k + 1,
+				 (unsigned)s->seq, (double)(s->tsUs - r->t0) / 1e6, buf,
+				 (unsigned)(s->irqLat * r->tickUs),
+				 G_thrUs && s->sigLat * r->tickUs > G_thrUs ?
+				 " class=\"up\"" : "",
+				 (unsigned)(s->sigLat * r->tickUs) );
+	}
+	fprintf( fp, "</table>\n" );
+}
+
+static void Report( FILE *fp )
+{
+	int i, p;
+
+	fprintf( fp, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\">\n"
+			 "<title>M99 latency report</title>\n<style>\n"
+			 "body{font-family:sans-serif;font-size:13px}\n"
+			 "table{border-collapse:collapse}\n"
+			 "td,th{border:1px solid #ccc;padding:2px 6px;"
+			 "text-align:right;vertical-align:top}\n"
+			 "td.run{text-align:left;border:none}\n"
+			 ".up{color:#c00}.dn{color:#080}\n"
+			 "</style></head><body>\n<h1>M99 latency report</h1>\n"
+			 "<p><span style=\"color:%s\">&#9632; IRQ latency</span> "
+			 "(timer expiry to ISR) &nbsp; "
+			 "<span style=\"color:%s\">&#9632; Signal latency</span> "
+			 "(timer expiry to signal handler)", G_color[IRQ],
+			 G_color[SIG] );
+	if( G_thrUs )
+		fprintf( fp, " &nbsp; dashed: threshold %u us", (unsigned)G_thrUs );
+	fprintf( fp, "</p>\n" );
+
+	Summary( fp );
+
+	fprintf( fp, "<h2>Distributions</h2>\n<table><tr>" );
+	for( i=0; i<G_nRuns; i++ ){
+		fprintf( fp, "<td class=\"run\"><b>" );
+		Esc( fp, G_run[i].file );
+		fprintf( fp, "</b><br>\n" );
+		for( p=0; p<2; p++ )
+			Heatmap( fp, &G_run[i], p );
+		Histogram( fp, &G_run[i] );
+		Cdf( fp, &G_run[i] );
+		fprintf( fp, "</td>\n" );
+	}
+	fprintf( fp, "</tr></table>\n" );
+
+	fprintf( fp, "<h2>Largest signal latencies</h2>\n<table><tr>" );
+	for( i=0; i<G_nRuns; i++ ){
+		fprintf( fp, "<td class=\"run\"><b>" );
+		Esc( fp, G_run[i].file );
+		fprintf( fp, "</b><br>\n" );
+		Outliers( fp, &G_run[i] );
+		fprintf( fp, "</td>\n" );
+	}
+	fprintf( fp, "</tr></table>\n<p>%s</p>\n</body></html>\n",
+			 IdentString );
+}
+
+/**********************************************************************/
+/** where all begins...
+ */
+int main( int argc, char **argv )
+{
+	char *str, *errstr, buf[40], out[256];
+	FILE *fp = stdout;
+	int n, i, rv = 0;
+
+	if ((errstr = UTL_ILLIOPT("o=t=n=?", buf))) {	/* check args */
+		printf("*** %s\n", errstr);
+		return(1);
+	}
+
+	if (UTL_TSTOPT("?")) {						/* help requested ? */
+		usage();
+		return(1);
+	}
+
+	for (n=1; n<argc; n++)   		/* search for files */
+		if (*argv[n] != '-' && G_nRuns < MAX_RUNS)
+			G_run[G_nRuns++].file = argv[n];
+
+	if (!G_nRuns) {
+		usage();
+		return(1);
+	}
+
+	memset( out, 0, sizeof(out) );
+	if( (str=UTL_TSTOPT("o=")) )
+		strncpy( out, str, sizeof(out)-1 );
+	G_thrUs = ((str=UTL_TSTOPT("t=")) ? atoi(str) : 0);
+	G_nOutl = ((str=UTL_TSTOPT("n=")) ? atoi(str) : 20);
+	if( G_nOutl < 1 || G_nOutl > MAX_OUTL ){
+		printf("*** -n: 1..%d\n", MAX_OUTL );
+		return(1);
+	}
+
+	for( i=0; i<G_nRuns; i++ ){
+		if( ReadStats( &G_run[i] ))
+			return(1);
+		rv |= G_run[i].corrupt;
+	}
+	Scales();
+	for( i=0; i<G_nRuns; i++ )
+		if( G_run[i].count )
+			ReadHeatmap( &G_run[i] );
+
+	if( out[0] && (fp = fopen( out, "w" )) == NULL ){
+		printf("*** can't create %s\n", out );
+		return(1);
+	}
+	Report( fp );
+	if( fp != stdout && fclose( fp )){
+		printf("*** can't write %s\n", out );
+		return(1);
+	}
+	return rv;
+}
@@ -0,0 +1,311 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m99_statpub.c
+ *
+ *      \author  uf
+ *
+ *  	 \brief  Publishes M99 driver statistics in shared memory
+ *
+ *               Reads M99_BLK_STATS periodically and writes it into a
+ *               sequence locked POSIX shared memory page (see m99_shm.h).
+ *               Observers map the page and read the counters without
+ *               system calls. With -w the tool is such an observer.
+ *
+ *     Switches: LINUX
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef LINUX
+# include <errno.h>
+# include <signal.h>
+# include <time.h>
+# include <sys/stat.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_api.h>
+#include <MEN/usr_utl.h>
+#include <MEN/usr_oss.h>
+#include <MEN/m99_drv.h>
+#ifdef LINUX
+# define M99SHM_READER
+#endif
+#include <MEN/m99_shm.h>
+
+#define TIME_PER_TICK	4		/* 68230 timer runs at 250kHz */
+
+static const char IdentString[]=MENT_XSTR(MAK_REVISION);
+
+/**********************************************************************/
+/** print usage
+ */
+static void usage(void)
+{
+	printf("Usage: m99_statpub [<opts>] <device> [<opts>]\n");
+	printf("Function: Publishes M99 statistics in shared memory\n");
+	printf("Options:\n");
+	printf("    -p=<ms>    publish period                    [10]\n");
+	printf("    -w         watch: print page of a running publisher\n");
+	printf("               once per second (no device access)\n");
+	printf("    device     devicename (M99)        [none]\n");
+	printf("\n");
+	printf("Copyright 2019, MEN Mikro Elektronik GmbH\n");
+	printf("%s\n", IdentString );
+}
+
+#ifdef LINUX
+static u_int64 HostTimeUs( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**********************************************************************/
+/** publisher of an existing shared memory object
+ *
+ *  A page not yet sized or without pid (publisher just starting or
+ *  died while starting) counts as left behind.
+ *
+ *  \param name		shared memory object name
+ *
+ *  \return pid of the living publisher | 0 if the page is left behind
+ */
+static u_int32 LivePublisher( const char *name )
+{
+	struct stat sb;
+	M99SHM_PAGE *page;
+	u_int32 pid = 0;
+	int fd;
+
+	if( (fd = shm_open( name, O_RDONLY, 0 )) < 0 )
+		return 0;
+	if( fstat( fd, &sb ) == 0 && sb.st_size >= (off_t)sizeof(*page) ){
+		page = mmap( NULL, sizeof(*page), PROT_READ, MAP_SHARED, fd, 0 );
+		if( page != MAP_FAILED ){
+			pid = page->pubPid;
+			munmap( page, sizeof(*page) );
+		}
+	}
+	close( fd );
+
+	if( pid && kill( (pid_t)pid, 0 ) < 0 && errno == ESRCH )
+		pid = 0;
+	return pid;
+}
+
+/**********************************************************************/
+/** publish snapshots until key pressed
+ *
+ *  Only one publisher per device: a page of a living publisher is
+ *  never taken over.
+ */
+static int Publish( const char *device, int period )
+{
+	char name[128];
+	M99SHM_PAGE *page;
+	M99_STATS st;
+	M_SG_BLOCK blk;
+	MDIS_PATH path;
+	u_int32 pid;
+	int fd, rv = 1;
+
+	if( (path = M_open( device )) < 0 ){
+		printf("*** can't open %s: %s\n", device,
+			   M_errstring(UOS_ErrnoGet()) );
+		return 1;
+	}
+
+	M99SHM_Name( name, sizeof(name), device );
+	if( (fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0644 )) < 0 &&
+		errno == EEXIST ){
+		if( (pid = LivePublisher( name )) != 0 ){
+			printf("*** %s already published by process %u\n", name,
+				   (unsigned)pid );
+			goto CLEANUP;
+		}
+		fd = shm_open( name, O_RDWR | O_CREAT, 0644 );	/* left behind */
+	}
+	if( fd < 0 || ftruncate( fd, sizeof(M99SHM_PAGE) ) < 0 ){
+		printf("*** can't create shared memory %s\n", name );
+		goto CLEANUP;
+	}
+	page = mmap( NULL, sizeof(M99SHM_PAGE), PROT_READ | PROT_WRITE,
+				 MAP_SHARED, fd, 0 );
+	close( fd );
+	if( page == MAP_FAILED ){
+		printf("*** can't map shared memory %s\n", name );
+		goto CLEANUP;
+	}
+
+	memset( page, 0, sizeof(*page) );
+	page->version = M99SHM_VERSION;
+	page->period  = period;
+	page->pubPid  = (u_int32)getpid();
+
+	printf("publishing %s to %s every %d ms\n", device, name, period );
+	printf("(press any key for exit)\n");
+
+	rv = 0;
+	while( UOS_KeyPressed() == -1 ){
+		blk.size = sizeof(st);
+		blk.data = (void*)&st;
+		if( M_getstat( path, M99_BLK_STATS, (int32*)&blk ) ){
+			printf("*** can't read statistics: %s\n",
+				   M_errstring(UOS_ErrnoGet()) );
+			rv = 1;
+			break;
+		}
+
+		page->seq++;
+		M99SHM_BARRIER();
+		page->stats     = st;
+		page->pubTimeUs = HostTimeUs();
+		page->pubCount++;
+		page->magic     = M99SHM_MAGIC;
+		M99SHM_BARRIER();
+		page->seq++;
+
+		UOS_Delay( period );
+	}
+
+	/* observers see a stale page from now on */
+	munmap( page, sizeof(M99SHM_PAGE) );
+	shm_unlink( name );
+
+ CLEANUP:
+	M_close( path );
+	return rv;
+}
+
+/* latency bucket [ticks] below which the fraction q of all irqs lies */
+static u_int32 HistPercentile( const M99_STATS *st, double q )
+{
+	double total = 0, acc = 0;
+	u_int32 i;
+
+	for( i=0; i<M99_HIST_SIZE; i++ )
+		total += st->hist[i];
+	for( i=0; i<M99_HIST_SIZE-1; i++ ){
+		acc += st->hist[i];
+		if( acc >= q * total )
+			break;
+	}
+	return i;
+}
+
+/**********************************************************************/
+/** print page of a running publisher once per second
+ *
+ *  Percentiles are taken from the driver histogram, which covers
+ *  the whole driver lifetime.
+ */
+static int Watch( const char *device )
+{
+	const M99SHM_PAGE *page;
+	M99SHM_PAGE snap;
+	u_int32 lastCount = 0, lastPub = 0;
+
+	if( (page = M99SHM_Attach( device )) == NULL ){
+		printf("*** no statistics published for %s "
+			   "(m99_statpub running?)\n", device );
+		return 1;
+	}
+
+	printf("(press any key for exit)\n");
+	printf("      irqs   irq/s  lat[us]  max[us]  p50[us]  p99[us]  age[ms]\n");
+
+	while( UOS_KeyPressed() == -1 ){
+		if( M99SHM_Snapshot( page, &snap ) ){
+			printf("*** no consistent snapshot\n");
+		}
+		else if( snap.pubCount == lastPub ){
+			printf("*** publisher stopped\n");
+		}
+		else {
+			const M99_STATS *st = &snap.stats;
+
+			printf("%10u %7u %8u %8u %8u %8u %8u\n",
+				   (unsigned)st->irqCount,
+				   (unsigned)(lastCount ? st->irqCount - lastCount : 0),
+				   (unsigned)(st->irqLatency * TIME_PER_TICK),
+				   (unsigned)(st->maxIrqLatency * TIME_PER_TICK),
+				   (unsigned)(HistPercentile( st, 0.50 ) * TIME_PER_TICK),
+				   (unsigned)(HistPercentile( st, 0.99 ) * TIME_PER_TICK),
+				   (unsigned)((HostTimeUs() - snap.pubTimeUs) / 1000) );
+			lastCount = st->irqCount;
+		}
+		lastPub = snap.pubCount;
+		UOS_Delay( 1000 );
+	}
+
+	M99SHM_Detach( page );
+	return 0;
+}
+#endif /* LINUX */
+
+/**********************************************************************/
+/** where all begins...
+ */
+int main( int argc, char **argv )
+{
+	char *device=NULL,*str,*errstr,buf[40];
+	int32 n;
+	int period, watch;
+
+	if ((errstr = UTL_ILLIOPT("p=w?", buf))) {	/* check args */
+		printf("*** %s\n", errstr);
+		return(1);
+	}
+
+	if (UTL_TSTOPT("?")) {						/* help requested ? */
+		usage();
+		return(1);
+	}
+
+	for (n=1; n<argc; n++)   		/* search for device */
+		if (*argv[n] != '-') {
+			device = argv[n];
+			break;
+		}
+
+	if (!device) {
+		usage();
+		return(1);
+	}
+
+	period	= ((str=UTL_TSTOPT("p=")) ? atoi(str) : 10);
+	watch	= !!UTL_TSTOPT("w");
+
+	if( period < 1 )
+		period = 1;
+
+#ifdef LINUX
+	return watch ? Watch( device ) : Publish( device, period );
+#else
+	(void)watch;
+	printf("*** shared memory statistics only supported on Linux\n");
+	return(1);
+#endif
+}
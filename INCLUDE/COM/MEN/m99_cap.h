@@ -0,0 +1,272 @@
+/***********************  I n c l u d e  -  F i l e  ************************
+ *
+ *         Name: m99_cap.h
+ *
+ *       Author: uf
+ *
+ *  Description: Binary per-sample capture file format of m99_latency
+ *               - file header and block layout
+ *               - varint/zigzag helpers (M99CAP_WRITER)
+ *               - sequential file reader     (M99CAP_READER)
+ *
+ *               File layout (all multi byte header fields little endian):
+ *
+ *                 header   M99CAP_HDR_SIZE bytes, see M99CAP_HDR
+ *                 block    M99CAP_TAG_BLOCK, uvarint n (1..M99CAP_BLK_MAX)
+ *                          first sample absolute:
+ *                            uvarint seq, irqLat, sigLat, tsUs
+ *                          n-1 samples relative to their predecessor:
+ *                            uvarint dSeq, zigzag dIrqLat, zigzag dSigLat,
+ *                            zigzag (dTsUs - previous dTsUs)
+ *                 ...
+ *                 end      M99CAP_TAG_END, uvarint samples, uvarint dropped
+ *
+ *               Every block restarts the delta chain, so a file cut
+ *               short (power loss, disk full) is readable up to the last
+ *               complete block. The end record is optional.
+ *
+ *               The helpers are only meant for user space tools.
+ *
+ *     Switches: M99CAP_WRITER  include encoder helpers
+ *               M99CAP_READER  include file reader (needs <stdio.h>)
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _M99_CAP_H
+#  define _M99_CAP_H
+
+#  ifdef __cplusplus
+      extern "C" {
+#  endif
+
+/*-----------------------------------------+
+|  DEFINES & CONST                         |
++------------------------------------------*/
+#define M99CAP_MAGIC        "M99CAP"  /* 6 bytes at file start */
+#define M99CAP_VERSION      1
+#define M99CAP_HDR_SIZE     32        /* bytes */
+#define M99CAP_BLK_MAX      256       /* max. samples per block */
+#define M99CAP_VARINT_MAX   10        /* max. bytes of one uvarint */
+#define M99CAP_TAG_BLOCK    0xb1
+#define M99CAP_TAG_END      0xe0
+
+/* worst case size of an encoded block */
+#define M99CAP_BLK_BYTES    (2 + M99CAP_VARINT_MAX + \
+                             M99CAP_BLK_MAX * 4 * M99CAP_VARINT_MAX)
+
+#define M99CAP_ZZ_ENC(v)    (((u_int64)(v) << 1) ^ (u_int64)((int64)(v) >> 63))
+#define M99CAP_ZZ_DEC(u)    ((int64)((u) >> 1) ^ -(int64)((u) & 1))
+
+/* helpers below are inline, no code/warnings for helpers a tool doesn't use */
+#if defined(__GNUC__)
+#  define M99CAP_FUNC       static __inline__
+#elif defined(_MSC_VER)
+#  define M99CAP_FUNC       static __inline
+#else
+#  define M99CAP_FUNC       static
+#endif
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++------------------------------------------*/
+/* decoded file header */
+typedef struct {
+	u_int16 version;        /* M99CAP_VERSION */
+	u_int16 flags;          /* reserved, 0 */
+	u_int32 timerval;       /* timer value of the run [ticks] */
+	u_int32 tickNs;         /* duration of one timer tick [ns] */
+	u_int32 startTime;      /* wall clock at capture start [s since 1970] */
+	u_int32 interval;       /* m99_latency report interval [s] */
+} M99CAP_HDR;
+
+/* one captured sample */
+typedef struct {
+	u_int32 seq;            /* irq sequence number */
+	u_int32 irqLat;         /* irq latency [ticks] */
+	u_int32 sigLat;         /* signal latency [ticks] */
+	u_int64 tsUs;           /* host time since capture start [us] */
+} M99CAP_SAMPLE;
+
+/*-----------------------------------------+
+|  WRITER HELPERS                          |
++------------------------------------------*/
+#ifdef M99CAP_WRITER
+
+/* store unsigned varint, returns number of bytes written */
+M99CAP_FUNC int M99CAP_PutVarint( u_int8 *p, u_int64 v )
+{
+	int n = 0;
+
+	while( v >= 0x80 ){
+		p[n++] = (u_int8)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (u_int8)v;
+	return n;
+}
+
+/* fill M99CAP_HDR_SIZE bytes of file header */
+M99CAP_FUNC void M99CAP_PutHdr( u_int8 *p, const M99CAP_HDR *hdr )
+{
+	int i;
+
+	memset( p, 0, M99CAP_HDR_SIZE );
+	memcpy( p, M99CAP_MAGIC, 6 );
+	p[6] = (u_int8)hdr->version;
+	p[7] = (u_int8)(hdr->version >> 8);
+	p[8] = (u_int8)hdr->flags;
+	p[9] = (u_int8)(hdr->flags >> 8);
+	for( i=0; i<4; i++ ){
+		p[12+i] = (u_int8)(hdr->timerval  >> (8*i));
+		p[16+i] = (u_int8)(hdr->tickNs    >> (8*i));
+		p[20+i] = (u_int8)(hdr->startTime >> (8*i));
+		p[24+i] = (u_int8)(hdr->interval  >> (8*i));
+	}
+}
+#endif /* M99CAP_WRITER */
+
+/*-----------------------------------------+
+|  READER                                  |
++------------------------------------------*/
+#ifdef M99CAP_READER
+
+typedef struct {
+	FILE          *fp;
+	M99CAP_HDR    hdr;
+	u_int32       left;     /* samples left in current block */
+	int           first;    /* next sample is absolute */
+	M99CAP_SAMPLE prev;     /* last decoded sample */
+	int64         prevDts;  /* last timestamp delta [us] */
+	int           ended;    /* end record seen */
+	u_int32       endSamples; /* samples according to end record */
+	u_int32       dropped;  /* samples dropped by the writer */
+} M99CAP_RD;
+
+M99CAP_FUNC int M99CAP_GetVarint( FILE *fp, u_int64 *vP )
+{
+	u_int64 v = 0;
+	int c, shift = 0;
+
+	do {
+		if( (c = getc(fp)) == EOF || shift > 63 )
+			return -1;
+		v |= (u_int64)(c & 0x7f) << shift;
+		shift += 7;
+	} while( c & 0x80 );
+
+	*vP = v;
+	return 0;
+}
+
+/* open capture file, returns 0 | -1 (errno set or bad header) */
+M99CAP_FUNC int M99CAP_Open( M99CAP_RD *rd, const char *file )
+{
+	u_int8 p[M99CAP_HDR_SIZE];
+	int i;
+
+	memset( rd, 0, sizeof(*rd) );
+	if( (rd->fp = fopen( file, "rb" )) == NULL )
+		return -1;
+
+	if( fread( p, 1, sizeof(p), rd->fp ) != sizeof(p) ||
+		memcmp( p, M99CAP_MAGIC, 6 ) != 0 )
+		goto BAD;
+
+	rd->hdr.version = (u_int16)(p[6] | (p[7] << 8));
+	rd->hdr.flags   = (u_int16)(p[8] | (p[9] << 8));
+	for( i=0; i<4; i++ ){
+		rd->hdr.timerval  |= (u_int32)p[12+i] << (8*i);
+		rd->hdr.tickNs    |= (u_int32)p[16+i] << (8*i);
+		rd->hdr.startTime |= (u_int32)p[20+i] << (8*i);
+		rd->hdr.interval  |= (u_int32)p[24+i] << (8*i);
+	}
+	if( rd->hdr.version != M99CAP_VERSION )
+		goto BAD;
+	return 0;
+
+ BAD:
+	fclose( rd->fp );
+	rd->fp = NULL;
+	return -1;
+}
+
+/* get next sample, returns 1=sample 0=end of data -1=corrupt file */
+M99CAP_FUNC int M99CAP_Next( M99CAP_RD *rd, M99CAP_SAMPLE *s )
+{
+	u_int64 v[4];
+	int c, i;
+
+	while( rd->left == 0 ){
+		if( rd->ended || (c = getc(rd->fp)) == EOF )
+			return 0;
+
+		if( c == M99CAP_TAG_END ){
+			if( M99CAP_GetVarint( rd->fp, &v[0] ) ||
+				M99CAP_GetVarint( rd->fp, &v[1] ))
+				return 0;
+			rd->endSamples = (u_int32)v[0];
+			rd->dropped    = (u_int32)v[1];
+			rd->ended      = 1;
+			return 0;
+		}
+		if( c != M99CAP_TAG_BLOCK || M99CAP_GetVarint( rd->fp, &v[0] ))
+			return -1;
+		if( v[0] == 0 || v[0] > M99CAP_BLK_MAX )
+			return -1;
+		rd->left  = (u_int32)v[0];
+		rd->first = 1;
+	}
+
+	for( i=0; i<4; i++ )
+		if( M99CAP_GetVarint( rd->fp, &v[i] ))
+			return 0;   /* truncated block: treat as end of data */
+
+	if( rd->first ){
+		s->seq    = (u_int32)v[0];
+		s->irqLat = (u_int32)v[1];
+		s->sigLat = (u_int32)v[2];
+		s->tsUs   = v[3];
+		rd->prevDts = 0;
+		rd->first   = 0;
+	}
+	else {
+		s->seq    = rd->prev.seq + (u_int32)v[0];
+		s->irqLat = (u_int32)((int64)rd->prev.irqLat + M99CAP_ZZ_DEC(v[1]));
+		s->sigLat = (u_int32)((int64)rd->prev.sigLat + M99CAP_ZZ_DEC(v[2]));
+		rd->prevDts += M99CAP_ZZ_DEC(v[3]);
+		s->tsUs   = rd->prev.tsUs + rd->prevDts;
+	}
+
+	rd->prev = *s;
+	rd->left--;
+	return 1;
+}
+
+M99CAP_FUNC void M99CAP_Close( M99CAP_RD *rd )
+{
+	if( rd->fp )
+		fclose( rd->fp );
+	rd->fp = NULL;
+}
+#endif /* M99CAP_READER */
+
+#  ifdef __cplusplus
+      }
+#  endif
+
+#endif/*_M99_CAP_H*/
@@ -35,10 +35,6 @@
       extern "C" {
 #  endif
 
-/*-----------------------------------------+
-|  TYPEDEFS                                |
-+------------------------------------------*/
-
 /*-----------------------------------------+
 |  DEFINES & CONST                         |
 +------------------------------------------*/
@@ -59,12 +55,262 @@
 #define M99_GET_TIME	  M_DEV_OF+0x0c	   /* G  : get elapsed counter value */
 #define M99_MAX_IRQ_LAT	  M_DEV_OF+0x0d	   /* G,S: max irq latency ticks */
 #define M99_IRQ_LAT	  	  M_DEV_OF+0x0e	   /* G  : last irq latency ticks */
+#define M99_FREC_THRESH   M_DEV_OF+0x0f    /* G,S: flight recorder trigger ticks */
+#define M99_FREC_POST     M_DEV_OF+0x10    /* G,S: records after trigger */
+#define M99_FREC_STATE    M_DEV_OF+0x11    /* G,S: recorder state, S: re-arm */
+#define M99_SIG_set_frec  M_DEV_OF+0x12    /* G,S: signal on frozen window */
+#define M99_SIG_clr_frec  M_DEV_OF+0x13    /*   S: signal */
+#define M99_SIG_SEQ       M_DEV_OF+0x14    /* G  : irq seq of last signal sent */
+#define M99_ISRT          M_DEV_OF+0x15    /* G,S: isr time measurement, S: reset */
+#define M99_OVR_LIMIT     M_DEV_OF+0x16    /* G,S: overrun latency ticks, 0=off */
+#define M99_STORM_RATE    M_DEV_OF+0x17    /* G,S: max. irq rate [irq/s], 0=off */
+#define M99_STORM_BUDGET  M_DEV_OF+0x18    /* G,S: max. isr cpu load [1/1000], 0=off */
+#define M99_STORM_MODE    M_DEV_OF+0x19    /* G,S: throttle mode M99_STORM_xxx */
+#define M99_STORM_PAUSE   M_DEV_OF+0x1a    /* G,S: timer pause [ms] */
+#define M99_STORM_EVENTS  M_DEV_OF+0x1b    /* G,S: throttle events, S: reset */
+#define M99_SIG_set_storm M_DEV_OF+0x1c    /* G,S: signal on throttle event */
+#define M99_SIG_clr_storm M_DEV_OF+0x1d    /*   S: signal */
+#define M99_CAP_MODE      M_DEV_OF+0x1e    /* G,S: port B capture M99_CAP_xxx */
+#define M99_CAP_LOST      M_DEV_OF+0x1f    /* G,S: records lost, S: reset */
+#define M99_PAT_MODE      M_DEV_OF+0x20    /* G,S: port A playback M99_PAT_xxx */
+#define M99_PAT_UNDERRUNS M_DEV_OF+0x21    /* G,S: playback underruns, S: reset */
 
 /* set/get block codes */
 #define M99_SETGET_BLOCK_SRAM  M_DEV_BLK_OF+0x01  /* G,S: write/read 128 byte to from sram */
+#define M99_BLK_FREC           M_DEV_BLK_OF+0x02  /* G  : flight recorder window */
+#define M99_BLK_SIGSTAT        M_DEV_BLK_OF+0x03  /* G  : signal send counters */
+#define M99_BLK_ISRTIME        M_DEV_BLK_OF+0x04  /* G  : isr execution time */
+#define M99_BLK_STATS          M_DEV_BLK_OF+0x05  /* G  : live counters, histogram */
+#define M99_BLK_IVSTAT         M_DEV_BLK_OF+0x06  /* G  : interval stats, read+reset */
+#define M99_BLK_CONFIG         M_DEV_BLK_OF+0x07  /* G,S: complete run configuration */
+#define M99_BLK_BUSSTAT        M_DEV_BLK_OF+0x08  /* G  : M-Module bus accesses */
+#define M99_BLK_VTIMER         M_DEV_BLK_OF+0x09  /*   S: arm/disarm virtual timer */
+#define M99_BLK_VTSTAT         M_DEV_BLK_OF+0x0a  /* G  : virtual timer stats */
+#define M99_BLK_STORM          M_DEV_BLK_OF+0x0b  /* G  : irq storm protection */
+#define M99_BLK_PATTERN        M_DEV_BLK_OF+0x0c  /*   S: load next playback bank */
+#define M99_BLK_PATSTAT        M_DEV_BLK_OF+0x0d  /* G  : playback state */
 
 #define M99_MAX_SIGNALS   4
 
+/* flight recorder */
+#define M99_FREC_SIZE       64     /* records in ring, power of 2 */
+
+#define M99_FREC_OFF        0      /* threshold 0: not recording */
+#define M99_FREC_ARMED      1      /* recording, waiting for trigger */
+#define M99_FREC_TRIGGERED  2      /* recording post trigger records */
+#define M99_FREC_FROZEN     3      /* window complete, ring stopped */
+
+#define M99_FREC_F_SIGSENT  0x01   /* signal sent by this irq */
+#define M99_FREC_F_TRIGGER  0x02   /* this irq triggered the recorder */
+
+/* isr execution time phases (M99_ISRTIME.phase[]) */
+#define M99_ISRT_STATUS     0      /* timer status check */
+#define M99_ISRT_COUNTER    1      /* counter read, latency, irq clear */
+#define M99_ISRT_SIGNAL     2      /* signal send, flight recorder */
+#define M99_ISRT_MBUF       3      /* SRAM block i/o or LED toggle */
+#define M99_ISRT_STEP       4      /* jitter step */
+#define M99_ISRT_NPHASES    5
+
+/* M99_CONFIG.flags: parts to apply */
+#define M99_CFG_TIMER       0x01   /* timerval */
+#define M99_CFG_JITTER      0x02   /* jitter, jitterMin, jitterMax */
+#define M99_CFG_SIGNALS     0x04   /* sig[] != 0 */
+#define M99_CFG_RESET       0x08   /* clear counters and statistics */
+#define M99_CFG_IRQ         0x10   /* irqEnable (module only, see driver) */
+#define M99_CFG_ALL         0x1f
+
+/* register groups of bus access counters (M99_BUSSTAT.grp[]) */
+#define M99_BUS_TCTL        0      /* timer control/status TC, TS */
+#define M99_BUS_PRELOAD     1      /* counter preload CPH/CPM/CPL */
+#define M99_BUS_COUNTER     2      /* current counter CNTH/CNTM/CNTL */
+#define M99_BUS_PORT        3      /* port setup and data registers */
+#define M99_BUS_SRAM        4      /* SRAM read/write buffers */
+#define M99_BUS_NGROUPS     5
+
+/* virtual timers multiplexed on the 68230 timer */
+#define M99_VT_NUM          8      /* number of virtual timers */
+#define M99_VT_MIN          25     /* min. hw period while active [ticks] */
+
+/* irq latency histogram, 1 tick per bucket, last bucket collects rest */
+#define M99_HIST_SIZE       64
+
+/* irq storm protection (M99_STORM_MODE) */
+#define M99_STORM_RAISE     0      /* raise the preload to a floor */
+#define M99_STORM_STOP      1      /* halt the timer for M99_STORM_PAUSE ms */
+#define M99_STORM_WIN       25000  /* measuring window [ticks] (100ms) ... */
+#define M99_STORM_WIN_IRQS  1024   /* ... or irqs, whatever comes first */
+
+/* port B capture into the read buffer (M99_CAP_MODE) */
+#define M99_CAP_OFF         0      /* read buffer filled from SRAM */
+#define M99_CAP_ALL         1      /* one record per irq */
+#define M99_CAP_CHANGE      2      /* record only if port B changed */
+
+/* port A pattern playback from SRAM (M99_PAT_MODE) */
+#define M99_PAT_OFF         0      /* port A by write calls, LED toggle */
+#define M99_PAT_LOOP        1      /* repeat bank until the next is loaded */
+#define M99_PAT_ONESHOT     2      /* play each loaded bank once */
+#define M99_PAT_BANK_SIZE   64     /* steps (byte) per SRAM bank */
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++------------------------------------------*/
+/* one flight recorder record (per irq) */
+typedef struct {
+	u_int32 seq;            /* irq sequence number (irq counter) */
+	u_int32 latency;        /* irq latency [ticks] */
+	u_int32 preload;        /* timer preload of this period [ticks] */
+	u_int32 flags;          /* M99_FREC_F_xxx */
+} M99_FREC_ENTRY;
+
+/* M99_BLK_FREC data, records in chronological order */
+typedef struct {
+	u_int32 state;          /* M99_FREC_xxx */
+	u_int32 thresh;         /* trigger threshold [ticks] */
+	u_int32 trigIdx;        /* index of trigger record, 0xffffffff=none */
+	u_int32 count;          /* valid records in ent[] */
+	M99_FREC_ENTRY ent[M99_FREC_SIZE];
+} M99_FREC_WINDOW;
+
+/* M99_BLK_SIGSTAT data */
+typedef struct {
+	u_int32 irqCount;                   /* irqs so far */
+	u_int32 sigSeq;                     /* irq seq of last signal sent */
+	u_int32 sent[M99_MAX_SIGNALS];      /* signals sent per condition */
+	u_int32 lastSeq[M99_MAX_SIGNALS];   /* irq seq of last send per cond */
+} M99_SIGSTAT;
+
+/* M99_BLK_CONFIG data */
+typedef struct {
+	u_int32 flags;          /* M99_CFG_xxx (setstat only) */
+	u_int32 timerval;       /* timer preload [ticks] 1..0xffffff */
+	u_int32 jitter;         /* jitter mode 0..1 */
+	u_int32 jitterMin;      /* jitter profile: min. preload, 0=timerval/2 */
+	u_int32 jitterMax;      /* jitter profile: max. preload, 0=timerval*2 */
+	u_int32 sig[M99_MAX_SIGNALS];  /* signal of free condition 1..4, 0=keep */
+	u_int32 irqEnable;      /* timer irq 0..1 */
+} M99_CONFIG;
+
+/* M99_BLK_STATS data */
+typedef struct {
+	u_int32 irqCount;       /* irqs so far */
+	u_int32 irqLatency;     /* last irq latency [ticks] */
+	u_int32 maxIrqLatency;  /* max. irq latency [ticks] */
+	u_int32 timerval;       /* current timer preload [ticks] */
+	u_int32 hist[M99_HIST_SIZE];  /* irq latency histogram [ticks] */
+} M99_STATS;
+
+/* M99_BLK_IVSTAT data, irq latency since the last M99_BLK_IVSTAT */
+typedef struct {
+	u_int32 count;          /* irqs in interval */
+	u_int32 min;            /* min. latency [ticks], 0xffffffff: no irq */
+	u_int32 max;            /* max. latency [ticks] */
+	u_int32 overruns;       /* irqs with latency >= M99_OVR_LIMIT (set) */
+	u_int64 sum;            /* sum of latencies [ticks] */
+} M99_IVSTAT;
+
+/* bus access counters of one register group */
+typedef struct {
+	u_int32 reads;
+	u_int32 writes;
+	u_int32 skipped;        /* writes saved by the register shadow */
+} M99_BUSCNT;
+
+/* M99_BLK_BUSSTAT data, counters since M99_Init (wrap around) */
+typedef struct {
+	M99_BUSCNT grp[M99_BUS_NGROUPS];  /* per register group */
+	M99_BUSCNT isr;         /* accesses from M99_Irq while M99_ISRT on */
+	u_int32 isrCalls;       /* M99_Irq calls, incl. foreign irqs */
+	u_int32 preloads;       /* preload updates (setTime calls) */
+} M99_BUSSTAT;
+
+/* M99_BLK_VTIMER data */
+typedef struct {
+	u_int32 id;             /* virtual timer 0..M99_VT_NUM-1 */
+	u_int32 first;          /* first expiry from now [ticks], 0=disarm */
+	u_int32 period;         /* period [ticks] >= M99_VT_MIN, 0=one-shot */
+	u_int32 sig;            /* signal on expiry, 0=none */
+} M99_VTIMER;
+
+/* statistics of one virtual timer, cleared when armed */
+typedef struct {
+	u_int32 armed;
+	u_int32 period;         /* [ticks], 0=one-shot */
+	u_int32 expiries;       /* expiries served */
+	u_int32 missed;         /* periods skipped, served too late */
+	u_int32 latMin;         /* latency deadline to isr [ticks] */
+	u_int32 latMax;
+	u_int64 latSum;         /* avg = latSum / expiries */
+} M99_VT_STAT;
+
+/* M99_BLK_VTSTAT data */
+typedef struct {
+	u_int32 active;         /* hw timer driven by virtual timers */
+	u_int32 hwIrqs;         /* timer irqs while active */
+	u_int32 baseIrqs;       /* of them base period (M99_TIMERVAL) irqs */
+	M99_VT_STAT vt[M99_VT_NUM];
+} M99_VTSTAT;
+
+/* min/max/sum of one isr time quantity */
+typedef struct {
+	u_int32 min;
+	u_int32 max;
+	u_int64 sum;            /* avg = sum / M99_ISRTIME.count */
+} M99_ISRT_STAT;
+
+/* M99_BLK_ISRTIME data */
+typedef struct {
+	u_int32 count;          /* measured isr calls */
+	u_int32 hasCycles;      /* 0: no host cycle counter, cycles are 0 */
+	M99_ISRT_STAT ticks;    /* 68230 counter, latency read to exit [ticks] */
+	M99_ISRT_STAT cycles;   /* host cycles, entry to exit */
+	M99_ISRT_STAT phase[M99_ISRT_NPHASES];  /* host cycles per phase */
+} M99_ISRTIME;
+
+/* port B capture record, read buffer size must be a multiple */
+typedef struct {
+	u_int32 seq;            /* irq sequence number (irq counter) */
+	u_int32 time;           /* sample time, timer expiry + latency [ticks] */
+	u_int32 latency;        /* irq latency [ticks] */
+	u_int8  value;          /* port B */
+	u_int8  changed;        /* bits changed since the previous sample */
+	u_int16 lost;           /* records lost before this one (saturated) */
+} M99_CAP_REC;
+
+/* M99_BLK_PATTERN data */
+typedef struct {
+	u_int32 len;            /* steps 1..M99_PAT_BANK_SIZE, at most
+	                           M99_SRAM_RW_BUF_SIZE (even) */
+	u_int8  step[M99_PAT_BANK_SIZE];  /* port A value per timer irq */
+} M99_PATTERN;
+
+/* M99_BLK_PATSTAT data */
+typedef struct {
+	u_int32 mode;           /* M99_PAT_xxx */
+	u_int32 active;         /* bank playing 0..1, 0xffffffff: none */
+	u_int32 pending;        /* bank loaded next 0..1, 0xffffffff: none */
+	u_int32 idx;            /* next step in active bank */
+	u_int32 len[2];         /* steps per bank */
+	u_int32 steps;          /* steps output */
+	u_int32 loops;          /* bank restarts (M99_PAT_LOOP) */
+	u_int32 swaps;          /* bank swaps */
+	u_int32 underruns;      /* bank ended, no bank loaded */
+} M99_PATSTAT;
+
+/* M99_BLK_STORM data */
+typedef struct {
+	u_int32 maxRate;        /* limit [irq/s], 0=off */
+	u_int32 budget;         /* limit isr cpu load [1/1000], 0=off */
+	u_int32 mode;           /* M99_STORM_xxx */
+	u_int32 events;         /* throttle events */
+	u_int32 rate;           /* irq rate of last window [irq/s] */
+	u_int32 load;           /* isr cpu load of last window [1/1000] */
+	u_int32 peakRate;       /* max. rate of all windows */
+	u_int32 peakLoad;       /* max. load of all windows */
+	u_int32 floor;          /* min. preload [ticks], 0=not raised */
+	u_int32 paused;         /* timer halted by M99_STORM_STOP */
+	u_int32 hasCycles;      /* 0: no host cycle counter, no budget */
+} M99_STORM_STAT;
+
 
 
 
@@ -0,0 +1,145 @@
+/***********************  I n c l u d e  -  F i l e  ************************
+ *
+ *         Name: m99_shm.h
+ *
+ *       Author: uf
+ *
+ *  Description: Shared memory statistics page of m99_statpub
+ *
+ *               m99_statpub polls M99_BLK_STATS and publishes the
+ *               snapshot in a POSIX shared memory object named
+ *               M99SHM_NAME_PREFIX<device>. Any number of observers map
+ *               it read-only and read the live counters and histogram
+ *               without a system call and without an own device path.
+ *
+ *               The page is sequence locked: the publisher makes seq
+ *               odd before and even after each update. A reader copies
+ *               the page and retries while seq was odd or changed during
+ *               the copy (see M99SHM_Snapshot).
+ *
+ *     Switches: M99SHM_READER  include observer helpers (Linux only)
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _M99_SHM_H
+#  define _M99_SHM_H
+
+#  ifdef __cplusplus
+      extern "C" {
+#  endif
+
+/*-----------------------------------------+
+|  DEFINES & CONST                         |
++------------------------------------------*/
+#define M99SHM_MAGIC        0x4d393953  /* "M99S" */
+#define M99SHM_VERSION      1
+#define M99SHM_NAME_PREFIX  "/m99stat_"
+#define M99SHM_RETRIES      1000        /* snapshot attempts */
+
+#if defined(__GNUC__)
+# define M99SHM_BARRIER()   __sync_synchronize()
+#else
+# define M99SHM_BARRIER()
+#endif
+
+/* helpers below are inline, no code/warnings for helpers a tool doesn't use */
+#if defined(__GNUC__)
+#  define M99SHM_FUNC       static __inline__
+#elif defined(_MSC_VER)
+#  define M99SHM_FUNC       static __inline
+#else
+#  define M99SHM_FUNC       static
+#endif
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++------------------------------------------*/
+typedef struct {
+	u_int32 magic;          /* M99SHM_MAGIC, set after first publish */
+	u_int32 version;        /* M99SHM_VERSION */
+	volatile u_int32 seq;   /* odd while the publisher updates */
+	u_int32 period;         /* publish period [ms] */
+	u_int32 pubCount;       /* snapshots published */
+	u_int32 pubPid;         /* process id of publisher */
+	u_int64 pubTimeUs;      /* CLOCK_MONOTONIC of last snapshot [us] */
+	M99_STATS stats;        /* driver snapshot (M99_BLK_STATS) */
+} M99SHM_PAGE;
+
+#ifdef M99SHM_READER
+/*-----------------------------------------+
+|  OBSERVER HELPERS                        |
++------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* build shared memory object name from device name */
+M99SHM_FUNC void M99SHM_Name( char *name, int size, const char *device )
+{
+	const char *p = strrchr( device, '/' );
+
+	snprintf( name, size, "%s%s", M99SHM_NAME_PREFIX, p ? p+1 : device );
+}
+
+/* map page of device read-only, NULL if not published */
+M99SHM_FUNC const M99SHM_PAGE *M99SHM_Attach( const char *device )
+{
+	char name[128];
+	void *p;
+	int fd;
+
+	M99SHM_Name( name, sizeof(name), device );
+	if( (fd = shm_open( name, O_RDONLY, 0 )) < 0 )
+		return NULL;
+	p = mmap( NULL, sizeof(M99SHM_PAGE), PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	return p == MAP_FAILED ? NULL : (const M99SHM_PAGE*)p;
+}
+
+M99SHM_FUNC void M99SHM_Detach( const M99SHM_PAGE *page )
+{
+	munmap( (void*)page, sizeof(M99SHM_PAGE) );
+}
+
+/* consistent copy of page, 0 | -1 (no stable snapshot, publisher dead?) */
+M99SHM_FUNC int M99SHM_Snapshot( const M99SHM_PAGE *page, M99SHM_PAGE *copy )
+{
+	u_int32 seq;
+	int n;
+
+	for( n=0; n<M99SHM_RETRIES; n++ ){
+		seq = page->seq;
+		M99SHM_BARRIER();
+		if( seq & 1 )
+			continue;
+		memcpy( copy, (const void*)page, sizeof(*copy) );
+		M99SHM_BARRIER();
+		if( page->seq == seq )
+			return copy->magic == M99SHM_MAGIC ? 0 : -1;
+	}
+	return -1;
+}
+#endif /* M99SHM_READER */
+
+#  ifdef __cplusplus
+      }
+#  endif
+
+#endif/*_M99_SHM_H*/